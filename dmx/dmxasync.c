@@ -0,0 +1,219 @@
+/*
+ * dmxasync.c
+ *
+ * The dmxdblbuf.c animation presented asynchronously from a ring of N
+ * resources (dmxring.h) - no submit_sync and no usleep in the render
+ * loop: frames are handed over with vc_dispmanx_update_submit and the
+ * loop only waits when it runs N - 1 frames ahead of the display.
+ *
+ * Usage: ./dmxasync [N]     (N resources, 2-4, default 3)
+ *
+ * To build:
+ *   gcc -O2 -I/opt/vc/include -L/opt/vc/lib -o dmxasync dmxasync.c -lbcm_host -lpthread
+ *   (off the Pi: gcc -O2 -Istub -o dmxasync dmxasync.c -lpthread)
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "bcm_host.h"
+#include "dmxdamage.h"
+#include "dmxring.h"
+#include "../fb/fbfill.h"
+
+#define WIDTH   200
+#define HEIGHT  200
+
+#define ALIGN_UP(x,y)  ((x + (y)-1) & ~((y)-1))
+
+static long timediff( struct timeval *t0, struct timeval *t1 )
+{
+    return (t1->tv_sec - t0->tv_sec) * 1000000L + (t1->tv_usec - t0->tv_usec);
+}
+
+int main( int argc, char *argv[] )
+{
+    DISPMANX_DISPLAY_HANDLE_T   display;
+    DISPMANX_MODEINFO_T         info;
+    DISPMANX_UPDATE_HANDLE_T    update;
+    DISPMANX_ELEMENT_HANDLE_T   element;
+    DMX_RING_T      ring;
+    void           *image;
+    uint32_t        screen = 0;
+    int             ret;
+    VC_RECT_T       src_rect;
+    VC_RECT_T       dst_rect_elem;
+    VC_IMAGE_TYPE_T type = VC_IMAGE_RGB565;
+    int width = WIDTH, height = HEIGHT;
+    int pitch = ALIGN_UP(width*2, 32);
+    int nbuf = 3;
+    VC_DISPMANX_ALPHA_T alpha = {
+        DISPMANX_FLAGS_ALPHA_FROM_SOURCE | DISPMANX_FLAGS_ALPHA_FIXED_ALL_PIXELS,
+        255, /* fully opaque */
+        0
+    };
+
+    if ( argc > 1 )
+        nbuf = atoi( argv[1] );
+
+    bcm_host_init();
+
+    printf( "Open display[%i]...\n", screen );
+    display = vc_dispmanx_display_open( screen );
+
+    ret = vc_dispmanx_display_get_info( display, &info );
+    assert( ret == 0 );
+    printf( "Display is %d x %d\n", info.width, info.height );
+
+    // the 'off-screen' image
+    image = calloc( 1, pitch * height );
+    assert( image );
+
+    // the ring of GPU resources
+    ret = dmx_ring_init( &ring, nbuf, type, width, height );
+    if ( ret != 0 )
+    {
+        printf( "Error creating %d resources (%d).\n", nbuf, ret );
+        return 1;
+    }
+    printf( "%d resources\n", nbuf );
+
+    vc_dispmanx_rect_set( &src_rect, 0, 0, width << 16, height << 16 );
+    vc_dispmanx_rect_set( &dst_rect_elem,
+                          ( info.width - width ) / 2,
+                          ( info.height - height ) / 2,
+                          width,
+                          height );
+
+    // initial blank image to the first resource
+    fill16_image_rect( image, pitch, width, 0, 0, width, height, 0x0 );
+    ret = dmx_ring_upload( &ring, 0, type, width, pitch, image );
+    assert( ret >= 0 );
+
+    // create the element synchronously - nothing to overlap yet
+    update = vc_dispmanx_update_start( 10 );
+    assert( update );
+    element = vc_dispmanx_element_add( update,
+                                       display,
+                                       2000,               // layer
+                                       &dst_rect_elem,
+                                       ring.res[0],
+                                       &src_rect,
+                                       DISPMANX_PROTECTION_NONE,
+                                       &alpha,
+                                       NULL,             // clamp
+                                       VC_IMAGE_ROT0 );
+    ret = vc_dispmanx_update_submit_sync( update );
+    assert( ret == 0 );
+    dmx_ring_shown( &ring, 0 );
+
+    // where the rectangle was drawn in the previous frame
+    int prev_y = 0, prev_h = 0;
+    long bytes, total_bytes = 0;
+    long wait_us = 0;
+    int frames = 0;
+    struct timeval t0, t1, ta, tb;
+
+    gettimeofday( &t0, NULL );
+
+    // 'animation loop'
+    int i, j, cur;
+    int maxd = 100;
+    int step = 1;
+    int maxstep = maxd / step;
+    for ( j = 0; j < 4; j++ ) {
+      for ( i = 0; i < maxstep; i += step ) {
+
+        int rx, ry, rw, rh;
+        fill16_image_rect( image, pitch, width, 0, 0, width, height, 0x0 );
+        if ( j % 2 == 0 ) {
+          // shrinking rectangle
+          rx = ry = i * step;
+          rw = width - 2 * i * step;
+          rh = height - 2 * i * step;
+        }
+        else {
+          // growing rectangle
+          rx = ry = maxd - i * step;
+          rw = rh = 2 * i * step;
+        }
+        fill16_image_rect( image, pitch, width, rx, ry, rw, rh, 0xF800 );
+
+        dmx_ring_damage( &ring, prev_y, prev_h );
+        dmx_ring_damage( &ring, ry, rh );
+        prev_y = ry;
+        prev_h = rh;
+
+        // the only place the loop may wait: for a free resource
+        gettimeofday( &ta, NULL );
+        cur = dmx_ring_acquire( &ring );
+        gettimeofday( &tb, NULL );
+        wait_us += timediff( &ta, &tb );
+
+        bytes = dmx_ring_upload( &ring, cur, type, width, pitch, image );
+        assert( bytes >= 0 );
+        total_bytes += bytes;
+
+#ifdef BCM_HOST_STUB
+        // check that the resource now matches the image
+        {
+            int res_pitch = 0, row;
+            uint8_t *res_data = stub_resource_data( ring.res[cur], &res_pitch );
+            for ( row = 0; row < height; row++ ) {
+                assert( memcmp( res_data + row * res_pitch,
+                                (uint8_t *)image + row * pitch, width * 2 ) == 0 );
+            }
+        }
+#endif
+
+        // hand the frame over - returns at once
+        ret = dmx_ring_present( &ring, cur, element );
+        assert( ret == 0 );
+        frames++;
+      }
+    }
+
+    dmx_ring_wait_idle( &ring );
+    gettimeofday( &t1, NULL );
+
+    printf( "Done.\n" );
+    printf( "%d frames in %ld ms, waited %ld ms in %d of them\n",
+            frames, timediff( &t0, &t1 ) / 1000, wait_us / 1000, ring.waits );
+    printf( "Uploaded %ld bytes (%ld per frame, full image %d)\n",
+            total_bytes, total_bytes / frames, pitch * height );
+#ifdef BCM_HOST_STUB
+    printf( "Stub: %d updates completed, %d writes to busy resources\n",
+            ring.completed, stub_dmx.busy_writes );
+    assert( ring.completed == ring.presented );
+    assert( stub_dmx.busy_writes == 0 );
+#endif
+
+    // cleanup
+    update = vc_dispmanx_update_start( 10 );
+    assert( update );
+    ret = vc_dispmanx_element_remove( update, element );
+    assert( ret == 0 );
+    ret = vc_dispmanx_update_submit_sync( update );
+    assert( ret == 0 );
+    dmx_ring_free( &ring );
+    ret = vc_dispmanx_display_close( display );
+    assert( ret == 0 );
+    free( image );
+
+    bcm_host_deinit();
+
+    return 0;
+}
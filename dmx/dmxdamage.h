@@ -0,0 +1,151 @@
+/*
+ * dmxdamage.h
+ *
+ * Damaged region tracking for the dispmanx resources - instead of
+ * uploading the whole image with vc_dispmanx_resource_write_data every
+ * frame, only the rows that have changed since the resource was last
+ * written are uploaded.
+ *
+ * vc_dispmanx_resource_write_data ignores the x of the rectangle and
+ * always transfers whole rows (pitch * height bytes starting from row y
+ * of the source image), so the damage is kept as a short sorted list of
+ * row spans rather than rectangles.
+ *
+ * With double (or more) buffering each resource lags behind the image:
+ * the frame damage is added to every resource and a resource's own
+ * damage is cleared when it is uploaded.
+ *
+ * Usage:
+ *   DAMAGE_T dmg[2];
+ *   damage_clear(&dmg[0]); damage_add_rows(&dmg[0], 0, height); ...
+ *   each frame: damage_add_rows(&dmg[i], y, h) for every resource i,
+ *               bytes = damage_upload(&dmg[cur], res[cur], type, width, pitch, image);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef DMXDAMAGE_H
+#define DMXDAMAGE_H
+
+#include <string.h>
+
+#include "bcm_host.h"
+
+// max separate spans (== write_data calls) per upload
+#define DAMAGE_MAX_SPANS 8
+// spans closer than this many rows are uploaded as one
+#define DAMAGE_MERGE_GAP 4
+
+typedef struct {
+    int y0;       // first row
+    int y1;       // one past the last row
+} DAMAGE_SPAN_T;
+
+typedef struct {
+    DAMAGE_SPAN_T spans[DAMAGE_MAX_SPANS];
+    int num;
+} DAMAGE_T;
+
+void damage_clear(DAMAGE_T *d) {
+    d->num = 0;
+}
+
+// add rows y .. y + h - 1 (keeps the spans sorted and merged)
+void damage_add_rows(DAMAGE_T *d, int y, int h) {
+    int i, j;
+    if (h <= 0)
+        return;
+    int y0 = y;
+    int y1 = y + h;
+
+    // find the first span that ends at or after the new one starts
+    for (i = 0; i < d->num; i++) {
+        if (d->spans[i].y1 + DAMAGE_MERGE_GAP >= y0)
+            break;
+    }
+    // swallow all the spans that touch the new one
+    j = i;
+    while ((j < d->num) && (d->spans[j].y0 <= y1 + DAMAGE_MERGE_GAP)) {
+        if (d->spans[j].y0 < y0)
+            y0 = d->spans[j].y0;
+        if (d->spans[j].y1 > y1)
+            y1 = d->spans[j].y1;
+        j++;
+    }
+    if (j > i) {
+        // replace spans i .. j-1 with the merged one
+        d->spans[i].y0 = y0;
+        d->spans[i].y1 = y1;
+        memmove(&d->spans[i + 1], &d->spans[j], (d->num - j) * sizeof(DAMAGE_SPAN_T));
+        d->num -= j - i - 1;
+        return;
+    }
+    if (d->num == DAMAGE_MAX_SPANS) {
+        // full - merge the two spans with the smallest gap in between
+        // (including the new one) to make room
+        int best = 0;
+        int k;
+        DAMAGE_SPAN_T tmp[DAMAGE_MAX_SPANS + 1];
+        memcpy(tmp, d->spans, i * sizeof(DAMAGE_SPAN_T));
+        tmp[i].y0 = y0;
+        tmp[i].y1 = y1;
+        memcpy(&tmp[i + 1], &d->spans[i], (d->num - i) * sizeof(DAMAGE_SPAN_T));
+        for (k = 1; k < DAMAGE_MAX_SPANS; k++) {
+            if (tmp[k + 1].y0 - tmp[k].y1 < tmp[best + 1].y0 - tmp[best].y1)
+                best = k;
+        }
+        tmp[best].y1 = tmp[best + 1].y1;
+        memmove(&tmp[best + 1], &tmp[best + 2],
+                (DAMAGE_MAX_SPANS - best - 1) * sizeof(DAMAGE_SPAN_T));
+        memcpy(d->spans, tmp, DAMAGE_MAX_SPANS * sizeof(DAMAGE_SPAN_T));
+        return;
+    }
+    // insert as a new span
+    memmove(&d->spans[i + 1], &d->spans[i], (d->num - i) * sizeof(DAMAGE_SPAN_T));
+    d->spans[i].y0 = y0;
+    d->spans[i].y1 = y1;
+    d->num++;
+}
+
+// add all the damage of 'src' to 'd'
+void damage_add(DAMAGE_T *d, const DAMAGE_T *src) {
+    int i;
+    for (i = 0; i < src->num; i++)
+        damage_add_rows(d, src->spans[i].y0, src->spans[i].y1 - src->spans[i].y0);
+}
+
+// number of rows in the damage
+int damage_rows(const DAMAGE_T *d) {
+    int i, n = 0;
+    for (i = 0; i < d->num; i++)
+        n += d->spans[i].y1 - d->spans[i].y0;
+    return n;
+}
+
+// upload the damaged rows of 'image' to the resource and clear the
+// damage - returns the number of bytes uploaded or -1 on error
+long damage_upload(DAMAGE_T *d, DISPMANX_RESOURCE_HANDLE_T res,
+                   VC_IMAGE_TYPE_T type, int width, int pitch, void *image) {
+    VC_RECT_T rect;
+    long bytes = 0;
+    int i;
+    for (i = 0; i < d->num; i++) {
+        int h = d->spans[i].y1 - d->spans[i].y0;
+        vc_dispmanx_rect_set(&rect, 0, d->spans[i].y0, width, h);
+        if (vc_dispmanx_resource_write_data(res, type, pitch, image, &rect) != 0)
+            return -1;
+        bytes += (long)pitch * h;
+    }
+    damage_clear(d);
+    return bytes;
+}
+
+#endif
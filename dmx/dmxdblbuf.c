@@ -7,6 +7,8 @@
 #include <sys/time.h>
 
 #include "bcm_host.h"
+#include "dmxdamage.h"
+#include "../fb/fbfill.h"
 
 #define WIDTH   200
 #define HEIGHT  200
@@ -29,23 +31,6 @@ typedef struct
 
 static RECT_VARS_T  gRectVars;
 
-static void FillRect( VC_IMAGE_TYPE_T type, void *image, int pitch, int aligned_height, int x, int y, int w, int h, int val )
-{
-    int         row;
-    int         col;
-
-    uint16_t *line = (uint16_t *)image + y * (pitch>>1) + x;
-
-    for ( row = 0; row < h; row++ )
-    {
-        for ( col = 0; col < w; col++ )
-        {
-            line[col] = val;
-        }
-        line += (pitch>>1);
-    }
-}
-
 int main(void)
 {
     RECT_VARS_T    *vars;
@@ -58,7 +43,6 @@ int main(void)
     VC_IMAGE_TYPE_T type = VC_IMAGE_RGB565;
     int width = WIDTH, height = HEIGHT;
     int pitch = ALIGN_UP(width*2, 32);
-    int aligned_height = ALIGN_UP(height, 16);
     VC_DISPMANX_ALPHA_T alpha = { 
 		DISPMANX_FLAGS_ALPHA_FROM_SOURCE | DISPMANX_FLAGS_ALPHA_FIXED_ALL_PIXELS, 
         255, /* fully opaque */
@@ -102,7 +86,7 @@ int main(void)
                           height );
 
 	// initial blank image (cover full image with a black rectangle)
-	FillRect( type, vars->image, pitch, aligned_height, 0, 0, width, height, 0x0 );
+	fill16_image_rect( vars->image, pitch, width, 0, 0, width, height, 0x0 );
 
 	// copy ('blit') the image to the first GPU buffer resource
 	ret = vc_dispmanx_resource_write_data(  vars->resource0,
@@ -136,6 +120,21 @@ int main(void)
     DISPMANX_RESOURCE_HANDLE_T cur_res = vars->resource1;
     DISPMANX_RESOURCE_HANDLE_T prev_res = vars->resource0;
 	DISPMANX_RESOURCE_HANDLE_T tmp_res;
+
+	// rows changed since each resource was last written - the first
+	// buffer is up to date, the second has never been written
+	DAMAGE_T dmg0, dmg1;
+	DAMAGE_T *cur_dmg = &dmg1;
+	DAMAGE_T *prev_dmg = &dmg0;
+	DAMAGE_T *tmp_dmg;
+	damage_clear( &dmg0 );
+	damage_clear( &dmg1 );
+	damage_add_rows( &dmg1, 0, height );
+
+	// where the rectangle was drawn in the previous frame (full image black)
+	int prev_y = 0, prev_h = 0;
+	long bytes, total_bytes = 0;
+	int frames = 0;
 	
 	// 'animation loop'
 	int i, j;
@@ -145,25 +144,49 @@ int main(void)
 	for (j = 0; j < 4; j++) {
 	  for (i = 0; i < maxstep; i += step) {
 	
+		int rx, ry, rw, rh;
 		// clear image (fill with black)
-		FillRect( type, vars->image, pitch, aligned_height, 0, 0, width, height, 0x0 );
+		fill16_image_rect( vars->image, pitch, width, 0, 0, width, height, 0x0 );
 		// for every second round of j ...
 		if (j % 2 == 0) {
 		  // draw a shrinking rectangle
-		  FillRect( type, vars->image, pitch, aligned_height, i * step, i * step, width - 2 * i * step, height - 2 * i * step, 0xF800 );
+		  rx = ry = i * step;
+		  rw = width - 2 * i * step;
+		  rh = height - 2 * i * step;
 		}
 		else {
 		  // draw a growing rectangle
-		  FillRect( type, vars->image, pitch, aligned_height, maxd - i * step, maxd - i * step, 2 * i * step, 2 * i * step, 0xF800 );
+		  rx = ry = maxd - i * step;
+		  rw = rh = 2 * i * step;
 		}
-
-		// blit image to the current resource
-		ret = vc_dispmanx_resource_write_data(  cur_res,
-												type,
-												pitch,
-												vars->image,
-												&dst_rect_res );
-		assert( ret == 0 );
+		fill16_image_rect( vars->image, pitch, width, rx, ry, rw, rh, 0xF800 );
+
+		// the rows that changed: where the rectangle was and where it is now
+		// (both resources need them - the other one gets them next frame)
+		damage_add_rows( cur_dmg, prev_y, prev_h );
+		damage_add_rows( cur_dmg, ry, rh );
+		damage_add_rows( prev_dmg, prev_y, prev_h );
+		damage_add_rows( prev_dmg, ry, rh );
+		prev_y = ry;
+		prev_h = rh;
+
+		// blit the changed rows of the image to the current resource
+		bytes = damage_upload( cur_dmg, cur_res, type, width, pitch, vars->image );
+		assert( bytes >= 0 );
+		total_bytes += bytes;
+		frames++;
+
+#ifdef BCM_HOST_STUB
+		// check that the resource now matches the image
+		{
+			int res_pitch = 0, row;
+			uint8_t *res_data = stub_resource_data( cur_res, &res_pitch );
+			for (row = 0; row < height; row++) {
+				assert( memcmp( res_data + row * res_pitch,
+								(uint8_t *)vars->image + row * pitch, width * 2 ) == 0 );
+			}
+		}
+#endif
 
 		// begin display update
 		vars->update = vc_dispmanx_update_start( 10 );
@@ -180,6 +203,9 @@ int main(void)
 		tmp_res = cur_res;
 		cur_res = prev_res;
 		prev_res = tmp_res;
+		tmp_dmg = cur_dmg;
+		cur_dmg = prev_dmg;
+		prev_dmg = tmp_dmg;
 		
 		// wait for a while
 		usleep( 1000000 / 60 );
@@ -187,6 +213,8 @@ int main(void)
 	}
 	
     printf( "Done.\n" );
+    printf( "Uploaded %ld bytes in %d frames (%ld per frame, full image %d)\n",
+            total_bytes, frames, total_bytes / frames, pitch * height );
 
 	// cleanup
     vars->update = vc_dispmanx_update_start( 10 );
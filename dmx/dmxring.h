@@ -0,0 +1,204 @@
+/*
+ * dmxring.h
+ *
+ * A ring of N dispmanx resources presented asynchronously - instead of
+ * vc_dispmanx_update_submit_sync (which blocks until the update is on
+ * screen) every frame is handed over with vc_dispmanx_update_submit and
+ * a completion callback, so rendering and uploading the next frame
+ * overlaps the previous update.
+ *
+ * Each resource is in one of three states:
+ *   free    - may be written
+ *   queued  - in a submitted update that is not on screen yet
+ *   shown   - on screen (becomes free when the next update completes)
+ * With N = 3 one resource is shown, one queued and one rendered, and the
+ * render thread only waits when it gets N - 1 frames ahead of the display.
+ *
+ * The callback runs on a dispmanx thread, so the state is behind a
+ * mutex. Per-resource damage (dmxdamage.h) keeps the uploads small.
+ *
+ * Usage:
+ *   dmx_ring_init(&ring, 3, type, width, height);
+ *   (vc_dispmanx_element_add with ring.res[0], submit_sync, dmx_ring_shown(&ring, 0))
+ *   each frame: i = dmx_ring_acquire(&ring);
+ *               (draw) dmx_ring_damage(&ring, y, h);
+ *               dmx_ring_upload(&ring, i, type, width, pitch, image);
+ *               dmx_ring_present(&ring, i, element);
+ *   dmx_ring_wait_idle(&ring); dmx_ring_free(&ring);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef DMXRING_H
+#define DMXRING_H
+
+#include <errno.h>
+#include <pthread.h>
+
+#include "bcm_host.h"
+#include "dmxdamage.h"
+
+#define DMX_RING_MAX 4
+
+#define DMX_RES_FREE   0
+#define DMX_RES_QUEUED 1
+#define DMX_RES_SHOWN  2
+
+typedef struct {
+    DISPMANX_RESOURCE_HANDLE_T res[DMX_RING_MAX];
+    uint32_t vc_image_ptr[DMX_RING_MAX];
+    DAMAGE_T dmg[DMX_RING_MAX];     // rows changed since last written
+    int state[DMX_RING_MAX];
+    int num;
+    int next;                       // resource to render next
+    // submitted resources, oldest first (updates complete in order)
+    int fifo[DMX_RING_MAX];
+    int queued;
+    int shown;                      // -1 before the first update
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // statistics
+    int presented;
+    int completed;
+    int waits;                      // dmx_ring_acquire calls that blocked
+} DMX_RING_T;
+
+void dmx_ring_free(DMX_RING_T *ring) {
+    int i;
+    for (i = 0; i < ring->num; i++) {
+        if (ring->res[i])
+            vc_dispmanx_resource_delete(ring->res[i]);
+    }
+    ring->num = 0;
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->cond);
+}
+
+// create n (2 .. DMX_RING_MAX) resources - all start fully damaged
+// - returns 0, EINVAL or ENOMEM
+int dmx_ring_init(DMX_RING_T *ring, int n, VC_IMAGE_TYPE_T type, int width, int height) {
+    int i;
+    memset(ring, 0, sizeof(*ring));
+    if ((n < 2) || (n > DMX_RING_MAX))
+        return EINVAL;
+    pthread_mutex_init(&ring->lock, 0);
+    pthread_cond_init(&ring->cond, 0);
+    ring->shown = -1;
+    for (i = 0; i < n; i++) {
+        ring->res[i] = vc_dispmanx_resource_create(type, width, height,
+                                                   &ring->vc_image_ptr[i]);
+        ring->num = i + 1;
+        if (!ring->res[i]) {
+            dmx_ring_free(ring);
+            return ENOMEM;
+        }
+        damage_clear(&ring->dmg[i]);
+        damage_add_rows(&ring->dmg[i], 0, height);
+        ring->state[i] = DMX_RES_FREE;
+    }
+    return 0;
+}
+
+// helper function to mark resource i shown (the previous one becomes free)
+static void dmx_ring_set_shown(DMX_RING_T *ring, int i) {
+    if ((ring->shown >= 0) && (ring->shown != i))
+        ring->state[ring->shown] = DMX_RES_FREE;
+    ring->state[i] = DMX_RES_SHOWN;
+    ring->shown = i;
+}
+
+// tell the ring that resource i was put on screen synchronously (the
+// initial element_add + submit_sync)
+void dmx_ring_shown(DMX_RING_T *ring, int i) {
+    pthread_mutex_lock(&ring->lock);
+    dmx_ring_set_shown(ring, i);
+    ring->next = (i + 1) % ring->num;
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// the completion callback - the oldest submitted update is on screen
+static void dmx_ring_done(DISPMANX_UPDATE_HANDLE_T u, void *arg) {
+    DMX_RING_T *ring = arg;
+    pthread_mutex_lock(&ring->lock);
+    if (ring->queued > 0) {
+        int i = ring->fifo[0];
+        memmove(&ring->fifo[0], &ring->fifo[1], (ring->queued - 1) * sizeof(int));
+        ring->queued--;
+        dmx_ring_set_shown(ring, i);
+        ring->completed++;
+    }
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// get the next resource to render to - waits only if it is still queued
+// or shown (the render thread is num - 1 frames ahead of the display)
+int dmx_ring_acquire(DMX_RING_T *ring) {
+    int i;
+    pthread_mutex_lock(&ring->lock);
+    i = ring->next;
+    if (ring->state[i] != DMX_RES_FREE) {
+        ring->waits++;
+        while (ring->state[i] != DMX_RES_FREE)
+            pthread_cond_wait(&ring->cond, &ring->lock);
+    }
+    ring->next = (i + 1) % ring->num;
+    pthread_mutex_unlock(&ring->lock);
+    return i;
+}
+
+// add changed rows of the image (to every resource)
+void dmx_ring_damage(DMX_RING_T *ring, int y, int h) {
+    int i;
+    for (i = 0; i < ring->num; i++)
+        damage_add_rows(&ring->dmg[i], y, h);
+}
+
+// upload the rows resource i is missing - returns bytes or -1 on error
+long dmx_ring_upload(DMX_RING_T *ring, int i, VC_IMAGE_TYPE_T type,
+                     int width, int pitch, void *image) {
+    return damage_upload(&ring->dmg[i], ring->res[i], type, width, pitch, image);
+}
+
+// show resource i on 'element' - returns at once, the resource stays
+// busy until the update after this one is on screen - returns 0 or EIO
+int dmx_ring_present(DMX_RING_T *ring, int i, DISPMANX_ELEMENT_HANDLE_T element) {
+    DISPMANX_UPDATE_HANDLE_T update = vc_dispmanx_update_start(10);
+    if (!update)
+        return EIO;
+    vc_dispmanx_element_change_source(update, element, ring->res[i]);
+    // queue before submitting, the callback may run before submit returns
+    pthread_mutex_lock(&ring->lock);
+    ring->state[i] = DMX_RES_QUEUED;
+    ring->fifo[ring->queued++] = i;
+    ring->presented++;
+    pthread_mutex_unlock(&ring->lock);
+    if (vc_dispmanx_update_submit(update, dmx_ring_done, ring) != 0) {
+        pthread_mutex_lock(&ring->lock);
+        ring->queued--;
+        ring->state[i] = DMX_RES_FREE;
+        ring->presented--;
+        pthread_mutex_unlock(&ring->lock);
+        return EIO;
+    }
+    return 0;
+}
+
+// wait until all the submitted updates are on screen
+void dmx_ring_wait_idle(DMX_RING_T *ring) {
+    pthread_mutex_lock(&ring->lock);
+    while (ring->queued > 0)
+        pthread_cond_wait(&ring->cond, &ring->lock);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ * bcm_host.h (stand-in)
+ *
+ * A stand-in for the parts of the Raspberry Pi bcm_host / dispmanx API
+ * used by the examples in this directory, for building and checking them
+ * off the Pi - the 'resources' are plain RAM buffers and the write calls
+ * and the bytes written are counted.
+ *
+ * Asynchronous updates (vc_dispmanx_update_submit) are applied one per
+ * 'vsync' by a thread ticking at 60 Hz, which then calls the completion
+ * callback - like the real one, from a thread other than the caller's.
+ * Writes to a resource that is on screen or in a submitted update are
+ * counted in busy_writes (that would tear on the real thing).
+ *
+ * To build against it (instead of /opt/vc/include):
+ *   gcc -O2 -Istub -o dmxdblbuf dmxdblbuf.c -lpthread
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef BCM_HOST_H
+#define BCM_HOST_H
+
+#define BCM_HOST_STUB 1
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+typedef uint32_t DISPMANX_DISPLAY_HANDLE_T;
+typedef uint32_t DISPMANX_UPDATE_HANDLE_T;
+typedef uint32_t DISPMANX_ELEMENT_HANDLE_T;
+typedef uint32_t DISPMANX_RESOURCE_HANDLE_T;
+typedef uint32_t DISPMANX_PROTECTION_T;
+
+#define DISPMANX_PROTECTION_NONE 0
+
+typedef enum {
+    VC_IMAGE_RGB565 = 1,
+    VC_IMAGE_RGB888 = 5,
+    VC_IMAGE_XRGB8888 = 18
+} VC_IMAGE_TYPE_T;
+
+typedef enum {
+    VC_IMAGE_ROT0 = 0
+} DISPMANX_TRANSFORM_T;
+
+typedef enum {
+    DISPMANX_FLAGS_ALPHA_FROM_SOURCE = 0,
+    DISPMANX_FLAGS_ALPHA_FIXED_ALL_PIXELS = 1
+} DISPMANX_FLAGS_ALPHA_T;
+
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+} VC_RECT_T;
+
+typedef struct {
+    int32_t width;
+    int32_t height;
+    DISPMANX_TRANSFORM_T transform;
+    int input_format;
+} DISPMANX_MODEINFO_T;
+
+typedef struct {
+    DISPMANX_FLAGS_ALPHA_T flags;
+    uint32_t opacity;
+    DISPMANX_RESOURCE_HANDLE_T mask;
+} VC_DISPMANX_ALPHA_T;
+
+typedef struct {
+    int mode;
+} DISPMANX_CLAMP_T;
+
+typedef void (*DISPMANX_CALLBACK_FUNC_T)(DISPMANX_UPDATE_HANDLE_T u, void *arg);
+
+// what the stand-in keeps track of
+#define STUB_MAX_RESOURCES 16
+#define STUB_MAX_QUEUED 16
+typedef struct {
+    DISPMANX_RESOURCE_HANDLE_T src;
+    DISPMANX_CALLBACK_FUNC_T cb;
+    void *arg;
+    DISPMANX_UPDATE_HANDLE_T update;
+} STUB_UPDATE_T;
+
+struct {
+    uint8_t *res_data[STUB_MAX_RESOURCES + 1]; // handle 0 is 'none'
+    int res_pitch[STUB_MAX_RESOURCES + 1];
+    int res_height[STUB_MAX_RESOURCES + 1];
+    DISPMANX_RESOURCE_HANDLE_T element_src; // what the element shows
+    DISPMANX_RESOURCE_HANDLE_T pending_src; // set in the open update
+    uint32_t updates;
+    long bytes_written;
+    int write_calls;
+    int busy_writes;                        // writes to shown/queued resources
+    // submitted asynchronous updates, oldest first
+    STUB_UPDATE_T queue[STUB_MAX_QUEUED];
+    int queued;
+    uint32_t vsyncs;
+    int running;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stub_dmx;
+
+// the 'vsync' thread - applies the oldest submitted update every 1/60 s
+// and calls its callback (outside the lock, the callback may do anything)
+static void *stub_vsync_thread(void *arg) {
+    for (;;) {
+        STUB_UPDATE_T u;
+        usleep(1000000 / 60);
+        pthread_mutex_lock(&stub_dmx.lock);
+        if (!stub_dmx.running) {
+            pthread_mutex_unlock(&stub_dmx.lock);
+            break;
+        }
+        stub_dmx.vsyncs++;
+        if (stub_dmx.queued == 0) {
+            pthread_mutex_unlock(&stub_dmx.lock);
+            continue;
+        }
+        u = stub_dmx.queue[0];
+        memmove(&stub_dmx.queue[0], &stub_dmx.queue[1],
+                (stub_dmx.queued - 1) * sizeof(STUB_UPDATE_T));
+        stub_dmx.queued--;
+        stub_dmx.element_src = u.src;
+        pthread_cond_broadcast(&stub_dmx.cond);
+        pthread_mutex_unlock(&stub_dmx.lock);
+        if (u.cb)
+            u.cb(u.update, u.arg);
+    }
+    return 0;
+}
+
+static inline void bcm_host_init(void) {
+    memset(&stub_dmx, 0, sizeof(stub_dmx));
+    pthread_mutex_init(&stub_dmx.lock, 0);
+    pthread_cond_init(&stub_dmx.cond, 0);
+    stub_dmx.running = 1;
+    pthread_create(&stub_dmx.thread, 0, stub_vsync_thread, 0);
+}
+
+static inline void bcm_host_deinit(void) {
+    pthread_mutex_lock(&stub_dmx.lock);
+    stub_dmx.running = 0;
+    pthread_mutex_unlock(&stub_dmx.lock);
+    pthread_join(stub_dmx.thread, 0);
+}
+
+static inline DISPMANX_DISPLAY_HANDLE_T vc_dispmanx_display_open(uint32_t device) {
+    return 1;
+}
+
+static inline int vc_dispmanx_display_get_info(DISPMANX_DISPLAY_HANDLE_T display,
+                                        DISPMANX_MODEINFO_T *pinfo) {
+    memset(pinfo, 0, sizeof(*pinfo));
+    pinfo->width = 1920;
+    pinfo->height = 1080;
+    return 0;
+}
+
+static inline int vc_dispmanx_display_close(DISPMANX_DISPLAY_HANDLE_T display) {
+    return 0;
+}
+
+static inline int vc_dispmanx_rect_set(VC_RECT_T *rect, uint32_t x_offset, uint32_t y_offset,
+                                uint32_t width, uint32_t height) {
+    rect->x = x_offset;
+    rect->y = y_offset;
+    rect->width = width;
+    rect->height = height;
+    return 0;
+}
+
+static inline DISPMANX_RESOURCE_HANDLE_T vc_dispmanx_resource_create(VC_IMAGE_TYPE_T type,
+        uint32_t width, uint32_t height, uint32_t *native_image_handle) {
+    int bpp = (type == VC_IMAGE_RGB565) ? 2 : (type == VC_IMAGE_RGB888) ? 3 : 4;
+    DISPMANX_RESOURCE_HANDLE_T h;
+    for (h = 1; h <= STUB_MAX_RESOURCES; h++) {
+        if (stub_dmx.res_data[h] == 0) {
+            // same 32 byte aligned pitch as the examples use
+            stub_dmx.res_pitch[h] = (width * bpp + 31) & ~31;
+            stub_dmx.res_height[h] = height;
+            stub_dmx.res_data[h] = calloc(1, stub_dmx.res_pitch[h] * height);
+            *native_image_handle = h;
+            return stub_dmx.res_data[h] ? h : 0;
+        }
+    }
+    return 0;
+}
+
+static inline int vc_dispmanx_resource_delete(DISPMANX_RESOURCE_HANDLE_T res) {
+    if ((res == 0) || (res > STUB_MAX_RESOURCES) || (stub_dmx.res_data[res] == 0))
+        return -1;
+    free(stub_dmx.res_data[res]);
+    stub_dmx.res_data[res] = 0;
+    return 0;
+}
+
+// like the real one, the x of the rectangle is not used - whole rows
+// starting from row rect->y of the source are transferred
+static inline int vc_dispmanx_resource_write_data(DISPMANX_RESOURCE_HANDLE_T res,
+        VC_IMAGE_TYPE_T src_type, int src_pitch, void *src_address,
+        const VC_RECT_T *rect) {
+    if ((res == 0) || (res > STUB_MAX_RESOURCES) || (stub_dmx.res_data[res] == 0))
+        return -1;
+    if ((rect->y < 0) || (rect->y + rect->height > stub_dmx.res_height[res])
+        || (src_pitch > stub_dmx.res_pitch[res]))
+        return -1;
+    int y, i;
+    pthread_mutex_lock(&stub_dmx.lock);
+    if (res == stub_dmx.element_src)
+        stub_dmx.busy_writes++;
+    for (i = 0; i < stub_dmx.queued; i++) {
+        if (res == stub_dmx.queue[i].src)
+            stub_dmx.busy_writes++;
+    }
+    pthread_mutex_unlock(&stub_dmx.lock);
+    for (y = rect->y; y < rect->y + rect->height; y++) {
+        memcpy(stub_dmx.res_data[res] + y * stub_dmx.res_pitch[res],
+               (uint8_t *)src_address + y * src_pitch, src_pitch);
+    }
+    stub_dmx.bytes_written += (long)src_pitch * rect->height;
+    stub_dmx.write_calls++;
+    return 0;
+}
+
+static inline DISPMANX_UPDATE_HANDLE_T vc_dispmanx_update_start(int32_t priority) {
+    pthread_mutex_lock(&stub_dmx.lock);
+    // start from what the element will show once the queue is done
+    stub_dmx.pending_src = (stub_dmx.queued > 0)
+                         ? stub_dmx.queue[stub_dmx.queued - 1].src : stub_dmx.element_src;
+    pthread_mutex_unlock(&stub_dmx.lock);
+    return ++stub_dmx.updates;
+}
+
+static inline DISPMANX_ELEMENT_HANDLE_T vc_dispmanx_element_add(DISPMANX_UPDATE_HANDLE_T update,
+        DISPMANX_DISPLAY_HANDLE_T display, int32_t layer, const VC_RECT_T *dest_rect,
+        DISPMANX_RESOURCE_HANDLE_T src, const VC_RECT_T *src_rect,
+        DISPMANX_PROTECTION_T protection, VC_DISPMANX_ALPHA_T *alpha,
+        DISPMANX_CLAMP_T *clamp, DISPMANX_TRANSFORM_T transform) {
+    stub_dmx.pending_src = src;
+    return 1;
+}
+
+static inline int vc_dispmanx_element_change_source(DISPMANX_UPDATE_HANDLE_T update,
+        DISPMANX_ELEMENT_HANDLE_T element, DISPMANX_RESOURCE_HANDLE_T src) {
+    stub_dmx.pending_src = src;
+    return 0;
+}
+
+static inline int vc_dispmanx_element_remove(DISPMANX_UPDATE_HANDLE_T update,
+                                      DISPMANX_ELEMENT_HANDLE_T element) {
+    stub_dmx.pending_src = 0;
+    return 0;
+}
+
+// queue the update for the next 'vsync' - returns immediately
+static inline int vc_dispmanx_update_submit(DISPMANX_UPDATE_HANDLE_T update,
+                                     DISPMANX_CALLBACK_FUNC_T cb_func, void *cb_arg) {
+    pthread_mutex_lock(&stub_dmx.lock);
+    if (stub_dmx.queued == STUB_MAX_QUEUED) {
+        pthread_mutex_unlock(&stub_dmx.lock);
+        return -1;
+    }
+    stub_dmx.queue[stub_dmx.queued].src = stub_dmx.pending_src;
+    stub_dmx.queue[stub_dmx.queued].cb = cb_func;
+    stub_dmx.queue[stub_dmx.queued].arg = cb_arg;
+    stub_dmx.queue[stub_dmx.queued].update = update;
+    stub_dmx.queued++;
+    pthread_mutex_unlock(&stub_dmx.lock);
+    return 0;
+}
+
+// wait for the earlier updates, then apply this one right away
+static inline int vc_dispmanx_update_submit_sync(DISPMANX_UPDATE_HANDLE_T update) {
+    pthread_mutex_lock(&stub_dmx.lock);
+    while (stub_dmx.queued > 0)
+        pthread_cond_wait(&stub_dmx.cond, &stub_dmx.lock);
+    stub_dmx.element_src = stub_dmx.pending_src;
+    pthread_mutex_unlock(&stub_dmx.lock);
+    return 0;
+}
+
+// helper for checking: the pixels of a resource (0 if no such resource)
+static inline uint8_t *stub_resource_data(DISPMANX_RESOURCE_HANDLE_T res, int *pitch) {
+    if ((res == 0) || (res > STUB_MAX_RESOURCES))
+        return 0;
+    *pitch = stub_dmx.res_pitch[res];
+    return stub_dmx.res_data[res];
+}
+
+#endif
@@ -0,0 +1,453 @@
+/*
+ * fbblend.h
+ *
+ * Alpha blending - source-over and additive blending of a surface (or a
+ * solid color) onto another, with a constant alpha, the source's own
+ * alpha and/or an 8 bit coverage mask (anti-aliased glyphs and icons).
+ *
+ * Every row goes through a premultiplied ARGB8888 buffer (CONV_CHUNK
+ * pixels, stays in L1 cache): the source is converted to it and scaled
+ * by the coverage, then blended onto the destination with a kernel for
+ * the destination format. XRGB8888 and RGB565 destinations are blended
+ * in place, others (RGB24, PAL8) through an XRGB8888 row like fbblit.h.
+ *
+ * The kernels have SSE2 and NEON versions and plain C fallbacks that
+ * give exactly the same results (x / 255 is rounded the same way).
+ *
+ * Source alpha: with BLEND_SRC_ALPHA the top byte of an XRGB8888 source
+ * is its alpha (0 = transparent), with BLEND_PREMUL as well the color is
+ * already multiplied by it. Other sources are opaque. Masks are PAL8
+ * surfaces (the 'index' is the coverage 0-255) in source coordinates.
+ *
+ * Usage:
+ *   blend(&page, x, y, &icon, 0, 0, BLEND_OVER | BLEND_SRC_ALPHA, 255);
+ *   blend_fill(&page, &panel_rect, 0x000040, BLEND_OVER, 160);
+ *   blend_mask(&page, x, y, &glyphs, &glyph_rect, 0xFFFFFF, BLEND_OVER, 255);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBBLEND_H
+#define FBBLEND_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "fbsurf.h"
+#include "fbblit.h"
+
+// modes
+#define BLEND_OVER 0          // d = s + d * (1 - sa)
+#define BLEND_ADD 1           // d = min(d + s, 1)
+#define BLEND_MODE_MASK 0xFF
+// flags
+#define BLEND_SRC_ALPHA 0x100 // XRGB8888 source has alpha in the top byte
+#define BLEND_PREMUL 0x200    // ... and is premultiplied
+
+// x / 255 rounded, for x in 0 .. 255 * 255
+static inline uint32_t blend_div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+#if defined(__SSE2__)
+// the same for eight 16 bit lanes
+static inline __m128i blend_div255_epi16(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// alpha of two unpacked pixels in all four lanes of each
+static inline __m128i blend_alpha_epi16(__m128i p) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xFF), 0xFF);
+}
+#elif defined(__ARM_NEON)
+static inline uint8x8_t blend_div255_u16(uint16x8_t x) {
+    return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+}
+#endif
+
+// multiply the colors of ARGB pixels by their alpha
+static void blend_premul_x32(uint32_t *p, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    // lanes 0-2 by alpha, lane 3 (alpha) by 255
+    __m128i keep = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    __m128i a255 = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((__m128i *)(p + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i alo = _mm_or_si128(_mm_andnot_si128(keep, blend_alpha_epi16(lo)), a255);
+        __m128i ahi = _mm_or_si128(_mm_andnot_si128(keep, blend_alpha_epi16(hi)), a255);
+        lo = blend_div255_epi16(_mm_mullo_epi16(lo, alo));
+        hi = blend_div255_epi16(_mm_mullo_epi16(hi, ahi));
+        _mm_storeu_si128((__m128i *)(p + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t v = vld4_u8((uint8_t *)(p + i));
+        v.val[0] = blend_div255_u16(vmull_u8(v.val[0], v.val[3]));
+        v.val[1] = blend_div255_u16(vmull_u8(v.val[1], v.val[3]));
+        v.val[2] = blend_div255_u16(vmull_u8(v.val[2], v.val[3]));
+        vst4_u8((uint8_t *)(p + i), v);
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t c = p[i];
+        uint32_t a = c >> 24;
+        p[i] = (a << 24) | (blend_div255(((c >> 16) & 0xFF) * a) << 16)
+             | (blend_div255(((c >> 8) & 0xFF) * a) << 8) | blend_div255((c & 0xFF) * a);
+    }
+}
+
+// multiply all four channels of premultiplied pixels by a coverage
+static void blend_scale_x32(uint32_t *p, const uint8_t *cov, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        uint32_t c4;
+        memcpy(&c4, cov + i, 4);
+        __m128i c = _mm_cvtsi32_si128(c4);
+        c = _mm_unpacklo_epi8(c, c);
+        c = _mm_unpacklo_epi16(c, c);  // each coverage byte four times
+        __m128i v = _mm_loadu_si128((__m128i *)(p + i));
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), _mm_unpacklo_epi8(c, zero));
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), _mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128((__m128i *)(p + i),
+                         _mm_packus_epi16(blend_div255_epi16(lo), blend_div255_epi16(hi)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t v = vld4_u8((uint8_t *)(p + i));
+        uint8x8_t c = vld1_u8(cov + i);
+        v.val[0] = blend_div255_u16(vmull_u8(v.val[0], c));
+        v.val[1] = blend_div255_u16(vmull_u8(v.val[1], c));
+        v.val[2] = blend_div255_u16(vmull_u8(v.val[2], c));
+        v.val[3] = blend_div255_u16(vmull_u8(v.val[3], c));
+        vst4_u8((uint8_t *)(p + i), v);
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t c = p[i];
+        uint32_t a = cov[i];
+        p[i] = (blend_div255((c >> 24) * a) << 24)
+             | (blend_div255(((c >> 16) & 0xFF) * a) << 16)
+             | (blend_div255(((c >> 8) & 0xFF) * a) << 8) | blend_div255((c & 0xFF) * a);
+    }
+}
+
+// source-over of premultiplied pixels onto XRGB8888 pixels
+static void blend_over_x32(uint32_t *d, const uint32_t *s, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i ff = _mm_set1_epi16(255);
+    for (; i + 4 <= n; i += 4) {
+        __m128i sv = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i dv = _mm_loadu_si128((__m128i *)(d + i));
+        __m128i ilo = _mm_sub_epi16(ff, blend_alpha_epi16(_mm_unpacklo_epi8(sv, zero)));
+        __m128i ihi = _mm_sub_epi16(ff, blend_alpha_epi16(_mm_unpackhi_epi8(sv, zero)));
+        __m128i lo = blend_div255_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), ilo));
+        __m128i hi = blend_div255_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), ihi));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), sv));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t sv = vld4_u8((const uint8_t *)(s + i));
+        uint8x8x4_t dv = vld4_u8((uint8_t *)(d + i));
+        uint8x8_t ia = vmvn_u8(sv.val[3]);
+        int c;
+        for (c = 0; c < 4; c++)
+            dv.val[c] = vqadd_u8(blend_div255_u16(vmull_u8(dv.val[c], ia)), sv.val[c]);
+        vst4_u8((uint8_t *)(d + i), dv);
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t sc = s[i], dc = d[i];
+        uint32_t ia = 255 - (sc >> 24);
+        uint32_t out = 0;
+        int sh;
+        for (sh = 0; sh < 32; sh += 8) {
+            uint32_t v = blend_div255(((dc >> sh) & 0xFF) * ia) + ((sc >> sh) & 0xFF);
+            out |= ((v > 255) ? 255 : v) << sh;
+        }
+        d[i] = out;
+    }
+}
+
+// additive blend of premultiplied pixels onto XRGB8888 pixels
+static void blend_add_x32(uint32_t *d, const uint32_t *s, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i sv = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i dv = _mm_loadu_si128((__m128i *)(d + i));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_adds_epu8(dv, sv));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        uint8x16_t sv = vld1q_u8((const uint8_t *)(s + i));
+        uint8x16_t dv = vld1q_u8((uint8_t *)(d + i));
+        vst1q_u8((uint8_t *)(d + i), vqaddq_u8(dv, sv));
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t sc = s[i], dc = d[i];
+        uint32_t out = 0;
+        int sh;
+        for (sh = 0; sh < 32; sh += 8) {
+            uint32_t v = ((dc >> sh) & 0xFF) + ((sc >> sh) & 0xFF);
+            out |= ((v > 255) ? 255 : v) << sh;
+        }
+        d[i] = out;
+    }
+}
+
+// helper function for one RGB565 pixel - expands and packs (truncating)
+// like conv_to_xrgb / conv_from_xrgb
+static inline uint16_t blend_565(uint16_t dc, uint32_t sc, int add) {
+    uint32_t r = (dc >> 11) & 0x1F;
+    uint32_t g = (dc >> 5) & 0x3F;
+    uint32_t b = dc & 0x1F;
+    uint32_t ia = add ? 255 : 255 - (sc >> 24);
+    r = (r << 3) | (r >> 2);
+    g = (g << 2) | (g >> 4);
+    b = (b << 3) | (b >> 2);
+    if (!add) {
+        r = blend_div255(r * ia);
+        g = blend_div255(g * ia);
+        b = blend_div255(b * ia);
+    }
+    r += (sc >> 16) & 0xFF;
+    g += (sc >> 8) & 0xFF;
+    b += sc & 0xFF;
+    if (r > 255) r = 255;
+    if (g > 255) g = 255;
+    if (b > 255) b = 255;
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+// source-over (add == 0) or additive blend onto RGB565 pixels
+static void blend_row_565(uint16_t *d, const uint32_t *s, int n, int add) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i ff = _mm_set1_epi16(255);
+    __m128i m8 = _mm_set1_epi32(0xFF);
+    for (; i + 8 <= n; i += 8) {
+        __m128i s0 = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i s1 = _mm_loadu_si128((const __m128i *)(s + i + 4));
+        __m128i dv = _mm_loadu_si128((__m128i *)(d + i));
+        // source channels in 16 bit lanes
+        __m128i sb = _mm_packs_epi32(_mm_and_si128(s0, m8), _mm_and_si128(s1, m8));
+        __m128i sg = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 8), m8),
+                                     _mm_and_si128(_mm_srli_epi32(s1, 8), m8));
+        __m128i sr = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(s0, 16), m8),
+                                     _mm_and_si128(_mm_srli_epi32(s1, 16), m8));
+        // destination channels expanded to 8 bits
+        __m128i r = _mm_srli_epi16(dv, 11);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(dv, 5), _mm_set1_epi16(0x3F));
+        __m128i b = _mm_and_si128(dv, _mm_set1_epi16(0x1F));
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+        if (!add) {
+            __m128i ia = _mm_sub_epi16(ff, _mm_packs_epi32(_mm_srli_epi32(s0, 24),
+                                                           _mm_srli_epi32(s1, 24)));
+            r = blend_div255_epi16(_mm_mullo_epi16(r, ia));
+            g = blend_div255_epi16(_mm_mullo_epi16(g, ia));
+            b = blend_div255_epi16(_mm_mullo_epi16(b, ia));
+        }
+        r = _mm_min_epi16(_mm_add_epi16(r, sr), ff);
+        g = _mm_min_epi16(_mm_add_epi16(g, sg), ff);
+        b = _mm_min_epi16(_mm_add_epi16(b, sb), ff);
+        __m128i out = _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+                      _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(g, 2), 5),
+                                   _mm_srli_epi16(b, 3)));
+        _mm_storeu_si128((__m128i *)(d + i), out);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t sv = vld4_u8((const uint8_t *)(s + i));
+        uint16x8_t dv = vld1q_u16(d + i);
+        uint16x8_t r16 = vshrq_n_u16(dv, 11);
+        uint16x8_t g16 = vandq_u16(vshrq_n_u16(dv, 5), vdupq_n_u16(0x3F));
+        uint16x8_t b16 = vandq_u16(dv, vdupq_n_u16(0x1F));
+        uint8x8_t r = vmovn_u16(vorrq_u16(vshlq_n_u16(r16, 3), vshrq_n_u16(r16, 2)));
+        uint8x8_t g = vmovn_u16(vorrq_u16(vshlq_n_u16(g16, 2), vshrq_n_u16(g16, 4)));
+        uint8x8_t b = vmovn_u16(vorrq_u16(vshlq_n_u16(b16, 3), vshrq_n_u16(b16, 2)));
+        if (!add) {
+            uint8x8_t ia = vmvn_u8(sv.val[3]);
+            r = blend_div255_u16(vmull_u8(r, ia));
+            g = blend_div255_u16(vmull_u8(g, ia));
+            b = blend_div255_u16(vmull_u8(b, ia));
+        }
+        r = vqadd_u8(r, sv.val[2]);
+        g = vqadd_u8(g, sv.val[1]);
+        b = vqadd_u8(b, sv.val[0]);
+        uint16x8_t out = vandq_u16(vshll_n_u8(r, 8), vdupq_n_u16(0xF800));
+        out = vorrq_u16(out, vandq_u16(vshll_n_u8(g, 3), vdupq_n_u16(0x07E0)));
+        out = vorrq_u16(out, vmovl_u8(vshr_n_u8(b, 3)));
+        vst1q_u16(d + i, out);
+    }
+#endif
+    for (; i < n; i++)
+        d[i] = blend_565(d[i], s[i], add);
+}
+
+// helper function to blend a row of premultiplied pixels onto 'dp'
+static void blend_row(uint8_t *dp, PIX_FMT_T fmt, const PALETTE_T *pal,
+                      const uint32_t *s, int n, int mode) {
+    uint32_t tmp[CONV_CHUNK];
+    int add = ((mode & BLEND_MODE_MASK) == BLEND_ADD);
+    switch (fmt) {
+    case PIX_FMT_XRGB8888:
+        if (add)
+            blend_add_x32((uint32_t *)dp, s, n);
+        else
+            blend_over_x32((uint32_t *)dp, s, n);
+        break;
+    case PIX_FMT_RGB565:
+        blend_row_565((uint16_t *)dp, s, n, add);
+        break;
+    default:
+        conv_to_xrgb(tmp, dp, n, fmt, pal);
+        if (add)
+            blend_add_x32(tmp, s, n);
+        else
+            blend_over_x32(tmp, s, n);
+        conv_from_xrgb(dp, tmp, n, fmt, pal);
+        break;
+    }
+}
+
+// helper function to get the coverage of a row: mask * alpha (0 for
+// no mask) - returns 0 if every pixel is fully covered
+static int blend_coverage(uint8_t *cov, const uint8_t *mask, int n, int alpha) {
+    int i;
+    if (mask == 0) {
+        if (alpha >= 255)
+            return 0;
+        memset(cov, alpha, n);
+    }
+    else if (alpha >= 255) {
+        memcpy(cov, mask, n);
+    }
+    else {
+        for (i = 0; i < n; i++)
+            cov[i] = blend_div255(mask[i] * alpha);
+    }
+    return 1;
+}
+
+// blend the 'srect' part of 'src' (0 for all of it) onto dx,dy in 'dst'
+// - 'mask' (0 for none) is a PAL8 coverage surface in source coordinates,
+// 'alpha' (0-255) is applied to every pixel - 'src' and 'dst' may not
+// overlap - returns the number of rows drawn
+int blend(SURFACE_T *dst, int dx, int dy, const SURFACE_T *src,
+          const RECT_T *srect, const SURFACE_T *mask, int mode, int alpha) {
+    RECT_T sr = { 0, 0, src->width, src->height };
+    uint32_t buf[CONV_CHUNK];
+    uint8_t cov[CONV_CHUNK];
+    int y, x, k;
+
+    if (srect != 0)
+        sr = *srect;
+    if (mask != 0) {
+        RECT_T mall = { 0, 0, mask->width, mask->height };
+        RECT_T r;
+        if ((mask->fmt != PIX_FMT_PAL8) || !rect_intersect(&r, &sr, &mall))
+            return 0;
+        dx += r.x - sr.x;
+        dy += r.y - sr.y;
+        sr = r;
+    }
+    if ((alpha <= 0) || !blit_clip(dst, &dx, &dy, src, &sr))
+        return 0;
+
+    int sb = pix_fmt_bytes(src->fmt);
+    int db = pix_fmt_bytes(dst->fmt);
+    int own = (mode & BLEND_SRC_ALPHA) && (src->fmt == PIX_FMT_XRGB8888);
+    for (y = 0; y < sr.h; y++) {
+        const uint8_t *sp = (const uint8_t *)surface_pixel(src, sr.x, sr.y + y);
+        const uint8_t *mp = mask ? (const uint8_t *)surface_pixel(mask, sr.x, sr.y + y) : 0;
+        uint8_t *dp = (uint8_t *)surface_pixel(dst, dx, dy + y);
+        for (x = 0; x < sr.w; x += k) {
+            k = (sr.w - x > CONV_CHUNK) ? CONV_CHUNK : sr.w - x;
+            conv_to_xrgb(buf, sp + x * sb, k, src->fmt, src->pal);
+            if (!own) {
+                int i;
+                for (i = 0; i < k; i++)
+                    buf[i] |= 0xFF000000;
+            }
+            else if (!(mode & BLEND_PREMUL)) {
+                blend_premul_x32(buf, k);
+            }
+            if (blend_coverage(cov, mp ? mp + x : 0, k, alpha))
+                blend_scale_x32(buf, cov, k);
+            blend_row(dp + x * db, dst->fmt, dst->pal, buf, k, mode);
+        }
+    }
+    return sr.h;
+}
+
+// helper function for the solid color blends
+static int blend_solid(SURFACE_T *dst, int dx, int dy, int w, int h, uint32_t rgb,
+                       const SURFACE_T *mask, int mx, int my, int mode, int alpha) {
+    uint32_t buf[CONV_CHUNK];
+    uint8_t cov[CONV_CHUNK];
+    int y, x, k, i;
+    int db = pix_fmt_bytes(dst->fmt);
+    for (y = 0; y < h; y++) {
+        const uint8_t *mp = mask ? (const uint8_t *)surface_pixel(mask, mx, my + y) : 0;
+        uint8_t *dp = (uint8_t *)surface_pixel(dst, dx, dy + y);
+        for (x = 0; x < w; x += k) {
+            k = (w - x > CONV_CHUNK) ? CONV_CHUNK : w - x;
+            for (i = 0; i < k; i++)
+                buf[i] = rgb | 0xFF000000;
+            if (blend_coverage(cov, mp ? mp + x : 0, k, alpha))
+                blend_scale_x32(buf, cov, k);
+            blend_row(dp + x * db, dst->fmt, dst->pal, buf, k, mode);
+        }
+    }
+    return h;
+}
+
+// blend a solid color (0xRRGGBB) over a rectangle (clipped) - returns rows drawn
+int blend_fill(SURFACE_T *dst, const RECT_T *r, uint32_t rgb, int mode, int alpha) {
+    RECT_T all = { 0, 0, dst->width, dst->height };
+    RECT_T cr;
+    if ((alpha <= 0) || !rect_intersect(&cr, r, &all))
+        return 0;
+    return blend_solid(dst, cr.x, cr.y, cr.w, cr.h, rgb & 0xFFFFFF, 0, 0, 0, mode, alpha);
+}
+
+// blend a solid color through the 'mrect' part of a PAL8 coverage mask
+// (0 for all of it) to dx,dy - for anti-aliased text - returns rows drawn
+int blend_mask(SURFACE_T *dst, int dx, int dy, const SURFACE_T *mask,
+               const RECT_T *mrect, uint32_t rgb, int mode, int alpha) {
+    RECT_T mr = { 0, 0, mask->width, mask->height };
+    if (mrect != 0)
+        mr = *mrect;
+    if ((mask->fmt != PIX_FMT_PAL8) || (alpha <= 0) || !blit_clip(dst, &dx, &dy, mask, &mr))
+        return 0;
+    return blend_solid(dst, dx, dy, mr.w, mr.h, rgb & 0xFFFFFF, mask, mr.x, mr.y, mode, alpha);
+}
+
+#endif
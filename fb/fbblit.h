@@ -0,0 +1,131 @@
+/*
+ * fbblit.h
+ *
+ * Generic image 'blitter' - copies a rectangle of one surface to another
+ *   - both the source and the destination rectangle are clipped
+ *     (so an image may be bigger than the screen or partially outside it)
+ *   - optional color-key transparency (pixels matching the key are skipped)
+ *   - conversion between the 8 bit palette, RGB565, 24 bit and XRGB8888
+ *     layouts - same format copies are plain memcpy/memmove per row
+ *
+ * The conversions are done by conv_row (fbconv.h) - through a short
+ * XRGB8888 row buffer, with SIMD kernels where the CPU has them.
+ *
+ * Usage:
+ *   blit(&screen, x, y, &image, 0, 0, 0);                 // whole image
+ *   blit(&screen, x, y, &sprite, &frame, BLIT_COLORKEY, 0xF81F);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBBLIT_H
+#define FBBLIT_H
+
+#include <string.h>
+
+#include "fbsurf.h"
+#include "fbconv.h"
+
+// flags
+#define BLIT_COLORKEY 1 // skip source pixels equal to the key
+
+// helper function to read the raw value of a pixel (for the color key)
+static inline uint32_t blit_raw_pixel(const uint8_t *p, PIX_FMT_T fmt) {
+    switch (fmt) {
+    case PIX_FMT_PAL8:     return p[0];
+    case PIX_FMT_RGB565:   return *((const uint16_t *)p);
+    case PIX_FMT_XRGB8888: return *((const uint32_t *)p) & 0xFFFFFF;
+    case PIX_FMT_BGR888:   return (p[2] << 16) | (p[1] << 8) | p[0];
+    default:               return (p[0] << 16) | (p[1] << 8) | p[2];
+    }
+}
+
+// helper function to clip a blit - adjusts the source rectangle and the
+// destination position, returns 0 if nothing is left to draw
+static int blit_clip(const SURFACE_T *dst, int *dx, int *dy,
+                     const SURFACE_T *src, RECT_T *sr) {
+    RECT_T sall = { 0, 0, src->width, src->height };
+    RECT_T dall = { 0, 0, dst->width, dst->height };
+    RECT_T r;
+    // source rectangle to the source surface
+    if (!rect_intersect(&r, sr, &sall))
+        return 0;
+    *dx += r.x - sr->x;
+    *dy += r.y - sr->y;
+    *sr = r;
+    // destination rectangle to the destination surface
+    RECT_T d = { *dx, *dy, sr->w, sr->h };
+    if (!rect_intersect(&r, &d, &dall))
+        return 0;
+    sr->x += r.x - d.x;
+    sr->y += r.y - d.y;
+    sr->w = r.w;
+    sr->h = r.h;
+    *dx = r.x;
+    *dy = r.y;
+    return 1;
+}
+
+// copy the 'srect' part of 'src' (0 for all of it) to dx,dy in 'dst' -
+// 'key' is the raw source pixel value to skip with BLIT_COLORKEY
+// (palette index, 5:6:5 value or 0xRRGGBB) - returns the number of
+// rows drawn (0 if completely clipped away)
+int blit(SURFACE_T *dst, int dx, int dy, const SURFACE_T *src,
+         const RECT_T *srect, int flags, uint32_t key) {
+    RECT_T sr = { 0, 0, src->width, src->height };
+    int y, x;
+
+    if (srect != 0)
+        sr = *srect;
+    if (!blit_clip(dst, &dx, &dy, src, &sr))
+        return 0;
+
+    int sb = pix_fmt_bytes(src->fmt);
+    int db = pix_fmt_bytes(dst->fmt);
+    const uint8_t *sp = (const uint8_t *)surface_pixel(src, sr.x, sr.y);
+    uint8_t *dp = (uint8_t *)surface_pixel(dst, dx, dy);
+    int sstep = src->line_length;
+    int dstep = dst->line_length;
+
+    // go bottom up if copying within the same buffer downwards
+    if (dp > sp) {
+        sp += (sr.h - 1) * sstep;
+        dp += (sr.h - 1) * dstep;
+        sstep = -sstep;
+        dstep = -dstep;
+    }
+
+    for (y = 0; y < sr.h; y++) {
+        if (flags & BLIT_COLORKEY) {
+            // convert/copy the runs between the key colored pixels
+            x = 0;
+            while (x < sr.w) {
+                while ((x < sr.w) && (blit_raw_pixel(sp + x * sb, src->fmt) == key))
+                    x++;
+                int x0 = x;
+                while ((x < sr.w) && (blit_raw_pixel(sp + x * sb, src->fmt) != key))
+                    x++;
+                if (x > x0) {
+                    conv_row(dp + x0 * db, dst->fmt, dst->pal,
+                             sp + x0 * sb, src->fmt, src->pal, x - x0);
+                }
+            }
+        }
+        else {
+            conv_row(dp, dst->fmt, dst->pal, sp, src->fmt, src->pal, sr.w);
+        }
+        sp += sstep;
+        dp += dstep;
+    }
+    return sr.h;
+}
+
+#endif
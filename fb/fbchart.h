@@ -0,0 +1,241 @@
+/*
+ * fbchart.h
+ *
+ * Strip chart - a line of samples scrolling from right to left, for
+ * live values on a panel.
+ *
+ * The chart is drawn into an off-screen surface that is a ring of
+ * columns: a new sample is one new column written over the oldest one
+ * (the background, the grid and a vertical span from the previous value
+ * to the new one), nothing is moved or redrawn - adding samples costs
+ * O(new samples x chart height). chart_present puts the ring on the
+ * screen in order as two plain copies (oldest part to the left, the
+ * rest to the right of it) with wc_present, so the screen is only ever
+ * written, never read.
+ *
+ * The samples are kept too (one per column) - the chart is drawn again
+ * from them only when the value range changes (chart_range).
+ *
+ * A sample that is NaN leaves a gap in the line.
+ *
+ * Colors are raw surface values (palette index, 5:6:5...).
+ *
+ * Usage:
+ *   CHART_T chart;
+ *   chart_init(&chart, 400, 120, screen.fmt, 0.0f, 100.0f);
+ *   chart.fg = ...; chart.grid_y = 30; chart.grid_x = 50;
+ *   chart_clear(&chart);
+ *   chart_add(&chart, &value, 1);
+ *   chart_present(&chart, &screen, 20, 20);
+ *   chart_free(&chart);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBCHART_H
+#define FBCHART_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "fbsurf.h"
+#include "fbmap.h"
+#include "fbwc.h"
+
+typedef struct {
+    SURFACE_T ring;     // the columns, head is the oldest
+    float *samples;     // sample of each column
+    int head;           // column for the next sample
+    long count;         // samples added so far
+    float min;          // value at the bottom row
+    float max;          // value at the top row
+    int last_y;         // row of the previous sample, -1: none
+    uint32_t fg;        // line color
+    uint32_t bg;
+    uint32_t grid;      // grid color
+    int grid_x;         // a grid column every grid_x samples (0: none)
+    int grid_y;         // a grid row every grid_y rows from the bottom (0: none)
+} CHART_T;
+
+void chart_free(CHART_T *c) {
+    map_surface_free(&c->ring);
+    free(c->samples);
+    memset(c, 0, sizeof(*c));
+}
+
+// clear the chart to bg and forget the samples (the ones to come are
+// still counted on for the grid)
+void chart_clear(CHART_T *c) {
+    int i;
+    surface_fill_rect(&c->ring, 0, 0, c->ring.width, c->ring.height, c->bg);
+    for (i = 0; i < c->ring.width; i++)
+        c->samples[i] = NAN;
+    c->last_y = -1;
+}
+
+// set up a w x h chart for values min .. max in pixel format fmt -
+// colors are 0 and there is no grid (set c->fg etc. and chart_clear
+// before adding samples); returns 0, EINVAL or ENOMEM
+int chart_init(CHART_T *c, int w, int h, PIX_FMT_T fmt, float min, float max) {
+    int ret;
+    memset(c, 0, sizeof(*c));
+    if (!(max > min))
+        return EINVAL;
+    if ((ret = map_surface(&c->ring, w, h, fmt)) != 0)
+        return ret;
+    c->samples = malloc((size_t)w * sizeof(float));
+    if (c->samples == 0) {
+        chart_free(c);
+        return ENOMEM;
+    }
+    c->min = min;
+    c->max = max;
+    chart_clear(c);
+    return 0;
+}
+
+// helper function for the row of value v (-1 for NaN)
+static inline int chart_row(const CHART_T *c, float v) {
+    int h = c->ring.height;
+    float y;
+    if (isnan(v))
+        return -1;
+    y = (h - 1) - (v - c->min) * (h - 1) / (c->max - c->min);
+    if (y < 0)
+        return 0;
+    if (y > h - 1)
+        return h - 1;
+    return (int)(y + 0.5f);
+}
+
+// helper function to fill rows y0 .. y1 of column x
+static void chart_vspan(SURFACE_T *s, int x, int y0, int y1, uint32_t col) {
+    char *p = surface_pixel(s, x, y0);
+    int y;
+    switch (s->fmt) {
+    case PIX_FMT_PAL8:
+        for (y = y0; y <= y1; y++, p += s->line_length)
+            *p = col;
+        break;
+    case PIX_FMT_RGB565:
+        for (y = y0; y <= y1; y++, p += s->line_length)
+            *((uint16_t *)p) = col;
+        break;
+    case PIX_FMT_XRGB8888:
+        for (y = y0; y <= y1; y++, p += s->line_length)
+            *((uint32_t *)p) = col;
+        break;
+    default:
+        for (y = y0; y <= y1; y++)
+            surface_put_pixel(s, x, y, col);
+        break;
+    }
+}
+
+// helper function to draw column x for sample number n with value v
+static void chart_column(CHART_T *c, int x, long n, float v) {
+    int h = c->ring.height;
+    int y = chart_row(c, v);
+    int r;
+    if ((c->grid_x > 0) && (n % c->grid_x == 0)) {
+        chart_vspan(&c->ring, x, 0, h - 1, c->grid);
+    }
+    else {
+        chart_vspan(&c->ring, x, 0, h - 1, c->bg);
+        if (c->grid_y > 0) {
+            for (r = h - 1; r >= 0; r -= c->grid_y)
+                surface_put_pixel(&c->ring, x, r, c->grid);
+        }
+    }
+    // joined to the previous value with a vertical run
+    if (y >= 0) {
+        if (c->last_y < 0)
+            chart_vspan(&c->ring, x, y, y, c->fg);
+        else if (c->last_y < y)
+            chart_vspan(&c->ring, x, c->last_y, y, c->fg);
+        else
+            chart_vspan(&c->ring, x, y, c->last_y, c->fg);
+    }
+    c->last_y = y;
+}
+
+// add n samples - only the last chart width of them can be seen, the
+// ones before are only counted
+void chart_add(CHART_T *c, const float *v, int n) {
+    int w = c->ring.width;
+    int i;
+    if (n > w) {
+        c->count += n - w;
+        c->last_y = -1;
+        v += n - w;
+        n = w;
+    }
+    for (i = 0; i < n; i++) {
+        chart_column(c, c->head, c->count, v[i]);
+        c->samples[c->head] = v[i];
+        c->count++;
+        if (++c->head == w)
+            c->head = 0;
+    }
+}
+
+// change the value range - the kept samples are drawn again
+void chart_range(CHART_T *c, float min, float max) {
+    int w = c->ring.width;
+    int i, x;
+    if (!(max > min))
+        return;
+    c->min = min;
+    c->max = max;
+    c->last_y = -1;
+    // from the oldest column (sample count - w) to the newest
+    for (i = 0, x = c->head; i < w; i++) {
+        chart_column(c, x, c->count - w + i, c->samples[x]);
+        if (++x == w)
+            x = 0;
+    }
+}
+
+// copy the chart to x, y of surface dst, oldest sample at the left (it
+// has to fit) - returns 0 or EINVAL
+int chart_present(const CHART_T *c, SURFACE_T *dst, int x, int y) {
+    int w = c->ring.width;
+    int h = c->ring.height;
+    RECT_T old = { c->head, 0, w - c->head, h };
+    RECT_T recent = { 0, 0, c->head, h };
+    RECT_T to;
+    SURFACE_T s;
+    SURFACE_T d;
+    if ((x < 0) || (y < 0) || (x + w > dst->width) || (y + h > dst->height))
+        return EINVAL;
+    // head .. w - 1 to the left
+    to.x = x;
+    to.y = y;
+    to.w = old.w;
+    to.h = h;
+    surface_sub(&s, &c->ring, &old);
+    surface_sub(&d, dst, &to);
+    wc_present(&d, &s, 0);
+    // 0 .. head - 1 after it
+    if (c->head > 0) {
+        to.x = x + old.w;
+        to.w = recent.w;
+        surface_sub(&s, &c->ring, &recent);
+        surface_sub(&d, dst, &to);
+        wc_present(&d, &s, 0);
+    }
+    return 0;
+}
+
+#endif // FBCHART_H
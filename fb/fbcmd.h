@@ -0,0 +1,476 @@
+/*
+ * fbcmd.h
+ *
+ * Recorded draw commands - instead of writing pixels immediately the
+ * drawing functions append commands to a buffer, and the whole frame
+ * is then executed in one pass:
+ *   - commands outside the clip rectangle are rejected
+ *   - everything under a later full-clip fill (== clear screen) is dropped
+ *   - commands are moved into top-to-bottom order as long as they do not
+ *     overlap the commands they pass (so the result stays the same)
+ *   - adjacent fills of the same color are merged into one
+ * The recorded commands are not changed by the execution, so the same
+ * frame can be replayed (for example for benchmarking).
+ *
+ * Usage:
+ *   CMDBUF_T cb;
+ *   cmdbuf_init(&cb);
+ *   cmd_fill_rect(&cb, 0, 0, 640, 480, 0); ...
+ *   cmdbuf_execute(&cb, &surface, 0, &stats);
+ *   cmdbuf_reset(&cb); // start recording the next frame
+ *
+ * Note: a blit source must not be the destination surface itself.
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBCMD_H
+#define FBCMD_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fbsurf.h"
+#include "fbblit.h"
+#include "font/fbtestfnt.h"
+
+// how many places a command may move up when sorting into
+// top-to-bottom order (bounds the cost for big frames)
+#define CMD_SORT_WINDOW 32
+
+typedef enum {
+    CMD_FILL_RECT,
+    CMD_LINE,
+    CMD_CIRCLE,
+    CMD_FILL_CIRCLE,
+    CMD_TEXT,
+    CMD_BLIT
+} CMD_TYPE_T;
+
+typedef struct {
+    CMD_TYPE_T type;
+    uint32_t c;       // color (value as stored in the surface)
+    RECT_T bbox;      // all pixels the command may touch
+    union {
+        struct { int x0, y0, x1, y1; } line;
+        struct { int x, y, r; } circle;
+        struct { int x, y, ofs, len; } text; // ofs into the text pool
+        struct { const SURFACE_T *src; int sx, sy; } blit; // dest == bbox
+    } u;
+} CMD_T;
+
+typedef struct {
+    CMD_T *cmds;      // recorded commands
+    int num_cmds;
+    int max_cmds;
+    char *text;       // text pool for the CMD_TEXT strings
+    int text_len;
+    int text_max;
+    CMD_T *exec;      // scratch: the commands in execution order
+    int max_exec;
+} CMDBUF_T;
+
+typedef struct {
+    int recorded;
+    int culled;       // outside the clip or covered by a later clear
+    int merged;       // fills merged into a neighbour
+    int executed;
+} CMD_STATS_T;
+
+void cmdbuf_init(CMDBUF_T *cb) {
+    memset(cb, 0, sizeof(*cb));
+}
+
+void cmdbuf_free(CMDBUF_T *cb) {
+    free(cb->cmds);
+    free(cb->text);
+    free(cb->exec);
+    memset(cb, 0, sizeof(*cb));
+}
+
+// forget the recorded commands (keeps the memory for the next frame)
+void cmdbuf_reset(CMDBUF_T *cb) {
+    cb->num_cmds = 0;
+    cb->text_len = 0;
+}
+
+// helper function to append a command - returns 0 if out of memory
+static CMD_T *cmdbuf_add(CMDBUF_T *cb, CMD_TYPE_T type, uint32_t c,
+                         int x, int y, int w, int h) {
+    if (cb->num_cmds == cb->max_cmds) {
+        int max = (cb->max_cmds > 0) ? cb->max_cmds * 2 : 256;
+        CMD_T *cmds = realloc(cb->cmds, max * sizeof(CMD_T));
+        if (cmds == 0)
+            return 0;
+        cb->cmds = cmds;
+        cb->max_cmds = max;
+    }
+    CMD_T *cmd = &cb->cmds[cb->num_cmds++];
+    cmd->type = type;
+    cmd->c = c;
+    cmd->bbox.x = x;
+    cmd->bbox.y = y;
+    cmd->bbox.w = w;
+    cmd->bbox.h = h;
+    return cmd;
+}
+
+int cmd_fill_rect(CMDBUF_T *cb, int x, int y, int w, int h, uint32_t c) {
+    if ((w <= 0) || (h <= 0))
+        return 0;
+    return cmdbuf_add(cb, CMD_FILL_RECT, c, x, y, w, h) ? 0 : ENOMEM;
+}
+
+int cmd_line(CMDBUF_T *cb, int x0, int y0, int x1, int y1, uint32_t c) {
+    int x = (x0 < x1) ? x0 : x1;
+    int y = (y0 < y1) ? y0 : y1;
+    int w = ((x0 < x1) ? x1 - x0 : x0 - x1) + 1;
+    int h = ((y0 < y1) ? y1 - y0 : y0 - y1) + 1;
+    CMD_T *cmd = cmdbuf_add(cb, CMD_LINE, c, x, y, w, h);
+    if (cmd == 0)
+        return ENOMEM;
+    cmd->u.line.x0 = x0;
+    cmd->u.line.y0 = y0;
+    cmd->u.line.x1 = x1;
+    cmd->u.line.y1 = y1;
+    return 0;
+}
+
+static int cmd_add_circle(CMDBUF_T *cb, CMD_TYPE_T type, int x, int y, int r, uint32_t c) {
+    if (r < 0)
+        return 0;
+    CMD_T *cmd = cmdbuf_add(cb, type, c, x - r, y - r, 2 * r + 1, 2 * r + 1);
+    if (cmd == 0)
+        return ENOMEM;
+    cmd->u.circle.x = x;
+    cmd->u.circle.y = y;
+    cmd->u.circle.r = r;
+    return 0;
+}
+
+int cmd_circle(CMDBUF_T *cb, int x, int y, int r, uint32_t c) {
+    return cmd_add_circle(cb, CMD_CIRCLE, x, y, r, c);
+}
+
+int cmd_fill_circle(CMDBUF_T *cb, int x, int y, int r, uint32_t c) {
+    return cmd_add_circle(cb, CMD_FILL_CIRCLE, x, y, r, c);
+}
+
+// text using the 8x8 font in fbtestfnt.h (only the set pixels are drawn)
+int cmd_text(CMDBUF_T *cb, int x, int y, const char *text, uint32_t c) {
+    int len = strlen(text);
+    if (len == 0)
+        return 0;
+    if (cb->text_len + len > cb->text_max) {
+        int max = (cb->text_max > 0) ? cb->text_max : 1024;
+        while (max < cb->text_len + len)
+            max *= 2;
+        char *pool = realloc(cb->text, max);
+        if (pool == 0)
+            return ENOMEM;
+        cb->text = pool;
+        cb->text_max = max;
+    }
+    CMD_T *cmd = cmdbuf_add(cb, CMD_TEXT, c, x, y, len * FONTW, FONTH);
+    if (cmd == 0)
+        return ENOMEM;
+    cmd->u.text.x = x;
+    cmd->u.text.y = y;
+    cmd->u.text.ofs = cb->text_len;
+    cmd->u.text.len = len;
+    memcpy(cb->text + cb->text_len, text, len);
+    cb->text_len += len;
+    return 0;
+}
+
+// copy the w x h pixels at sx,sy in 'src' to x,y (converting the format
+// if needed, see fbblit.h) - the source has to stay valid until the
+// buffer has been executed for the last time
+int cmd_blit(CMDBUF_T *cb, const SURFACE_T *src, int sx, int sy, int w, int h,
+             int x, int y) {
+    if ((w <= 0) || (h <= 0))
+        return 0;
+    CMD_T *cmd = cmdbuf_add(cb, CMD_BLIT, 0, x, y, w, h);
+    if (cmd == 0)
+        return ENOMEM;
+    cmd->u.blit.src = src;
+    cmd->u.blit.sx = sx;
+    cmd->u.blit.sy = sy;
+    return 0;
+}
+
+// helper function to test if rectangle 'in' is completely inside 'out'
+static int cmd_rect_contains(const RECT_T *out, const RECT_T *in) {
+    return (in->x >= out->x) && (in->y >= out->y)
+        && (in->x + in->w <= out->x + out->w)
+        && (in->y + in->h <= out->y + out->h);
+}
+
+// helper function to plot a pixel only if it is inside the clip
+static void cmd_plot(SURFACE_T *s, const RECT_T *clip, int x, int y, uint32_t c) {
+    if ((x >= clip->x) && (x < clip->x + clip->w)
+        && (y >= clip->y) && (y < clip->y + clip->h)) {
+        surface_put_pixel(s, x, y, c);
+    }
+}
+
+// helper function to fill a horizontal run clipped to the clip
+static void cmd_span(SURFACE_T *s, const RECT_T *clip, int x0, int x1, int y, uint32_t c) {
+    if ((y < clip->y) || (y >= clip->y + clip->h))
+        return;
+    if (x0 < clip->x)
+        x0 = clip->x;
+    if (x1 > clip->x + clip->w - 1)
+        x1 = clip->x + clip->w - 1;
+    if (x1 >= x0)
+        surface_fill_span(s, x0, y, x1 - x0 + 1, c);
+}
+
+// Bresenham's line algorithm as in fbtestXX.c
+static void cmd_exec_line(SURFACE_T *s, const RECT_T *clip, const CMD_T *cmd) {
+    int x0 = cmd->u.line.x0;
+    int y0 = cmd->u.line.y0;
+    int x1 = cmd->u.line.x1;
+    int y1 = cmd->u.line.y1;
+    int dx = (x1 >= x0) ? x1 - x0 : x0 - x1;
+    int dy = (y1 >= y0) ? y1 - y0 : y0 - y1;
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+    int err = dx - dy;
+    int e2;
+    // no need to test every pixel if the whole line is visible
+    int inside = cmd_rect_contains(clip, &cmd->bbox);
+    while (1) {
+        if (inside)
+            surface_put_pixel(s, x0, y0, cmd->c);
+        else
+            cmd_plot(s, clip, x0, y0, cmd->c);
+        if ((x0 == x1) && (y0 == y1))
+            break;
+        e2 = 2 * err;
+        if (e2 > -dy) {
+            err -= dy;
+            x0 += sx;
+        }
+        if (e2 < dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+// Bresenham's circle algorithm as in fbtestXX.c
+static void cmd_exec_circle(SURFACE_T *s, const RECT_T *clip, const CMD_T *cmd) {
+    int x0 = cmd->u.circle.x;
+    int y0 = cmd->u.circle.y;
+    int x = cmd->u.circle.r;
+    int y = 0;
+    int radiusError = 1 - x;
+    uint32_t c = cmd->c;
+    while (x >= y) {
+        if (cmd->type == CMD_FILL_CIRCLE) {
+            cmd_span(s, clip, x0 - y, x0 + y, y0 - x, c);
+            cmd_span(s, clip, x0 - x, x0 + x, y0 - y, c);
+            cmd_span(s, clip, x0 - x, x0 + x, y0 + y, c);
+            cmd_span(s, clip, x0 - y, x0 + y, y0 + x, c);
+        }
+        else {
+            cmd_plot(s, clip, x0 - y, y0 - x, c);
+            cmd_plot(s, clip, x0 + y, y0 - x, c);
+            cmd_plot(s, clip, x0 - x, y0 - y, c);
+            cmd_plot(s, clip, x0 + x, y0 - y, c);
+            cmd_plot(s, clip, x0 - x, y0 + y, c);
+            cmd_plot(s, clip, x0 + x, y0 + y, c);
+            cmd_plot(s, clip, x0 - y, y0 + x, c);
+            cmd_plot(s, clip, x0 + y, y0 + x, c);
+        }
+        y++;
+        if (radiusError < 0) {
+            radiusError += 2 * y + 1;
+        }
+        else {
+            x--;
+            radiusError += 2 * (y - x + 1);
+        }
+    }
+}
+
+static void cmd_exec_text(SURFACE_T *s, const RECT_T *clip, const CMDBUF_T *cb,
+                          const CMD_T *cmd) {
+    RECT_T r;
+    int x, y, i;
+    if (!rect_intersect(&r, &cmd->bbox, clip))
+        return;
+    // only the glyphs and glyph rows that are inside the clip
+    int i0 = (r.x - cmd->bbox.x) / FONTW;
+    int i1 = (r.x + r.w - 1 - cmd->bbox.x) / FONTW;
+    for (y = r.y; y < r.y + r.h; y++) {
+        int gy = y - cmd->u.text.y;
+        for (i = i0; i <= i1; i++) {
+            char *img = fontImg[font_index(cb->text[cmd->u.text.ofs + i])];
+            int gx = cmd->u.text.x + i * FONTW;
+            for (x = 0; x < FONTW; x++) {
+                if ((img[gy * FONTW + x] > 0)
+                    && (gx + x >= r.x) && (gx + x < r.x + r.w)) {
+                    surface_put_pixel(s, gx + x, y, cmd->c);
+                }
+            }
+        }
+    }
+}
+
+static void cmd_exec_blit(SURFACE_T *s, const RECT_T *clip, const CMD_T *cmd) {
+    RECT_T sr = { cmd->u.blit.sx, cmd->u.blit.sy, cmd->bbox.w, cmd->bbox.h };
+    SURFACE_T cs;
+    // blit into the clip area as a surface of its own (== clipped)
+    surface_sub(&cs, s, clip);
+    blit(&cs, cmd->bbox.x - clip->x, cmd->bbox.y - clip->y, cmd->u.blit.src, &sr, 0, 0);
+}
+
+// helper function to build the execution order - culls, sorts and
+// merges the recorded commands into cb->exec, returns the count
+static int cmdbuf_compile(CMDBUF_T *cb, const RECT_T *clip, CMD_STATS_T *stats) {
+    int i, j, n = 0;
+    int first = 0;
+
+    if (cb->max_exec < cb->num_cmds) {
+        CMD_T *exec = realloc(cb->exec, cb->num_cmds * sizeof(CMD_T));
+        if (exec == 0)
+            return -1;
+        cb->exec = exec;
+        cb->max_exec = cb->num_cmds;
+    }
+
+    // nothing before the last fill covering the whole clip is visible
+    for (i = cb->num_cmds - 1; i >= 0; i--) {
+        if ((cb->cmds[i].type == CMD_FILL_RECT)
+            && cmd_rect_contains(&cb->cmds[i].bbox, clip)) {
+            first = i;
+            break;
+        }
+    }
+    stats->culled += first;
+
+    for (i = first; i < cb->num_cmds; i++) {
+        CMD_T cmd = cb->cmds[i];
+        RECT_T vis;
+        // reject commands outside the clip
+        if (!rect_intersect(&vis, &cmd.bbox, clip)) {
+            stats->culled++;
+            continue;
+        }
+        // a fill is exactly its bounding box - keep only the visible part
+        if (cmd.type == CMD_FILL_RECT)
+            cmd.bbox = vis;
+        // move up towards top-to-bottom order past non-overlapping commands
+        j = n;
+        while ((j > 0) && (n - j < CMD_SORT_WINDOW)
+               && ((cb->exec[j - 1].bbox.y > cmd.bbox.y)
+                   || ((cb->exec[j - 1].bbox.y == cmd.bbox.y)
+                       && (cb->exec[j - 1].bbox.x > cmd.bbox.x)))
+               && !rect_overlaps(&cb->exec[j - 1].bbox, &cmd.bbox)) {
+            j--;
+        }
+        memmove(&cb->exec[j + 1], &cb->exec[j], (n - j) * sizeof(CMD_T));
+        cb->exec[j] = cmd;
+        n++;
+    }
+
+    // merge neighbouring fills
+    j = 0;
+    for (i = 0; i < n; i++) {
+        CMD_T *b = &cb->exec[i];
+        CMD_T *a = (j > 0) ? &cb->exec[j - 1] : 0;
+        if ((a != 0) && (a->type == CMD_FILL_RECT) && (b->type == CMD_FILL_RECT)) {
+            RECT_T *ra = &a->bbox;
+            RECT_T *rb = &b->bbox;
+            // a later fill hides an earlier one completely
+            if (cmd_rect_contains(rb, ra)) {
+                *a = *b;
+                stats->merged++;
+                continue;
+            }
+            if (a->c == b->c) {
+                if (cmd_rect_contains(ra, rb)) {
+                    stats->merged++;
+                    continue;
+                }
+                // stacked on top of each other
+                if ((ra->x == rb->x) && (ra->w == rb->w) && (rb->y == ra->y + ra->h)) {
+                    ra->h += rb->h;
+                    stats->merged++;
+                    continue;
+                }
+                // next to each other
+                if ((ra->y == rb->y) && (ra->h == rb->h) && (rb->x == ra->x + ra->w)) {
+                    ra->w += rb->w;
+                    stats->merged++;
+                    continue;
+                }
+            }
+        }
+        if (j != i)
+            cb->exec[j] = *b;
+        j++;
+    }
+    return j;
+}
+
+// execute the recorded commands into 's' - 'clip' may be 0 for the
+// whole surface; 'stats' may be 0 - returns 0 or ENOMEM
+int cmdbuf_execute(CMDBUF_T *cb, SURFACE_T *s, const RECT_T *clip, CMD_STATS_T *stats) {
+    CMD_STATS_T st = { 0, 0, 0, 0 };
+    RECT_T all = { 0, 0, s->width, s->height };
+    RECT_T cr;
+    int i, y, n;
+
+    // never draw outside the surface
+    if (clip == 0)
+        cr = all;
+    else
+        rect_intersect(&cr, clip, &all);
+
+    st.recorded = cb->num_cmds;
+    n = (cr.w > 0) ? cmdbuf_compile(cb, &cr, &st) : 0;
+    if (n < 0)
+        return ENOMEM;
+
+    for (i = 0; i < n; i++) {
+        const CMD_T *cmd = &cb->exec[i];
+        switch (cmd->type) {
+        case CMD_FILL_RECT:
+            for (y = cmd->bbox.y; y < cmd->bbox.y + cmd->bbox.h; y++)
+                surface_fill_span(s, cmd->bbox.x, y, cmd->bbox.w, cmd->c);
+            break;
+        case CMD_LINE:
+            cmd_exec_line(s, &cr, cmd);
+            break;
+        case CMD_CIRCLE:
+        case CMD_FILL_CIRCLE:
+            cmd_exec_circle(s, &cr, cmd);
+            break;
+        case CMD_TEXT:
+            cmd_exec_text(s, &cr, cb, cmd);
+            break;
+        case CMD_BLIT:
+            cmd_exec_blit(s, &cr, cmd);
+            break;
+        }
+    }
+    st.executed = n;
+
+    if (stats != 0)
+        *stats = st;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,427 @@
+/*
+ * fbcomp.h
+ *
+ * Layered software compositor - instead of redrawing everything every
+ * frame, the screen is built from z-ordered layers (off-screen surfaces
+ * with a position, an opacity, an optional color key and an 'opaque
+ * region' hint) and only the damaged areas are composited into the back
+ * page.
+ *
+ * The damaged areas are split into COMP_TILE x COMP_TILE cells. For each
+ * cell the layers are searched from the top down for one whose opaque
+ * region covers the whole cell - compositing starts from that layer and
+ * the layers below it are never read. A static full-screen background
+ * under a moving sprite is therefore only read where the sprite was or
+ * is, and not at all under an opaque panel.
+ *
+ * A cell with a translucent layer in it is composited into a tile in
+ * ordinary memory and written to the page once (fbwc.h) - blending
+ * reads what is under it, and reading the page back is slow.
+ *
+ * With page flipping every page lags behind by its own amount, so the
+ * damage is kept per page (added to all of them, cleared for the page
+ * composited) - the same scheme as dmx/dmxdamage.h.
+ *
+ * Usage:
+ *   COMP_T comp;
+ *   comp_init(&comp, xres, yres, 2, 0);
+ *   bg = comp_layer_add(&comp, &background, 0, 0, 0);
+ *   comp_layer_set_opaque(&comp, bg, 0);
+ *   each frame: comp_layer_move(&comp, spr, x, y); comp_layer_damage(...);
+ *               comp_compose(&comp, &page, cur_page, &stats);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBCOMP_H
+#define FBCOMP_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "fbsurf.h"
+#include "fbblit.h"
+#include "fbblend.h"
+#include "fbwc.h"
+
+#define COMP_MAX_LAYERS 16
+#define COMP_MAX_PAGES 3
+// separate damaged rectangles per page (more are merged)
+#define COMP_MAX_DAMAGE 32
+// occlusion is decided per cell of this size
+#define COMP_TILE 64
+
+typedef struct {
+    const SURFACE_T *surf;
+    int x;                  // position on screen
+    int y;
+    int z;                  // bigger is on top
+    int opacity;            // 0 (invisible) .. 255 (as is)
+    int visible;
+    int flags;              // BLIT_COLORKEY for a transparent color...
+    uint32_t key;           // ... this one (raw source value)
+    RECT_T opaque;          // hint: fully opaque part, layer coordinates
+} LAYER_T;
+
+typedef struct {
+    RECT_T r[COMP_MAX_DAMAGE];
+    int num;
+} COMP_DAMAGE_T;
+
+typedef struct {
+    int cells;              // cells composited
+    long pixels_written;    // to the page
+    long pixels_read;       // from the layers
+    int layers_occluded;    // layer/cell pairs skipped as hidden
+} COMP_STATS_T;
+
+typedef struct {
+    int width;              // screen size
+    int height;
+    uint32_t bg;            // raw color where there are no layers
+    LAYER_T layers[COMP_MAX_LAYERS];
+    int used[COMP_MAX_LAYERS];
+    int order[COMP_MAX_LAYERS]; // layer handles bottom to top
+    int num;
+    COMP_DAMAGE_T damage[COMP_MAX_PAGES];
+    int pages;
+} COMP_T;
+
+// helper function for the area of the union of two rectangles
+static int comp_union(RECT_T *out, const RECT_T *a, const RECT_T *b) {
+    int x0 = (a->x < b->x) ? a->x : b->x;
+    int y0 = (a->y < b->y) ? a->y : b->y;
+    int x1 = (a->x + a->w > b->x + b->w) ? a->x + a->w : b->x + b->w;
+    int y1 = (a->y + a->h > b->y + b->h) ? a->y + a->h : b->y + b->h;
+    out->x = x0;
+    out->y = y0;
+    out->w = x1 - x0;
+    out->h = y1 - y0;
+    return out->w * out->h;
+}
+
+// helper function to add a screen rectangle to one page's damage -
+// overlapping rectangles are merged, when full the cheapest pair is
+static void comp_damage_add(COMP_DAMAGE_T *d, const RECT_T *r) {
+    RECT_T m = *r;
+    int i;
+    // swallow everything the new rectangle overlaps (repeat, it grows)
+    i = 0;
+    while (i < d->num) {
+        if (rect_overlaps(&d->r[i], &m)) {
+            comp_union(&m, &m, &d->r[i]);
+            d->r[i] = d->r[--d->num];
+            i = 0;
+        }
+        else {
+            i++;
+        }
+    }
+    if (d->num == COMP_MAX_DAMAGE) {
+        // full - merge into the one that grows the least
+        int best = 0, bestg = 0x7FFFFFFF;
+        RECT_T u;
+        for (i = 0; i < d->num; i++) {
+            int g = comp_union(&u, &m, &d->r[i]) - d->r[i].w * d->r[i].h;
+            if (g < bestg) {
+                bestg = g;
+                best = i;
+            }
+        }
+        comp_union(&m, &m, &d->r[best]);
+        d->r[best] = d->r[--d->num];
+        // the bigger rectangle may overlap others now
+        comp_damage_add(d, &m);
+        return;
+    }
+    d->r[d->num++] = m;
+}
+
+// mark a screen rectangle changed (on every page)
+void comp_damage(COMP_T *c, const RECT_T *r) {
+    RECT_T all = { 0, 0, c->width, c->height };
+    RECT_T cr;
+    int p;
+    if (!rect_intersect(&cr, r, &all))
+        return;
+    for (p = 0; p < c->pages; p++)
+        comp_damage_add(&c->damage[p], &cr);
+}
+
+// helper function to get the screen rectangle of a layer
+static void comp_layer_rect(const LAYER_T *l, RECT_T *r) {
+    r->x = l->x;
+    r->y = l->y;
+    r->w = l->surf->width;
+    r->h = l->surf->height;
+}
+
+// set up an empty screen of w x h pixels composited to 'pages' pages
+// (1 .. COMP_MAX_PAGES) - 'bg' shows where there is no layer
+void comp_init(COMP_T *c, int w, int h, int pages, uint32_t bg) {
+    RECT_T all = { 0, 0, w, h };
+    memset(c, 0, sizeof(*c));
+    c->width = w;
+    c->height = h;
+    c->bg = bg;
+    c->pages = (pages < 1) ? 1 : (pages > COMP_MAX_PAGES) ? COMP_MAX_PAGES : pages;
+    // nothing has been composited yet
+    comp_damage(c, &all);
+}
+
+// add a layer (visible, opaque hint none) - returns its handle or -1
+int comp_layer_add(COMP_T *c, const SURFACE_T *surf, int x, int y, int z) {
+    int h, i;
+    RECT_T r;
+    for (h = 0; h < COMP_MAX_LAYERS; h++) {
+        if (!c->used[h])
+            break;
+    }
+    if (h == COMP_MAX_LAYERS)
+        return -1;
+    memset(&c->layers[h], 0, sizeof(LAYER_T));
+    c->layers[h].surf = surf;
+    c->layers[h].x = x;
+    c->layers[h].y = y;
+    c->layers[h].z = z;
+    c->layers[h].opacity = 255;
+    c->layers[h].visible = 1;
+    c->used[h] = 1;
+    // keep 'order' sorted by z (a new layer goes on top of equal z)
+    for (i = c->num; (i > 0) && (c->layers[c->order[i - 1]].z > z); i--)
+        c->order[i] = c->order[i - 1];
+    c->order[i] = h;
+    c->num++;
+    comp_layer_rect(&c->layers[h], &r);
+    comp_damage(c, &r);
+    return h;
+}
+
+void comp_layer_remove(COMP_T *c, int l) {
+    int i, j;
+    RECT_T r;
+    comp_layer_rect(&c->layers[l], &r);
+    comp_damage(c, &r);
+    for (i = 0, j = 0; i < c->num; i++) {
+        if (c->order[i] != l)
+            c->order[j++] = c->order[i];
+    }
+    c->num = j;
+    c->used[l] = 0;
+}
+
+// mark part of a layer changed - 'r' in layer coordinates, 0 for all
+void comp_layer_damage(COMP_T *c, int l, const RECT_T *r) {
+    LAYER_T *layer = &c->layers[l];
+    RECT_T sr;
+    if (r != 0) {
+        sr.x = layer->x + r->x;
+        sr.y = layer->y + r->y;
+        sr.w = r->w;
+        sr.h = r->h;
+    }
+    else {
+        comp_layer_rect(layer, &sr);
+    }
+    if (layer->visible)
+        comp_damage(c, &sr);
+}
+
+void comp_layer_move(COMP_T *c, int l, int x, int y) {
+    LAYER_T *layer = &c->layers[l];
+    if ((layer->x == x) && (layer->y == y))
+        return;
+    comp_layer_damage(c, l, 0);
+    layer->x = x;
+    layer->y = y;
+    comp_layer_damage(c, l, 0);
+}
+
+void comp_layer_set_opacity(COMP_T *c, int l, int opacity) {
+    if (c->layers[l].opacity != opacity) {
+        c->layers[l].opacity = opacity;
+        comp_layer_damage(c, l, 0);
+    }
+}
+
+void comp_layer_set_key(COMP_T *c, int l, int flags, uint32_t key) {
+    c->layers[l].flags = flags;
+    c->layers[l].key = key;
+    comp_layer_damage(c, l, 0);
+}
+
+// the part of the layer known to be opaque (no color key pixels) - 0 for
+// all of it; an empty rectangle (w or h 0) for none
+void comp_layer_set_opaque(COMP_T *c, int l, const RECT_T *r) {
+    LAYER_T *layer = &c->layers[l];
+    RECT_T all = { 0, 0, layer->surf->width, layer->surf->height };
+    if (r == 0)
+        layer->opaque = all;
+    else if (!rect_intersect(&layer->opaque, r, &all))
+        memset(&layer->opaque, 0, sizeof(RECT_T));
+}
+
+void comp_layer_show(COMP_T *c, int l, int visible) {
+    RECT_T r;
+    if (c->layers[l].visible != visible) {
+        c->layers[l].visible = visible;
+        comp_layer_rect(&c->layers[l], &r);
+        comp_damage(c, &r);
+    }
+}
+
+// helper function to test if a layer hides 'cell' completely
+static int comp_layer_occludes(const LAYER_T *l, const RECT_T *cell) {
+    if ((l->opacity < 255) || (l->opaque.w <= 0) || (l->opaque.h <= 0))
+        return 0;
+    int x0 = l->x + l->opaque.x;
+    int y0 = l->y + l->opaque.y;
+    return (cell->x >= x0) && (cell->y >= y0)
+        && (cell->x + cell->w <= x0 + l->opaque.w)
+        && (cell->y + cell->h <= y0 + l->opaque.h);
+}
+
+// helper function to mix one 8 bit channel: (s * a + d * (255 - a)) / 255
+static inline uint32_t comp_mix(uint32_t s, uint32_t d, uint32_t a) {
+    return ((s & 0xFF) * a + (d & 0xFF) * (255 - a) + 127) / 255;
+}
+
+// helper function to draw the 'cell' part of a layer with its opacity -
+// screen x, y is at ox, oy of dst (dst is only read for opacity < 255)
+static void comp_draw_layer(SURFACE_T *dst, int ox, int oy, const LAYER_T *l,
+                            const RECT_T *cell) {
+    RECT_T sr = { cell->x - l->x, cell->y - l->y, cell->w, cell->h };
+    int dx = cell->x - ox;
+    int dy = cell->y - oy;
+    uint32_t sbuf[CONV_CHUNK];
+    uint32_t dbuf[CONV_CHUNK];
+    int sb, db, y, x, i, k;
+
+    if (l->opacity >= 255) {
+        blit(dst, dx, dy, l->surf, &sr, l->flags, l->key);
+        return;
+    }
+    if (!(l->flags & BLIT_COLORKEY)) {
+        blend(dst, dx, dy, l->surf, &sr, 0, BLEND_OVER, l->opacity);
+        return;
+    }
+    // translucent and color keyed: blend through XRGB8888 rows
+    sb = pix_fmt_bytes(l->surf->fmt);
+    db = pix_fmt_bytes(dst->fmt);
+    uint32_t a = l->opacity;
+    for (y = 0; y < cell->h; y++) {
+        const uint8_t *sp = (const uint8_t *)surface_pixel(l->surf, sr.x, sr.y + y);
+        uint8_t *dp = (uint8_t *)surface_pixel(dst, dx, dy + y);
+        for (x = 0; x < cell->w; x += k) {
+            k = (cell->w - x > CONV_CHUNK) ? CONV_CHUNK : cell->w - x;
+            conv_to_xrgb(sbuf, sp + x * sb, k, l->surf->fmt, l->surf->pal);
+            conv_to_xrgb(dbuf, dp + x * db, k, dst->fmt, dst->pal);
+            for (i = 0; i < k; i++) {
+                if (blit_raw_pixel(sp + (x + i) * sb, l->surf->fmt) == l->key)
+                    continue;
+                dbuf[i] = (comp_mix(sbuf[i] >> 16, dbuf[i] >> 16, a) << 16)
+                        | (comp_mix(sbuf[i] >> 8, dbuf[i] >> 8, a) << 8)
+                        | comp_mix(sbuf[i], dbuf[i], a);
+            }
+            conv_from_xrgb(dp + x * db, dbuf, k, dst->fmt, dst->pal);
+        }
+    }
+}
+
+// composite the damaged areas of 'page' into 'dst' (the page's surface,
+// at least the screen size) and clear the page's damage
+void comp_compose(COMP_T *c, SURFACE_T *dst, int page, COMP_STATS_T *stats) {
+    COMP_DAMAGE_T *d = &c->damage[page];
+    COMP_STATS_T st;
+    uint32_t mem[COMP_TILE * COMP_TILE]; // a cell of any format
+    SURFACE_T scratch;
+    int i, k, tx, ty;
+
+    memset(&st, 0, sizeof(st));
+    for (i = 0; i < d->num; i++) {
+        const RECT_T *r = &d->r[i];
+        // cells on the screen grid (so that they line up with layer edges
+        // at tile boundaries more often than arbitrary splits would)
+        for (ty = r->y - r->y % COMP_TILE; ty < r->y + r->h; ty += COMP_TILE) {
+            for (tx = r->x - r->x % COMP_TILE; tx < r->x + r->w; tx += COMP_TILE) {
+                RECT_T tile = { tx, ty, COMP_TILE, COMP_TILE };
+                RECT_T cell, lr, part;
+                SURFACE_T *out = dst;
+                int base = -1, ox = 0, oy = 0;
+                if (!rect_intersect(&cell, &tile, r))
+                    continue;
+                st.cells++;
+                st.pixels_written += cell.w * cell.h;
+                // topmost layer that hides everything below it
+                for (k = c->num - 1; k >= 0; k--) {
+                    const LAYER_T *l = &c->layers[c->order[k]];
+                    if (l->visible && (l->opacity > 0) && comp_layer_occludes(l, &cell)) {
+                        base = k;
+                        break;
+                    }
+                }
+                // translucent layers are blended in 'scratch' (as are the
+                // layers under them), the page only gets the result
+                for (k = (base < 0) ? 0 : base; k < c->num; k++) {
+                    const LAYER_T *l = &c->layers[c->order[k]];
+                    comp_layer_rect(l, &lr);
+                    if (l->visible && (l->opacity > 0) && (l->opacity < 255)
+                        && rect_overlaps(&lr, &cell))
+                        break;
+                }
+                if (k < c->num) {
+                    scratch.data = (char *)mem;
+                    scratch.width = cell.w;
+                    scratch.height = cell.h;
+                    scratch.line_length = cell.w * pix_fmt_bytes(dst->fmt);
+                    scratch.fmt = dst->fmt;
+                    scratch.pal = dst->pal;
+                    out = &scratch;
+                    ox = cell.x;
+                    oy = cell.y;
+                }
+                if (base < 0) {
+                    surface_fill_rect(out, cell.x - ox, cell.y - oy, cell.w, cell.h, c->bg);
+                    base = 0;
+                }
+                else {
+                    // count what the occlusion saved
+                    for (k = 0; k < base; k++) {
+                        const LAYER_T *l = &c->layers[c->order[k]];
+                        comp_layer_rect(l, &lr);
+                        if (l->visible && (l->opacity > 0) && rect_overlaps(&lr, &cell))
+                            st.layers_occluded++;
+                    }
+                }
+                for (k = base; k < c->num; k++) {
+                    const LAYER_T *l = &c->layers[c->order[k]];
+                    if (!l->visible || (l->opacity == 0))
+                        continue;
+                    comp_layer_rect(l, &lr);
+                    if (!rect_intersect(&part, &lr, &cell))
+                        continue;
+                    comp_draw_layer(out, ox, oy, l, &part);
+                    st.pixels_read += part.w * part.h;
+                }
+                if (out == &scratch) {
+                    SURFACE_T s;
+                    surface_sub(&s, dst, &cell);
+                    wc_present(&s, &scratch, 0);
+                }
+            }
+        }
+    }
+    d->num = 0;
+    if (stats != 0)
+        *stats = st;
+}
+
+#endif
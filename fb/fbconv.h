@@ -0,0 +1,605 @@
+/*
+ * fbconv.h
+ *
+ * Pixel format conversion - one place for converting rows of pixels
+ * between the 8 bit palette, RGB565, RGB888/BGR888 and XRGB8888 layouts
+ * (the PIX_FMT_T values in fbsurf.h).
+ *
+ * The same rules everywhere:
+ *   - to RGB565 the low bits are dropped (r >> 3, g >> 2, b >> 3 - as
+ *     fbtest6.c, ppmtorgb565.c etc. always did)
+ *   - from RGB565 the high bits are replicated into the low ones, so
+ *     that white stays white and 565 -> 888 -> 565 gives the same value
+ *   - to 8 bit palette the closest palette entry is used - looked up
+ *     from the palette's inverse table when it has one (fbquant.h)
+ *
+ * The kernels come in scalar, SSE2, AVX2 and NEON versions - the best
+ * one the CPU supports is picked at run time on the first use (AVX2 is
+ * compiled in with a target attribute, NEON is checked from the hwcaps
+ * on 32 bit ARM: a Pi 1/Zero has none, a Pi 2 and later have it).
+ * conv_selftest() checks the others against the scalar one.
+ *
+ * Usage:
+ *   conv_row(out, PIX_FMT_RGB565, 0, in, PIX_FMT_RGB888, 0, width);
+ *   printf("%s\n", conv_impl()->name);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBCONV_H
+#define FBCONV_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define CONV_HAVE_AVX2 1
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#include "fbsurf.h"
+
+// pixels converted at a time through the XRGB8888 row buffer
+#define CONV_CHUNK 256
+
+typedef enum {
+    CONV_SCALAR = 0,
+    CONV_SSE2,
+    CONV_AVX2,
+    CONV_NEON,
+    CONV_NUM_IMPL
+} CONV_IMPL_ID_T;
+
+// the kernels - 'bgr' is 1 for BGR888 (memory order b, g, r)
+typedef struct {
+    const char *name;
+    void (*rgb565_to_xrgb)(uint32_t *out, const uint16_t *in, int n);
+    void (*xrgb_to_rgb565)(uint16_t *out, const uint32_t *in, int n);
+    void (*rgb24_to_xrgb)(uint32_t *out, const uint8_t *in, int n, int bgr);
+    void (*xrgb_to_rgb24)(uint8_t *out, const uint32_t *in, int n, int bgr);
+    void (*pal8_to_xrgb)(uint32_t *out, const uint8_t *in, int n, const uint32_t *rgb);
+} CONV_IMPL_T;
+
+// one pixel to RGB565 (for the put_pixel style code)
+static inline uint16_t conv_rgb_to_565(int r, int g, int b) {
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+// --- scalar ---
+
+static void conv_rgb565_to_xrgb_c(uint32_t *out, const uint16_t *in, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        uint32_t c = in[i];
+        uint32_t r = (c >> 11) & 0x1F;
+        uint32_t g = (c >> 5) & 0x3F;
+        uint32_t b = c & 0x1F;
+        out[i] = (((r << 3) | (r >> 2)) << 16)
+               | (((g << 2) | (g >> 4)) << 8)
+               | ((b << 3) | (b >> 2));
+    }
+}
+
+static void conv_xrgb_to_rgb565_c(uint16_t *out, const uint32_t *in, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        uint32_t c = in[i];
+        out[i] = ((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0) | ((c >> 3) & 0x001F);
+    }
+}
+
+static void conv_rgb24_to_xrgb_c(uint32_t *out, const uint8_t *in, int n, int bgr) {
+    int i;
+    if (bgr) {
+        for (i = 0; i < n; i++)
+            out[i] = (in[3 * i + 2] << 16) | (in[3 * i + 1] << 8) | in[3 * i];
+    }
+    else {
+        for (i = 0; i < n; i++)
+            out[i] = (in[3 * i] << 16) | (in[3 * i + 1] << 8) | in[3 * i + 2];
+    }
+}
+
+static void conv_xrgb_to_rgb24_c(uint8_t *out, const uint32_t *in, int n, int bgr) {
+    int i;
+    int r = bgr ? 2 : 0;
+    for (i = 0; i < n; i++) {
+        out[3 * i + r] = in[i] >> 16;
+        out[3 * i + 1] = in[i] >> 8;
+        out[3 * i + 2 - r] = in[i];
+    }
+}
+
+static void conv_pal8_to_xrgb_c(uint32_t *out, const uint8_t *in, int n, const uint32_t *rgb) {
+    int i;
+    for (i = 0; i < n; i++)
+        out[i] = rgb[in[i]];
+}
+
+static const CONV_IMPL_T conv_scalar = {
+    "scalar",
+    conv_rgb565_to_xrgb_c,
+    conv_xrgb_to_rgb565_c,
+    conv_rgb24_to_xrgb_c,
+    conv_xrgb_to_rgb24_c,
+    conv_pal8_to_xrgb_c
+};
+
+// --- SSE2 (no byte shuffles - the 24 bit and palette ones are scalar) ---
+
+#if defined(__SSE2__)
+static void conv_rgb565_to_xrgb_sse2(uint32_t *out, const uint16_t *in, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i r = _mm_srli_epi16(d, 11);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(d, 5), _mm_set1_epi16(0x3F));
+        __m128i b = _mm_and_si128(d, _mm_set1_epi16(0x1F));
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+        __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(bg, r));
+        _mm_storeu_si128((__m128i *)(out + i + 4), _mm_unpackhi_epi16(bg, r));
+    }
+    conv_rgb565_to_xrgb_c(out + i, in + i, n - i);
+}
+
+// helper function for four XRGB8888 pixels as 5:6:5 in 32 bit lanes
+static inline __m128i conv_565_epi32(__m128i s) {
+    return _mm_or_si128(_mm_or_si128(
+               _mm_and_si128(_mm_srli_epi32(s, 8), _mm_set1_epi32(0xF800)),
+               _mm_and_si128(_mm_srli_epi32(s, 5), _mm_set1_epi32(0x07E0))),
+               _mm_and_si128(_mm_srli_epi32(s, 3), _mm_set1_epi32(0x001F)));
+}
+
+static void conv_xrgb_to_rgb565_sse2(uint16_t *out, const uint32_t *in, int n) {
+    int i = 0;
+    __m128i bias32 = _mm_set1_epi32(0x8000);
+    __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v0 = conv_565_epi32(_mm_loadu_si128((const __m128i *)(in + i)));
+        __m128i v1 = conv_565_epi32(_mm_loadu_si128((const __m128i *)(in + i + 4)));
+        // packs saturates signed - move the values to the signed range and back
+        __m128i p = _mm_packs_epi32(_mm_sub_epi32(v0, bias32), _mm_sub_epi32(v1, bias32));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi16(p, bias16));
+    }
+    conv_xrgb_to_rgb565_c(out + i, in + i, n - i);
+}
+
+static const CONV_IMPL_T conv_sse2 = {
+    "sse2",
+    conv_rgb565_to_xrgb_sse2,
+    conv_xrgb_to_rgb565_sse2,
+    conv_rgb24_to_xrgb_c,
+    conv_xrgb_to_rgb24_c,
+    conv_pal8_to_xrgb_c
+};
+#endif
+
+// --- AVX2 ---
+
+#if defined(CONV_HAVE_AVX2)
+#define CONV_AVX2_FN __attribute__((target("avx2")))
+
+CONV_AVX2_FN static void conv_rgb565_to_xrgb_avx2(uint32_t *out, const uint16_t *in, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i r = _mm256_srli_epi16(d, 11);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi16(d, 5), _mm256_set1_epi16(0x3F));
+        __m256i b = _mm256_and_si256(d, _mm256_set1_epi16(0x1F));
+        r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+        g = _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4));
+        b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+        __m256i bg = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+        // unpack works within the 128 bit halves: lo = 0-3, 8-11; hi = 4-7, 12-15
+        __m256i lo = _mm256_unpacklo_epi16(bg, r);
+        __m256i hi = _mm256_unpackhi_epi16(bg, r);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    conv_rgb565_to_xrgb_c(out + i, in + i, n - i);
+}
+
+CONV_AVX2_FN static inline __m256i conv_565_epi32_avx2(__m256i s) {
+    return _mm256_or_si256(_mm256_or_si256(
+               _mm256_and_si256(_mm256_srli_epi32(s, 8), _mm256_set1_epi32(0xF800)),
+               _mm256_and_si256(_mm256_srli_epi32(s, 5), _mm256_set1_epi32(0x07E0))),
+               _mm256_and_si256(_mm256_srli_epi32(s, 3), _mm256_set1_epi32(0x001F)));
+}
+
+CONV_AVX2_FN static void conv_xrgb_to_rgb565_avx2(uint16_t *out, const uint32_t *in, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v0 = conv_565_epi32_avx2(_mm256_loadu_si256((const __m256i *)(in + i)));
+        __m256i v1 = conv_565_epi32_avx2(_mm256_loadu_si256((const __m256i *)(in + i + 8)));
+        // values fit 16 bits unsigned - packus does not saturate them
+        __m256i p = _mm256_packus_epi32(v0, v1);
+        // packus works within the halves: 0-3, 8-11, 4-7, 12-15
+        p = _mm256_permute4x64_epi64(p, 0xD8);
+        _mm256_storeu_si256((__m256i *)(out + i), p);
+    }
+    conv_xrgb_to_rgb565_c(out + i, in + i, n - i);
+}
+
+CONV_AVX2_FN static void conv_rgb24_to_xrgb_avx2(uint32_t *out, const uint8_t *in, int n, int bgr) {
+    int i = 0;
+    // four pixels from the first 12 bytes of each half
+    __m256i m = bgr
+        ? _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                           0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1)
+        : _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                           2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    // 16 byte loads: 8 pixels read 28 bytes, keep 2 pixels to spare
+    for (; i + 10 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(in + 3 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(in + 3 * i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_shuffle_epi8(v, m));
+    }
+    conv_rgb24_to_xrgb_c(out + i, in + 3 * i, n - i, bgr);
+}
+
+CONV_AVX2_FN static void conv_xrgb_to_rgb24_avx2(uint8_t *out, const uint32_t *in, int n, int bgr) {
+    int i = 0;
+    __m256i m = bgr
+        ? _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1)
+        : _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                           2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    // the 16 byte stores overlap by 4 bytes and write 4 past the 24
+    for (; i + 10 <= n; i += 8) {
+        __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + i)), m);
+        _mm_storeu_si128((__m128i *)(out + 3 * i), _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i *)(out + 3 * i + 12), _mm256_extracti128_si256(v, 1));
+    }
+    conv_xrgb_to_rgb24_c(out + 3 * i, in + i, n - i, bgr);
+}
+
+CONV_AVX2_FN static void conv_pal8_to_xrgb_avx2(uint32_t *out, const uint8_t *in, int n,
+                                                const uint32_t *rgb) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i)));
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_i32gather_epi32((const int *)rgb, idx, 4));
+    }
+    conv_pal8_to_xrgb_c(out + i, in + i, n - i, rgb);
+}
+
+static const CONV_IMPL_T conv_avx2 = {
+    "avx2",
+    conv_rgb565_to_xrgb_avx2,
+    conv_xrgb_to_rgb565_avx2,
+    conv_rgb24_to_xrgb_avx2,
+    conv_xrgb_to_rgb24_avx2,
+    conv_pal8_to_xrgb_avx2
+};
+#endif
+
+// --- NEON ---
+
+#if defined(__ARM_NEON)
+static void conv_rgb565_to_xrgb_neon(uint32_t *out, const uint16_t *in, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t d = vld1q_u16(in + i);
+        uint16x8_t r = vshrq_n_u16(d, 11);
+        uint16x8_t g = vandq_u16(vshrq_n_u16(d, 5), vdupq_n_u16(0x3F));
+        uint16x8_t b = vandq_u16(d, vdupq_n_u16(0x1F));
+        uint8x8x4_t v;
+        v.val[0] = vmovn_u16(vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2)));
+        v.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4)));
+        v.val[2] = vmovn_u16(vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2)));
+        v.val[3] = vdup_n_u8(0);
+        vst4_u8((uint8_t *)(out + i), v);
+    }
+    conv_rgb565_to_xrgb_c(out + i, in + i, n - i);
+}
+
+static void conv_xrgb_to_rgb565_neon(uint16_t *out, const uint32_t *in, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t v = vld4_u8((const uint8_t *)(in + i));
+        uint16x8_t p = vandq_u16(vshll_n_u8(v.val[2], 8), vdupq_n_u16(0xF800));
+        p = vorrq_u16(p, vandq_u16(vshll_n_u8(v.val[1], 3), vdupq_n_u16(0x07E0)));
+        p = vorrq_u16(p, vmovl_u8(vshr_n_u8(v.val[0], 3)));
+        vst1q_u16(out + i, p);
+    }
+    conv_xrgb_to_rgb565_c(out + i, in + i, n - i);
+}
+
+static void conv_rgb24_to_xrgb_neon(uint32_t *out, const uint8_t *in, int n, int bgr) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x3_t s = vld3_u8(in + 3 * i);
+        uint8x8x4_t v;
+        v.val[0] = bgr ? s.val[0] : s.val[2];
+        v.val[1] = s.val[1];
+        v.val[2] = bgr ? s.val[2] : s.val[0];
+        v.val[3] = vdup_n_u8(0);
+        vst4_u8((uint8_t *)(out + i), v);
+    }
+    conv_rgb24_to_xrgb_c(out + i, in + 3 * i, n - i, bgr);
+}
+
+static void conv_xrgb_to_rgb24_neon(uint8_t *out, const uint32_t *in, int n, int bgr) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t v = vld4_u8((const uint8_t *)(in + i));
+        uint8x8x3_t s;
+        s.val[0] = bgr ? v.val[0] : v.val[2];
+        s.val[1] = v.val[1];
+        s.val[2] = bgr ? v.val[2] : v.val[0];
+        vst3_u8(out + 3 * i, s);
+    }
+    conv_xrgb_to_rgb24_c(out + 3 * i, in + i, n - i, bgr);
+}
+
+static const CONV_IMPL_T conv_neon = {
+    "neon",
+    conv_rgb565_to_xrgb_neon,
+    conv_xrgb_to_rgb565_neon,
+    conv_rgb24_to_xrgb_neon,
+    conv_xrgb_to_rgb24_neon,
+    conv_pal8_to_xrgb_c
+};
+#endif
+
+// --- dispatch ---
+
+// the implementation in use (0 until the first conversion)
+static const CONV_IMPL_T *conv_cur = 0;
+
+// helper function to get an implementation if this CPU can run it
+static const CONV_IMPL_T *conv_get(CONV_IMPL_ID_T id) {
+    switch (id) {
+    case CONV_SCALAR:
+        return &conv_scalar;
+#if defined(__SSE2__)
+    case CONV_SSE2:
+        return &conv_sse2;
+#endif
+#if defined(CONV_HAVE_AVX2)
+    case CONV_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &conv_avx2 : 0;
+#endif
+#if defined(__ARM_NEON)
+    case CONV_NEON:
+#if defined(__arm__)
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) ? &conv_neon : 0;
+#else
+        return &conv_neon;
+#endif
+#endif
+    default:
+        return 0;
+    }
+}
+
+// use a particular implementation - returns 0 or EINVAL if not available
+int conv_select(CONV_IMPL_ID_T id) {
+    const CONV_IMPL_T *impl = conv_get(id);
+    if (impl == 0)
+        return EINVAL;
+    conv_cur = impl;
+    return 0;
+}
+
+// the implementation in use - picks the best available on the first call
+const CONV_IMPL_T *conv_impl(void) {
+    int id;
+    if (conv_cur == 0) {
+        for (id = CONV_NUM_IMPL - 1; id >= 0; id--) {
+            if (conv_select(id) == 0)
+                break;
+        }
+    }
+    return conv_cur;
+}
+
+// --- rows ---
+
+// closest palette entry to a color
+static uint8_t conv_nearest(const PALETTE_T *pal, uint32_t c) {
+    int i, best = 0;
+    int bestd = 0x7FFFFFFF;
+    int r = (c >> 16) & 0xFF;
+    int g = (c >> 8) & 0xFF;
+    int b = c & 0xFF;
+    for (i = 0; i < pal->num; i++) {
+        int dr = r - (int)((pal->rgb[i] >> 16) & 0xFF);
+        int dg = g - (int)((pal->rgb[i] >> 8) & 0xFF);
+        int db = b - (int)(pal->rgb[i] & 0xFF);
+        int d = dr * dr + dg * dg + db * db;
+        if (d < bestd) {
+            bestd = d;
+            best = i;
+            if (d == 0)
+                break;
+        }
+    }
+    return best;
+}
+
+// convert a row of pixels to XRGB8888 (top byte 0, kept for XRGB8888)
+void conv_to_xrgb(uint32_t *out, const uint8_t *in, int n, PIX_FMT_T fmt,
+                  const PALETTE_T *pal) {
+    const CONV_IMPL_T *impl = conv_impl();
+    int i;
+    switch (fmt) {
+    case PIX_FMT_PAL8:
+        if (pal != 0) {
+            impl->pal8_to_xrgb(out, in, n, pal->rgb);
+        }
+        else { // no palette - show the index as grey
+            for (i = 0; i < n; i++)
+                out[i] = in[i] * 0x010101;
+        }
+        break;
+    case PIX_FMT_RGB565:
+        impl->rgb565_to_xrgb(out, (const uint16_t *)in, n);
+        break;
+    case PIX_FMT_BGR888:
+        impl->rgb24_to_xrgb(out, in, n, 1);
+        break;
+    case PIX_FMT_RGB888:
+        impl->rgb24_to_xrgb(out, in, n, 0);
+        break;
+    case PIX_FMT_XRGB8888:
+        memcpy(out, in, n * 4);
+        break;
+    }
+}
+
+// convert a row of XRGB8888 pixels to 'fmt'
+void conv_from_xrgb(uint8_t *out, const uint32_t *in, int n, PIX_FMT_T fmt,
+                    const PALETTE_T *pal) {
+    const CONV_IMPL_T *impl = conv_impl();
+    int i;
+    switch (fmt) {
+    case PIX_FMT_PAL8:
+        if ((pal != 0) && (pal->lut != 0)) { // a table lookup per pixel
+            for (i = 0; i < n; i++) {
+                uint32_t c = in[i];
+                out[i] = pal->lut[((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0)
+                                  | ((c >> 3) & 0x001F)];
+            }
+        }
+        else if (pal != 0) {
+            for (i = 0; i < n; i++)
+                out[i] = conv_nearest(pal, in[i]);
+        }
+        else { // no palette - use the green component as the index
+            for (i = 0; i < n; i++)
+                out[i] = in[i] >> 8;
+        }
+        break;
+    case PIX_FMT_RGB565:
+        impl->xrgb_to_rgb565((uint16_t *)out, in, n);
+        break;
+    case PIX_FMT_BGR888:
+        impl->xrgb_to_rgb24(out, in, n, 1);
+        break;
+    case PIX_FMT_RGB888:
+        impl->xrgb_to_rgb24(out, in, n, 0);
+        break;
+    case PIX_FMT_XRGB8888:
+        memcpy(out, in, n * 4);
+        break;
+    }
+}
+
+// convert a row of n pixels between any two formats (not in place)
+void conv_row(uint8_t *out, PIX_FMT_T ofmt, const PALETTE_T *opal,
+              const uint8_t *in, PIX_FMT_T ifmt, const PALETTE_T *ipal, int n) {
+    uint32_t tmp[CONV_CHUNK];
+    int ib = pix_fmt_bytes(ifmt);
+    int ob = pix_fmt_bytes(ofmt);
+    if ((ifmt == ofmt) && ((ifmt != PIX_FMT_PAL8) || (ipal == opal))) {
+        memmove(out, in, n * ib);
+        return;
+    }
+    // straight to or from XRGB8888 needs no row buffer
+    if (ofmt == PIX_FMT_XRGB8888) {
+        conv_to_xrgb((uint32_t *)out, in, n, ifmt, ipal);
+        return;
+    }
+    if (ifmt == PIX_FMT_XRGB8888) {
+        conv_from_xrgb(out, (const uint32_t *)in, n, ofmt, opal);
+        return;
+    }
+    while (n > 0) {
+        int k = (n > CONV_CHUNK) ? CONV_CHUNK : n;
+        conv_to_xrgb(tmp, in, k, ifmt, ipal);
+        conv_from_xrgb(out, tmp, k, ofmt, opal);
+        in += k * ib;
+        out += k * ob;
+        n -= k;
+    }
+}
+
+// check every available implementation against the scalar one with
+// random rows of all lengths up to 300 and odd alignments - returns the
+// number of mismatching rows (0 if all agree); leaves the best selected
+int conv_selftest(void) {
+    enum { MAXN = 300 };
+    uint8_t *in = malloc(MAXN * 4 + 16);
+    uint8_t *a = malloc(MAXN * 4 + 16);
+    uint8_t *b = malloc(MAXN * 4 + 16);
+    uint32_t pal[256];
+    const CONV_IMPL_T *ref = &conv_scalar;
+    int id, n, k, ofs, errors = 0;
+
+    if (!in || !a || !b) {
+        free(in);
+        free(a);
+        free(b);
+        return -1;
+    }
+    uint32_t seed = 1;
+#define CONV_RAND() (seed = seed * 1103515245 + 12345, seed >> 8)
+    for (k = 0; k < 256; k++)
+        pal[k] = CONV_RAND();
+    for (id = CONV_SCALAR + 1; id < CONV_NUM_IMPL; id++) {
+        const CONV_IMPL_T *t = conv_get(id);
+        if (t == 0)
+            continue;
+        for (n = 0; n <= MAXN; n++) {
+            ofs = n & 3;
+            for (k = 0; k < MAXN * 4 + 16; k++)
+                in[k] = CONV_RAND();
+            // compare the outputs, including the bytes after the end
+            // (the kernels may not write past n pixels)
+#define CONV_CHECK(call_a, call_b) \
+            memset(a, 0x5A, MAXN * 4 + 16); \
+            memset(b, 0x5A, MAXN * 4 + 16); \
+            call_a; \
+            call_b; \
+            if (memcmp(a, b, MAXN * 4 + 16) != 0) \
+                errors++;
+            CONV_CHECK(ref->rgb565_to_xrgb((uint32_t *)a, (uint16_t *)(in + 2 * ofs), n),
+                       t->rgb565_to_xrgb((uint32_t *)b, (uint16_t *)(in + 2 * ofs), n));
+            CONV_CHECK(ref->xrgb_to_rgb565((uint16_t *)(a + 2 * ofs), (uint32_t *)in, n),
+                       t->xrgb_to_rgb565((uint16_t *)(b + 2 * ofs), (uint32_t *)in, n));
+            CONV_CHECK(ref->rgb24_to_xrgb((uint32_t *)a, in + ofs, n, n & 1),
+                       t->rgb24_to_xrgb((uint32_t *)b, in + ofs, n, n & 1));
+            CONV_CHECK(ref->xrgb_to_rgb24(a + ofs, (uint32_t *)in, n, n & 1),
+                       t->xrgb_to_rgb24(b + ofs, (uint32_t *)in, n, n & 1));
+            CONV_CHECK(ref->pal8_to_xrgb((uint32_t *)a, in + ofs, n, pal),
+                       t->pal8_to_xrgb((uint32_t *)b, in + ofs, n, pal));
+#undef CONV_CHECK
+        }
+    }
+#undef CONV_RAND
+    free(in);
+    free(a);
+    free(b);
+    conv_cur = 0;
+    conv_impl();
+    return errors;
+}
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * fbfill.h
+ *
+ * 16 bit (RGB565) fill kernels - instead of storing one uint16_t at a
+ * time the pixels are stored as replicated 32, 64 or 128 bit words:
+ * single pixels until the pointer is aligned (head), then the wide
+ * stores, then single pixels again for the rest (tail).
+ *
+ * The fill 'color' is a pattern of four pixels (one uint64_t, pixel n
+ * in bits 16 * n .. 16 * n + 15) repeating along the row, pixel x of a
+ * row gets pattern pixel x % 4 - a solid color is just the same pixel
+ * four times (fill16_solid). Rows may alternate between two patterns
+ * for dithering.
+ *
+ * Used by both the dispmanx example (dmx/dmxdblbuf.c FillRect) and the
+ * framebuffer surfaces (fbsurf.h). Plain C, no framebuffer headers.
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBFILL_H
+#define FBFILL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// solid color as a four pixel pattern
+static inline uint64_t fill16_solid(uint16_t c) {
+    return c * 0x0001000100010001ULL;
+}
+
+// helper function to get the pattern rotated so that its first pixel
+// is pattern pixel 'phase' (0-3) - little endian like the Pi
+static inline uint64_t fill16_rotate(uint64_t pat, int phase) {
+    int s = 16 * (phase & 3);
+    return (s == 0) ? pat : (pat >> s) | (pat << (64 - s));
+}
+
+// fill n pixels with 32 bit stores - 'x' is the pattern phase of p[0]
+static inline void fill16_span_w32(uint16_t *p, int n, uint64_t pat, int x) {
+    // head: single pixels until 4 byte aligned
+    while ((n > 0) && ((uintptr_t)p & 3)) {
+        *p++ = pat >> (16 * (x++ & 3));
+        n--;
+    }
+    uint64_t r = fill16_rotate(pat, x);
+    uint32_t lo = r;
+    uint32_t hi = r >> 32;
+    uint32_t *q = (uint32_t *)p;
+    for (; n >= 4; n -= 4) {
+        q[0] = lo;
+        q[1] = hi;
+        q += 2;
+    }
+    // tail (the wide stores are whole patterns, x mod 4 is unchanged)
+    p = (uint16_t *)q;
+    while (n-- > 0)
+        *p++ = pat >> (16 * (x++ & 3));
+}
+
+// fill n pixels with 64 bit stores
+static inline void fill16_span_w64(uint16_t *p, int n, uint64_t pat, int x) {
+    while ((n > 0) && ((uintptr_t)p & 7)) {
+        *p++ = pat >> (16 * (x++ & 3));
+        n--;
+    }
+    uint64_t r = fill16_rotate(pat, x);
+    uint64_t *q = (uint64_t *)p;
+    for (; n >= 16; n -= 16) {
+        q[0] = r;
+        q[1] = r;
+        q[2] = r;
+        q[3] = r;
+        q += 4;
+    }
+    for (; n >= 4; n -= 4)
+        *q++ = r;
+    p = (uint16_t *)q;
+    while (n-- > 0)
+        *p++ = pat >> (16 * (x++ & 3));
+}
+
+// fill n pixels with 128 bit stores (SSE2/NEON, 64 bit pairs otherwise)
+static inline void fill16_span_w128(uint16_t *p, int n, uint64_t pat, int x) {
+    while ((n > 0) && ((uintptr_t)p & 15)) {
+        *p++ = pat >> (16 * (x++ & 3));
+        n--;
+    }
+    uint64_t r = fill16_rotate(pat, x);
+#if defined(__SSE2__)
+    __m128i v = _mm_set1_epi64x(r);
+    for (; n >= 32; n -= 32) {
+        _mm_store_si128((__m128i *)p, v);
+        _mm_store_si128((__m128i *)(p + 8), v);
+        _mm_store_si128((__m128i *)(p + 16), v);
+        _mm_store_si128((__m128i *)(p + 24), v);
+        p += 32;
+    }
+    for (; n >= 8; n -= 8) {
+        _mm_store_si128((__m128i *)p, v);
+        p += 8;
+    }
+#elif defined(__ARM_NEON)
+    uint16x8_t v = vreinterpretq_u16_u64(vdupq_n_u64(r));
+    for (; n >= 32; n -= 32) {
+        vst1q_u16(p, v);
+        vst1q_u16(p + 8, v);
+        vst1q_u16(p + 16, v);
+        vst1q_u16(p + 24, v);
+        p += 32;
+    }
+    for (; n >= 8; n -= 8) {
+        vst1q_u16(p, v);
+        p += 8;
+    }
+#else
+    uint64_t *q = (uint64_t *)p;
+    for (; n >= 8; n -= 8) {
+        q[0] = r;
+        q[1] = r;
+        q += 2;
+    }
+    p = (uint16_t *)q;
+#endif
+    while (n-- > 0)
+        *p++ = pat >> (16 * (x++ & 3));
+}
+
+// the widest kernel for the platform
+static inline void fill16_span(uint16_t *p, int n, uint64_t pat, int x) {
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    fill16_span_w128(p, n, pat, x);
+#else
+    // ARMv6 (Pi 1/Zero) has no NEON, but strd/stm of two words still
+    // halves the store count compared to 32 bit stores
+    fill16_span_w64(p, n, pat, x);
+#endif
+}
+
+// helper function to test if a solid pattern has equal bytes (memset-able)
+static inline int fill16_is_byte(uint64_t pat) {
+    return pat == (pat & 0xFF) * 0x0101010101010101ULL;
+}
+
+// fill the whole image (h rows of 'pitch' bytes, padding included) -
+// the fast way to clear when the padding at the row ends is not shown
+// (a non-solid pattern needs pitch to be a multiple of 8 bytes)
+static inline void fill16_clear(void *base, int pitch, int h, uint64_t pat) {
+    if (fill16_is_byte(pat))
+        memset(base, pat & 0xFF, (size_t)pitch * h);
+    else
+        fill16_span((uint16_t *)base, pitch / 2 * h, pat, 0);
+}
+
+// fill a rectangle - rows alternate between pat[0] (even y) and pat[1]
+// (odd y), for a solid color or a plain pattern both are the same
+static inline void fill16_rect_pattern(void *base, int pitch, int x, int y,
+                                       int w, int h, const uint64_t pat[2]) {
+    int row;
+    if ((w <= 0) || (h <= 0))
+        return;
+    uint8_t *line = (uint8_t *)base + (size_t)y * pitch + x * 2;
+    // rows covering the whole pitch are one contiguous span (as long as
+    // the pattern phase carries over from one row to the next)
+    if ((x == 0) && (w * 2 == pitch) && (pat[0] == pat[1])
+        && (((w & 3) == 0) || (pat[0] == fill16_solid(pat[0])))) {
+        if (fill16_is_byte(pat[0]))
+            memset(line, pat[0] & 0xFF, (size_t)pitch * h);
+        else
+            fill16_span((uint16_t *)line, w * h, pat[0], 0);
+        return;
+    }
+    for (row = 0; row < h; row++) {
+        fill16_span((uint16_t *)line, w, pat[(y + row) & 1], x);
+        line += pitch;
+    }
+}
+
+// fill a rectangle with a solid color
+static inline void fill16_rect(void *base, int pitch, int x, int y, int w, int h,
+                               uint16_t c) {
+    uint64_t pat[2];
+    pat[0] = pat[1] = fill16_solid(c);
+    fill16_rect_pattern(base, pitch, x, y, w, h, pat);
+}
+
+// fill a rectangle of an image 'width' pixels wide whose row padding is
+// never shown - a rectangle of whole rows fills the padding too, as one
+// block
+static inline void fill16_image_rect(void *base, int pitch, int width, int x, int y,
+                                     int w, int h, uint16_t c) {
+    if ((x == 0) && (w == width) && (h > 0)) {
+        fill16_clear((uint8_t *)base + (size_t)y * pitch, pitch, h, fill16_solid(c));
+        return;
+    }
+    fill16_rect(base, pitch, x, y, w, h, c);
+}
+
+// fill n 32 bit pixels - the same kernels with a two word pattern
+static inline void fill32_span(uint32_t *p, int n, uint32_t c) {
+    fill16_span((uint16_t *)p, 2 * n, c * 0x0000000100000001ULL, 0);
+}
+
+#endif
@@ -1,7 +1,13 @@
 /*
  * fbfire.c
  *
- * 
+ * Fire effect in 8 bit palette mode. The smoothing and convection passes
+ * run in bands of rows on all cores (fbpar.h) - smoothing goes through a
+ * work buffer so that no band reads rows another one is writing. Give the
+ * number of threads to use as an argument (1 for one core).
+ *
+ * To build:
+ *   gcc -O2 -o fbfire fbfire.c -lpthread
  *
  * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
  *
@@ -23,6 +29,9 @@
 #include <linux/kd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <time.h>
+
+#include "fbpar.h"
 
 // default framebuffer palette
 typedef enum {
@@ -60,6 +69,47 @@ char get_pixel(int x, int y, void *fbp, struct fb_var_screeninfo *vinfo) {
     return *((char*)(fbp + offset));
 }
 
+typedef struct {
+    char *fbp;
+    char *heat;       // the screen after smoothing (work buffer)
+    struct fb_var_screeninfo *vinfo;
+    int maxx;
+    int maxy;
+} FIRE_T;
+
+// smooth: rows y0 .. y1 - 1 of 'heat' from the screen rows below them -
+// the bottom rows that do not get smoothed are copied as they are
+void smooth_rows(void *arg, int y0, int y1) {
+    FIRE_T *f = (FIRE_T *)arg;
+    int x, y, c, c0, c1, c2;
+    for (y = y0; y < y1; y++) {
+        if (y > f->maxy - 3) {
+            memcpy(f->heat + y * f->vinfo->xres, f->fbp + y * f->vinfo->xres, f->vinfo->xres);
+            continue;
+        }
+        for (x = 1; x < f->maxx; x++) {
+            c0 = get_pixel(x - 1, y + 1, f->fbp, f->vinfo);
+            c1 = get_pixel(x, y + 2, f->fbp, f->vinfo);
+            c2 = get_pixel(x + 1, y + 1, f->fbp, f->vinfo);
+            c = (c0 + c1 + c1 + c2) / 4;
+            put_pixel(x, y, f->heat, f->vinfo, c);
+        }
+    }
+}
+
+// convect: rows y0 .. y1 - 1 of the screen from the 'heat' rows below
+void convect_rows(void *arg, int y0, int y1) {
+    FIRE_T *f = (FIRE_T *)arg;
+    int x, y, c;
+    for (y = y0; y < y1; y++) {
+        for (x = 1; x < f->maxx; x++) {
+            c = get_pixel(x, y + 1, f->heat, f->vinfo);
+            if (c > 0) c--;
+            put_pixel(x, y, f->fbp, f->vinfo, c);
+        }
+    }
+}
+
 // application entry point
 int main(int argc, char* argv[])
 {
@@ -69,6 +119,11 @@ int main(int argc, char* argv[])
     struct fb_fix_screeninfo fix_info;
     char *fbp = 0; // framebuffer memory pointer
 
+    // threads for the passes (0 = one per core)
+    if (par_init((argc > 1) ? atoi(argv[1]) : 0) != 0) {
+        printf("Could not start all threads.\n");
+    }
+
     // Open the framebuffer device file for reading and writing
     fbfd = open("/dev/fb0", O_RDWR);
     if (!fbfd) {
@@ -157,12 +212,20 @@ int main(int argc, char* argv[])
         printf("Failed to mmap.\n");
     }
   
-    if ((int)fbp != -1) {
+    char *heat = malloc(var_info.xres * var_info.yres);
+    if (heat == 0) {
+        printf("Failed to malloc.\n");
+    }
+
+    if (((int)fbp != -1) && (heat != 0)) {
         // Draw
         int maxx = var_info.xres - 1;
         int maxy = var_info.yres - 1;
-        int n = 0, r, c, x, y;
-        int c0, c1, c2;
+        int n = 0, r, c, x;
+        FIRE_T fire = { fbp, heat, &var_info, maxx, maxy };
+        struct timespec pt;
+        struct timespec ct;
+        clock_gettime(CLOCK_MONOTONIC, &pt);
         while (n++ < 200) {
 
             // seed
@@ -179,28 +242,19 @@ int main(int argc, char* argv[])
             }
 
             // smooth
-            for (y = 1; y < maxy - 1; y++) {
-                for (x = 1; x < maxx; x++) {
-                    c0 = get_pixel(x - 1, y, fbp, &var_info);
-                    c1 = get_pixel(x, y + 1, fbp, &var_info);
-                    c2 = get_pixel(x + 1, y, fbp, &var_info);
-                    c = (c0 + c1 + c1 + c2) / 4;
-                    put_pixel(x, y - 1, fbp, &var_info, c);
-                }
-            }
+            par_for(maxy + 1, var_info.xres, smooth_rows, &fire);
 
             // convect
-            for (y = 0; y < maxy; y++) {
-                for (x = 1; x < maxx; x++) {
-                    c = get_pixel(x, y + 1, fbp, &var_info);
-                    if (c > 0) c--;
-                    put_pixel(x, y, fbp, &var_info, c);
-                }
-            }
+            par_for(maxy, var_info.xres, convect_rows, &fire);
 
             //usleep(100);
         }
+        clock_gettime(CLOCK_MONOTONIC, &ct);
+        printf("200 frames in %ld ms on %d threads\n",
+               (ct.tv_sec - pt.tv_sec) * 1000 + (ct.tv_nsec - pt.tv_nsec) / 1000000,
+               par_threads());
     }
+    free(heat);
 
     // Cleanup
     // unmap fb file from memory
@@ -225,6 +279,7 @@ int main(int argc, char* argv[])
     }
     // close fb file  
     close(fbfd);
+    par_exit();
 
     return 0;
     
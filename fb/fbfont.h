@@ -0,0 +1,283 @@
+/*
+ * fbfont.h
+ *
+ * Bitmap fonts as packed bits - one bit per pixel, each glyph row
+ * 'pitch' bytes with the leftmost pixel in the top bit (the layout of
+ * the console fonts) - and drawing a glyph a row at a time: four glyph
+ * pixels are looked up at once in a 16 entry table of ready-made 8 or
+ * 16 bit pixel words, no per pixel calls.
+ *
+ * The 'image' fonts of font/fbtestfnt.h (one char per pixel) are packed
+ * with font_from_img, console fonts are loaded with fbpsf.h.
+ *
+ * Characters are Unicode code points: a font covers either a range
+ * (first .. first + num - 1) or, with a Unicode table (font_map), any
+ * characters of the Basic Multilingual Plane - the table is two-level,
+ * 256 pages of 256 glyph entries and only the pages in use allocated,
+ * so a lookup is two loads whatever the size of the font. Strings are
+ * UTF-8, decoded as they are drawn (font_draw_text).
+ *
+ * Usage:
+ *   #include "font/fbtestfnt.h"
+ *   font_from_img(&font, fontImg[0], sizeof(fontImg) / (FONTW * FONTH),
+ *                 FONTW, FONTH, ' ');
+ *   font_draw_glyph(&screen, x, y, &font, font_glyph(&font, 'A'), fg, bg);
+ *   font_draw_text(&screen, x, y, &font, "K\xc3\x84Y", fg, bg);
+ *   font_free(&font);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBFONT_H
+#define FBFONT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fbsurf.h"
+
+typedef struct {
+    int width;          // glyph size in pixels
+    int height;
+    int pitch;          // bytes per glyph row
+    int num;            // glyphs
+    uint8_t *bits;      // num * height * pitch bytes
+    uint32_t first;     // character of glyph 0 (the rest follow in order)
+    int missing;        // glyph for characters the font does not have
+    int unicode;        // 1: characters through map, not first/num
+    uint16_t *map[256]; // pages of glyph + 1 (0: none) for U+0000 .. U+FFFF
+} FONT_T;
+
+// the page of the characters no glyph is mapped to (shared, never written)
+static uint16_t font_no_page[256];
+
+void font_free(FONT_T *f) {
+    int i;
+    free(f->bits);
+    for (i = 0; i < 256; i++) {
+        if (f->map[i] != font_no_page)
+            free(f->map[i]);
+    }
+    memset(f, 0, sizeof(*f));
+}
+
+// map character ch to glyph g (switches the font to the Unicode table,
+// no characters mapped at first) - characters above U+FFFF are ignored;
+// returns 0 or ENOMEM
+int font_map(FONT_T *f, uint32_t ch, int g) {
+    int i;
+    if (!f->unicode) {
+        for (i = 0; i < 256; i++)
+            f->map[i] = font_no_page;
+        f->unicode = 1;
+    }
+    if (ch > 0xFFFF)
+        return 0;
+    if (f->map[ch >> 8] == font_no_page) {
+        uint16_t *page = calloc(256, sizeof(uint16_t));
+        if (page == 0)
+            return ENOMEM;
+        f->map[ch >> 8] = page;
+    }
+    f->map[ch >> 8][ch & 0xFF] = g + 1;
+    return 0;
+}
+
+// pack 'num' w x h image glyphs (a char per pixel, non-zero = set, one
+// glyph after the other) for characters first .. first + num - 1 -
+// returns 0, EINVAL or ENOMEM
+int font_from_img(FONT_T *f, const char *img, int num, int w, int h, uint32_t first) {
+    int g, y, x;
+    memset(f, 0, sizeof(*f));
+    if ((num <= 0) || (w <= 0) || (h <= 0))
+        return EINVAL;
+    f->width = w;
+    f->height = h;
+    f->pitch = (w + 7) / 8;
+    f->num = num;
+    f->first = first;
+    f->bits = calloc((size_t)num * h, f->pitch);
+    if (f->bits == 0)
+        return ENOMEM;
+    for (g = 0; g < num; g++) {
+        for (y = 0; y < h; y++) {
+            uint8_t *row = f->bits + ((size_t)g * h + y) * f->pitch;
+            for (x = 0; x < w; x++) {
+                if (img[((size_t)g * h + y) * w + x])
+                    row[x / 8] |= 0x80 >> (x % 8);
+            }
+        }
+    }
+    return 0;
+}
+
+// the glyph for character ch (f->missing if there is none)
+static inline int font_glyph(const FONT_T *f, uint32_t ch) {
+    if (f->unicode) {
+        int e = (ch <= 0xFFFF) ? f->map[ch >> 8][ch & 0xFF] : 0;
+        return (e > 0) ? e - 1 : f->missing;
+    }
+    if ((ch >= f->first) && (ch - f->first < (uint32_t)f->num))
+        return ch - f->first;
+    return f->missing;
+}
+
+// decode the UTF-8 character at *s and step past it - malformed bytes
+// (stray continuation bytes, overlong forms, surrogates, cut sequences)
+// are U+FFFD, a byte at a time
+static inline uint32_t utf8_next(const char **s) {
+    const uint8_t *p = (const uint8_t *)*s;
+    uint32_t c = p[0];
+    int n, i;
+    if (c < 0x80) {
+        *s += 1;
+        return c;
+    }
+    if ((c & 0xE0) == 0xC0) {
+        n = 1;
+        c &= 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0) {
+        n = 2;
+        c &= 0x0F;
+    }
+    else if ((c & 0xF8) == 0xF0) {
+        n = 3;
+        c &= 0x07;
+    }
+    else {
+        *s += 1;
+        return 0xFFFD;
+    }
+    for (i = 1; i <= n; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *s += 1;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+    if ((c < ((n == 1) ? 0x80u : (n == 2) ? 0x800u : 0x10000u))
+        || (c > 0x10FFFF) || ((c >= 0xD800) && (c <= 0xDFFF))) {
+        *s += 1;
+        return 0xFFFD;
+    }
+    *s += n + 1;
+    return c;
+}
+
+// helper function to get row y of glyph g
+static inline const uint8_t *font_row(const FONT_T *f, int g, int y) {
+    return f->bits + ((size_t)g * f->height + y) * f->pitch;
+}
+
+// lookup of four glyph pixels (a nibble, top bit leftmost) to pixel
+// words - rebuilt only when the colors change
+typedef struct {
+    int fmt;            // -1: not built
+    uint32_t fg;
+    uint32_t bg;
+    uint64_t nib[16];   // four 8 or 16 bit pixels in memory order
+} FONT_LUT_T;
+
+// helper function to (re)build the lookup for fg/bg in format fmt
+static void font_lut(FONT_LUT_T *l, PIX_FMT_T fmt, uint32_t fg, uint32_t bg) {
+    int n, i;
+    if ((l->fmt == (int)fmt) && (l->fg == fg) && (l->bg == bg))
+        return;
+    l->fmt = fmt;
+    l->fg = fg;
+    l->bg = bg;
+    for (n = 0; n < 16; n++) {
+        uint64_t w = 0;
+        for (i = 0; i < 4; i++) {
+            uint64_t c = (n & (8 >> i)) ? fg : bg;
+            if (fmt == PIX_FMT_PAL8)
+                w |= (c & 0xFF) << (8 * i);
+            else
+                w |= (c & 0xFFFF) << (16 * i);
+        }
+        l->nib[n] = w;
+    }
+}
+
+// draw glyph g at x, y in fg on bg (raw colors of the surface) - glyphs
+// partly outside the surface are clipped; 'lut' may be 0 (a local one
+// is built - keep one around when drawing many glyphs)
+void font_draw_glyph_lut(SURFACE_T *s, int x, int y, const FONT_T *f, int g,
+                         uint32_t fg, uint32_t bg, FONT_LUT_T *lut) {
+    FONT_LUT_T local;
+    int bpp = pix_fmt_bytes(s->fmt);
+    int row, i;
+    if ((x >= 0) && (y >= 0) && (x + f->width <= s->width) && (y + f->height <= s->height)
+        && ((f->width & 3) == 0) && ((bpp == 1) || (bpp == 2))) {
+        // whole glyph, four pixels per lookup
+        if (lut == 0) {
+            local.fmt = -1;
+            lut = &local;
+        }
+        font_lut(lut, s->fmt, fg, bg);
+        uint8_t *p = (uint8_t *)surface_pixel(s, x, y);
+        for (row = 0; row < f->height; row++, p += s->line_length) {
+            const uint8_t *b = font_row(f, g, row);
+            uint8_t *q = p;
+            for (i = 0; i < f->width / 4; i++) {
+                int n = (b[i / 2] >> ((i & 1) ? 0 : 4)) & 0xF;
+                memcpy(q, &lut->nib[n], 4 * bpp);
+                q += 4 * bpp;
+            }
+        }
+        return;
+    }
+    if ((x >= 0) && (y >= 0) && (x + f->width <= s->width) && (y + f->height <= s->height)
+        && (bpp == 4)) {
+        uint8_t *p = (uint8_t *)surface_pixel(s, x, y);
+        for (row = 0; row < f->height; row++, p += s->line_length) {
+            const uint8_t *b = font_row(f, g, row);
+            uint32_t *q = (uint32_t *)p;
+            for (i = 0; i < f->width; i++)
+                q[i] = (b[i / 8] & (0x80 >> (i % 8))) ? fg : bg;
+        }
+        return;
+    }
+    // anything else a pixel at a time
+    for (row = 0; row < f->height; row++) {
+        const uint8_t *b = font_row(f, g, row);
+        if ((y + row < 0) || (y + row >= s->height))
+            continue;
+        for (i = 0; i < f->width; i++) {
+            if ((x + i >= 0) && (x + i < s->width))
+                surface_put_pixel(s, x + i, y + row,
+                                  (b[i / 8] & (0x80 >> (i % 8))) ? fg : bg);
+        }
+    }
+}
+
+static inline void font_draw_glyph(SURFACE_T *s, int x, int y, const FONT_T *f, int g,
+                                   uint32_t fg, uint32_t bg) {
+    font_draw_glyph_lut(s, x, y, f, g, fg, bg, 0);
+}
+
+// draw UTF-8 string str from x, y (clipped) - returns the x after it
+int font_draw_text(SURFACE_T *s, int x, int y, const FONT_T *f, const char *str,
+                   uint32_t fg, uint32_t bg) {
+    FONT_LUT_T lut;
+    lut.fmt = -1;
+    while (*str && (x < s->width)) {
+        int g = font_glyph(f, utf8_next(&str));
+        font_draw_glyph_lut(s, x, y, f, g, fg, bg, &lut);
+        x += f->width;
+    }
+    return x;
+}
+
+#endif // FBFONT_H
@@ -0,0 +1,374 @@
+/*
+ * fbgrid.h
+ *
+ * Uniform grid for finding which of many moving rectangles touch each
+ * other (or a point, or an area) without comparing every pair - the
+ * screen is split into cells of 1 << shift pixels and each cell keeps
+ * the ids of the objects overlapping it.
+ *
+ * The grid is updated object by object (grid_set after moving one): an
+ * object that stays in the same cells costs only a rectangle copy, one
+ * that crossed a cell border is taken out of its old cells and put in
+ * the new ones. Nothing is rebuilt from scratch per frame.
+ *
+ * Queries:
+ *   grid_pairs  - every overlapping pair once (broad and narrow phase;
+ *                 a pair sharing several cells is reported only in the
+ *                 cell holding the top left corner of the overlap)
+ *   grid_query  - the objects overlapping a rectangle
+ *   grid_hit    - the object at a point
+ *   grid_damage - the areas where objects were added, moved or removed
+ *                 since the last call, as whole cells merged into
+ *                 rectangles (to redraw, or to pass to comp_damage)
+ *
+ * Objects are ids 0 .. max - 1 given at grid_init. Rectangles outside
+ * the grid area are fine, they go to the cells at the border.
+ *
+ * Usage:
+ *   grid_init(&g, 960, 540, 5, 2000);
+ *   each frame:
+ *     grid_set(&g, id, &rect); ...  (for the objects that moved)
+ *     grid_pairs(&g, collide, &args);
+ *     n = grid_damage(&g, rects, 32);
+ *   grid_free(&g);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBGRID_H
+#define FBGRID_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fbsurf.h"
+
+typedef struct {
+    int num;            // ids in the cell
+    int cap;
+    int *ids;
+} GRID_CELL_T;
+
+typedef struct {
+    RECT_T r;
+    short c0, r0;       // cells covered (c1, r1 inclusive), c0 < 0: not in
+    short c1, r1;
+    unsigned stamp;     // last query that reported the object
+} GRID_OBJ_T;
+
+// called for each overlapping pair (a < b)
+typedef void (*GRID_PAIR_FUNC_T)(void *arg, int a, int b);
+
+typedef struct {
+    int width;          // area in pixels
+    int height;
+    int shift;          // cell size 1 << shift
+    int cols;
+    int rows;
+    GRID_CELL_T *cells;
+    uint8_t *dirty;     // per cell, for grid_damage
+    int max;
+    GRID_OBJ_T *objs;
+    unsigned stamp;
+} GRID_T;
+
+void grid_free(GRID_T *g) {
+    int i;
+    if (g->cells) {
+        for (i = 0; i < g->cols * g->rows; i++)
+            free(g->cells[i].ids);
+    }
+    free(g->cells);
+    free(g->dirty);
+    free(g->objs);
+    memset(g, 0, sizeof(*g));
+}
+
+// set up a w x h grid with cells of 1 << shift pixels for objects
+// 0 .. max - 1 (all out of the grid) - returns 0, EINVAL or ENOMEM
+int grid_init(GRID_T *g, int w, int h, int shift, int max) {
+    int i;
+    memset(g, 0, sizeof(*g));
+    if ((w <= 0) || (h <= 0) || (shift < 0) || (shift > 14) || (max <= 0))
+        return EINVAL;
+    g->width = w;
+    g->height = h;
+    g->shift = shift;
+    g->cols = (w + (1 << shift) - 1) >> shift;
+    g->rows = (h + (1 << shift) - 1) >> shift;
+    g->max = max;
+    g->cells = calloc(g->cols * g->rows, sizeof(GRID_CELL_T));
+    g->dirty = calloc(g->cols * g->rows, 1);
+    g->objs = calloc(max, sizeof(GRID_OBJ_T));
+    if ((g->cells == 0) || (g->dirty == 0) || (g->objs == 0)) {
+        grid_free(g);
+        return ENOMEM;
+    }
+    for (i = 0; i < max; i++)
+        g->objs[i].c0 = -1;
+    return 0;
+}
+
+// helper function for the cell column/row of a pixel, clamped to the grid
+static inline int grid_col(const GRID_T *g, int x) {
+    x >>= g->shift;
+    return (x < 0) ? 0 : (x >= g->cols) ? g->cols - 1 : x;
+}
+
+static inline int grid_row(const GRID_T *g, int y) {
+    y >>= g->shift;
+    return (y < 0) ? 0 : (y >= g->rows) ? g->rows - 1 : y;
+}
+
+static inline int grid_overlap(const RECT_T *a, const RECT_T *b) {
+    return (a->x < b->x + b->w) && (b->x < a->x + a->w)
+        && (a->y < b->y + b->h) && (b->y < a->y + a->h);
+}
+
+// helper function to mark the cells of an object dirty
+static void grid_mark(GRID_T *g, const GRID_OBJ_T *o) {
+    int cx, cy;
+    for (cy = o->r0; cy <= o->r1; cy++)
+        for (cx = o->c0; cx <= o->c1; cx++)
+            g->dirty[cy * g->cols + cx] = 1;
+}
+
+// helper function to take an object out of its cells
+static void grid_unlink(GRID_T *g, int id) {
+    GRID_OBJ_T *o = &g->objs[id];
+    int cx, cy, i;
+    for (cy = o->r0; cy <= o->r1; cy++) {
+        for (cx = o->c0; cx <= o->c1; cx++) {
+            GRID_CELL_T *c = &g->cells[cy * g->cols + cx];
+            for (i = 0; i < c->num; i++) {
+                if (c->ids[i] == id) {
+                    c->ids[i] = c->ids[--c->num];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// helper function to put an object in its cells - returns 0 or ENOMEM
+static int grid_link(GRID_T *g, int id) {
+    GRID_OBJ_T *o = &g->objs[id];
+    int cx, cy;
+    for (cy = o->r0; cy <= o->r1; cy++) {
+        for (cx = o->c0; cx <= o->c1; cx++) {
+            GRID_CELL_T *c = &g->cells[cy * g->cols + cx];
+            if (c->num == c->cap) {
+                int cap = (c->cap > 0) ? c->cap * 2 : 8;
+                int *ids = realloc(c->ids, cap * sizeof(int));
+                if (ids == 0)
+                    return ENOMEM;
+                c->ids = ids;
+                c->cap = cap;
+            }
+            c->ids[c->num++] = id;
+        }
+    }
+    return 0;
+}
+
+// take object 'id' out of the grid (its cells become damaged)
+void grid_remove(GRID_T *g, int id) {
+    GRID_OBJ_T *o;
+    if ((id < 0) || (id >= g->max) || (g->objs[id].c0 < 0))
+        return;
+    o = &g->objs[id];
+    grid_unlink(g, id);
+    grid_mark(g, o);
+    o->c0 = -1;
+}
+
+// put object 'id' at rectangle r (adds it, or moves it from where it
+// was) - the old and new cells become damaged if the rectangle changed;
+// returns 0, EINVAL or ENOMEM (the object is then out of the grid)
+int grid_set(GRID_T *g, int id, const RECT_T *r) {
+    GRID_OBJ_T *o;
+    int c0, r0, c1, r1;
+    if ((id < 0) || (id >= g->max))
+        return EINVAL;
+    if ((r->w <= 0) || (r->h <= 0)) {
+        grid_remove(g, id);
+        return 0;
+    }
+    o = &g->objs[id];
+    if ((o->c0 >= 0) && (memcmp(&o->r, r, sizeof(RECT_T)) == 0))
+        return 0;
+    c0 = grid_col(g, r->x);
+    r0 = grid_row(g, r->y);
+    c1 = grid_col(g, r->x + r->w - 1);
+    r1 = grid_row(g, r->y + r->h - 1);
+    if (o->c0 >= 0) {
+        grid_mark(g, o);
+        if ((o->c0 == c0) && (o->r0 == r0) && (o->c1 == c1) && (o->r1 == r1)) {
+            // same cells - nothing to relink
+            o->r = *r;
+            return 0;
+        }
+        grid_unlink(g, id);
+    }
+    o->r = *r;
+    o->c0 = c0;
+    o->r0 = r0;
+    o->c1 = c1;
+    o->r1 = r1;
+    grid_mark(g, o);
+    if (grid_link(g, id) != 0) {
+        grid_unlink(g, id);
+        o->c0 = -1;
+        return ENOMEM;
+    }
+    return 0;
+}
+
+// call fn(arg, a, b) for every pair of objects whose rectangles overlap
+// (a < b) - returns the number of pairs
+int grid_pairs(GRID_T *g, GRID_PAIR_FUNC_T fn, void *arg) {
+    int cx, cy, i, j, n = 0;
+    for (cy = 0; cy < g->rows; cy++) {
+        for (cx = 0; cx < g->cols; cx++) {
+            GRID_CELL_T *c = &g->cells[cy * g->cols + cx];
+            for (i = 0; i < c->num; i++) {
+                const RECT_T *a = &g->objs[c->ids[i]].r;
+                for (j = i + 1; j < c->num; j++) {
+                    const RECT_T *b = &g->objs[c->ids[j]].r;
+                    if (!grid_overlap(a, b))
+                        continue;
+                    // only in the cell of the overlap's top left corner
+                    if ((grid_col(g, (a->x > b->x) ? a->x : b->x) != cx)
+                        || (grid_row(g, (a->y > b->y) ? a->y : b->y) != cy))
+                        continue;
+                    if (c->ids[i] < c->ids[j])
+                        fn(arg, c->ids[i], c->ids[j]);
+                    else
+                        fn(arg, c->ids[j], c->ids[i]);
+                    n++;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+// the objects overlapping rectangle r, at most 'max' of them to 'out'
+// (in no particular order) - returns how many there are
+int grid_query(GRID_T *g, const RECT_T *r, int *out, int max) {
+    int c0, r0, c1, r1, cx, cy, i, n = 0;
+    if ((r->w <= 0) || (r->h <= 0))
+        return 0;
+    c0 = grid_col(g, r->x);
+    r0 = grid_row(g, r->y);
+    c1 = grid_col(g, r->x + r->w - 1);
+    r1 = grid_row(g, r->y + r->h - 1);
+    // objects in several cells are reported once
+    if (++g->stamp == 0) {
+        for (i = 0; i < g->max; i++)
+            g->objs[i].stamp = 0;
+        g->stamp = 1;
+    }
+    for (cy = r0; cy <= r1; cy++) {
+        for (cx = c0; cx <= c1; cx++) {
+            GRID_CELL_T *c = &g->cells[cy * g->cols + cx];
+            for (i = 0; i < c->num; i++) {
+                GRID_OBJ_T *o = &g->objs[c->ids[i]];
+                if ((o->stamp == g->stamp) || !grid_overlap(&o->r, r))
+                    continue;
+                o->stamp = g->stamp;
+                if (n < max)
+                    out[n] = c->ids[i];
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+// the object at x, y (the highest id if several) or -1
+int grid_hit(const GRID_T *g, int x, int y) {
+    const GRID_CELL_T *c = &g->cells[grid_row(g, y) * g->cols + grid_col(g, x)];
+    int i, hit = -1;
+    for (i = 0; i < c->num; i++) {
+        const RECT_T *r = &g->objs[c->ids[i]].r;
+        if ((x >= r->x) && (x < r->x + r->w) && (y >= r->y) && (y < r->y + r->h)
+            && (c->ids[i] > hit))
+            hit = c->ids[i];
+    }
+    return hit;
+}
+
+// the damaged cells since the last call as at most 'max' rectangles
+// (runs of cells in a row, stacked with the same run in the row above;
+// if there are more, one rectangle around all) clipped to the grid area
+// - clears the damage, returns the number of rectangles
+int grid_damage(GRID_T *g, RECT_T *out, int max) {
+    int cx, cy, x0, i, n = 0, row_first;
+    int size = 1 << g->shift;
+    RECT_T all = { 0, 0, g->width, g->height };
+    int bx0 = g->cols, by0 = g->rows, bx1 = -1, by1 = -1;
+    if (max <= 0)
+        return 0;
+    for (cy = 0; cy < g->rows; cy++) {
+        uint8_t *d = g->dirty + cy * g->cols;
+        row_first = n;
+        for (cx = 0; cx < g->cols; cx++) {
+            if (!d[cx])
+                continue;
+            x0 = cx;
+            while ((cx < g->cols) && d[cx])
+                d[cx++] = 0;
+            if (x0 < bx0)
+                bx0 = x0;
+            if (cx - 1 > bx1)
+                bx1 = cx - 1;
+            if (cy < by0)
+                by0 = cy;
+            by1 = cy;
+            if (n > max)
+                continue;
+            // the same run in the row above grows down
+            for (i = 0; i < row_first; i++) {
+                if ((out[i].y + out[i].h == cy * size)
+                    && (out[i].x == x0 * size) && (out[i].w == (cx - x0) * size)) {
+                    out[i].h += size;
+                    break;
+                }
+            }
+            if (i < row_first)
+                continue;
+            if (n == max) {
+                n++;
+                continue;
+            }
+            out[n].x = x0 * size;
+            out[n].y = cy * size;
+            out[n].w = (cx - x0) * size;
+            out[n].h = size;
+            n++;
+        }
+    }
+    if (n > max) {
+        out[0].x = bx0 * size;
+        out[0].y = by0 * size;
+        out[0].w = (bx1 - bx0 + 1) * size;
+        out[0].h = (by1 - by0 + 1) * size;
+        n = 1;
+    }
+    for (i = 0; i < n; i++)
+        rect_intersect(&out[i], &out[i], &all);
+    return n;
+}
+
+#endif // FBGRID_H
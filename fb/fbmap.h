@@ -0,0 +1,137 @@
+/*
+ * fbmap.h
+ *
+ * Memory for drawing - the framebuffer mapping and off-screen surfaces
+ * set up so that the first frame does not stall on page faults and the
+ * SIMD paths get aligned rows.
+ *
+ * map_fb maps the framebuffer with MAP_POPULATE: the page tables are
+ * filled in by mmap instead of one fault per page while drawing the
+ * first frame (most drivers do this anyway, but the ones with deferred
+ * I/O or a shadow buffer - USB displays, DRM fbdev emulation - fault
+ * page by page without it).
+ *
+ * map_surface allocates an off-screen surface with rows padded to a
+ * multiple of 64 bytes (the data starts on a 64 byte boundary, so every
+ * row does) and touches all of it before returning. Surfaces of
+ * MAP_HUGEPAGE_SIZE or more are mmapped on a 2 MB boundary and marked
+ * for transparent hugepages - a full HD 32 bit surface is then four
+ * TLB entries instead of two thousand (when THP is enabled, 'madvise'
+ * or 'always' in /sys/kernel/mm/transparent_hugepage/enabled; without
+ * it they are plain pages). The contents start zeroed.
+ *
+ * map_faults reads the page fault counts of the process (getrusage) to
+ * see what a piece of code cost in faults.
+ *
+ * Usage:
+ *   fbp = map_fb(fbfd, finfo.smem_len);  (MAP_FAILED if it fails)
+ *   map_surface(&img, 1920, 1080, PIX_FMT_XRGB8888);
+ *   map_faults(&minor, &major);
+ *   map_surface_free(&img);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBMAP_H
+#define FBMAP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "fbsurf.h"
+
+// row alignment
+#define MAP_ALIGN 64
+// surfaces this big (or bigger) go to transparent hugepages
+#define MAP_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+// map 'size' bytes of the framebuffer, prefaulted - returns the mapping
+// or MAP_FAILED
+char *map_fb(int fbfd, long size) {
+    return (char *)mmap(0, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fbfd, 0);
+}
+
+// helper function for the size of a surface's memory block
+static inline size_t map_surface_size(const SURFACE_T *s) {
+    size_t size = (size_t)s->line_length * s->height;
+    if (size >= MAP_HUGEPAGE_SIZE)
+        size = (size + MAP_HUGEPAGE_SIZE - 1) & ~(size_t)(MAP_HUGEPAGE_SIZE - 1);
+    return size;
+}
+
+// allocate a w x h surface in format fmt (rows 64 byte aligned, zeroed,
+// prefaulted) - returns 0, EINVAL or ENOMEM
+int map_surface(SURFACE_T *s, int w, int h, PIX_FMT_T fmt) {
+    size_t size;
+    void *p = 0;
+    memset(s, 0, sizeof(*s));
+    if ((w <= 0) || (h <= 0))
+        return EINVAL;
+    s->width = w;
+    s->height = h;
+    s->fmt = fmt;
+    s->line_length = (w * pix_fmt_bytes(fmt) + MAP_ALIGN - 1) / MAP_ALIGN * MAP_ALIGN;
+    size = map_surface_size(s);
+    if (size >= MAP_HUGEPAGE_SIZE) {
+        // map a hugepage more and trim both ends to a 2 MB boundary
+        char *m = mmap(0, size + MAP_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED)
+            return ENOMEM;
+        char *a = (char *)(((uintptr_t)m + MAP_HUGEPAGE_SIZE - 1)
+                           & ~(uintptr_t)(MAP_HUGEPAGE_SIZE - 1));
+        if (a > m)
+            munmap(m, a - m);
+        munmap(a + size, m + MAP_HUGEPAGE_SIZE - a);
+#ifdef MADV_HUGEPAGE
+        madvise(a, size, MADV_HUGEPAGE);
+#endif
+        p = a;
+    }
+    else if (posix_memalign(&p, MAP_ALIGN, size) != 0) {
+        return ENOMEM;
+    }
+    // fault it all in now (anonymous pages are zero already, but each
+    // one costs a fault on first write)
+    memset(p, 0, size);
+    s->data = p;
+    return 0;
+}
+
+// free a surface from map_surface
+void map_surface_free(SURFACE_T *s) {
+    size_t size = map_surface_size(s);
+    if (s->data == 0)
+        return;
+    if (size >= MAP_HUGEPAGE_SIZE)
+        munmap(s->data, size);
+    else
+        free(s->data);
+    s->data = 0;
+}
+
+// page faults of the process so far (minor: no I/O, major: had to read)
+void map_faults(long *minor, long *major) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        *minor = *major = 0;
+        return;
+    }
+    *minor = ru.ru_minflt;
+    *major = ru.ru_majflt;
+}
+
+#endif // FBMAP_H
@@ -0,0 +1,316 @@
+/*
+ * fbmbox.h
+ *
+ * Batched mailbox property requests - instead of one ioctl per tag (as
+ * set_fb_voffs in fbtestXII.c/fbtestXIII.c does) the tags are queued into
+ * a single property buffer and submitted with one IOCTL_MBOX_PROPERTY.
+ * After the submit the responses can be read per tag.
+ *
+ * For testing off the Pi there is a stand-in 'device' that answers the
+ * tags used here the way the firmware does (mbox_open_stub).
+ *
+ * Usage:
+ *   MBOX_T mb;
+ *   MBOX_REQ_T req;
+ *   mbox_open(&mb);                       // or mbox_open_stub(&mb)
+ *   mbox_req_init(&req);
+ *   int h = mbox_req_set_virtual_offset(&req, 0, page * yres);
+ *   mbox_req_wait_vsync(&req);
+ *   if (mbox_submit(&mb, &req) == 0) mbox_resp_virtual_offset(&req, h, &x, &y);
+ *
+ * See https://github.com/raspberrypi/firmware/wiki/Mailbox-property-interface
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBMBOX_H
+#define FBMBOX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+// same as in vcio.h (hello_fft) - so that vcio.h is not needed
+#ifndef IOCTL_MBOX_PROPERTY
+#define MAJOR_NUM 100
+#define IOCTL_MBOX_PROPERTY _IOWR(MAJOR_NUM, 0, char *)
+#define DEVICE_FILE_NAME "char_dev"
+#endif
+
+// the tags used here
+#define MBOX_TAG_BLANK_SCREEN       0x00040002
+#define MBOX_TAG_GET_PHYSICAL_SIZE  0x00040003
+#define MBOX_TAG_GET_VIRTUAL_OFFSET 0x00040009
+#define MBOX_TAG_SET_VIRTUAL_OFFSET 0x00048009
+#define MBOX_TAG_SET_PALETTE        0x0004800B
+#define MBOX_TAG_SET_VSYNC          0x0004800E // waits for the next vsync
+
+#define MBOX_PROCESS_REQUEST 0x00000000
+#define MBOX_RESPONSE_OK     0x80000000
+#define MBOX_RESPONSE_ERROR  0x80000001
+#define MBOX_TAG_RESPONSE    0x80000000 // set in the tag's length word
+
+// buffer size in 32 bit words (a full palette is 258 words + header)
+#define MBOX_MAX_WORDS 300
+#define MBOX_MAX_TAGS 16
+
+typedef struct {
+    uint32_t p[MBOX_MAX_WORDS] __attribute__((aligned(16)));
+    int len;                     // words used, without the end tag
+    int num_tags;
+    int tag_pos[MBOX_MAX_TAGS];  // where each tag header starts
+} MBOX_REQ_T;
+
+typedef struct MBOX_S MBOX_T;
+struct MBOX_S {
+    int fd;
+    // does the property call - the ioctl or the stand-in
+    int (*property)(MBOX_T *mb, uint32_t *buf);
+    int submits;                 // number of round trips so far
+};
+
+// start a new (empty) request
+void mbox_req_init(MBOX_REQ_T *req) {
+    req->len = 2; // size + request code
+    req->num_tags = 0;
+}
+
+// queue a tag - 'vals' are the request values (may be 0), 'buf_words' the
+// size of the value buffer (has to fit the response too) - returns the
+// handle for reading the response, or -1 if the buffer is full
+int mbox_req_add(MBOX_REQ_T *req, uint32_t tag, const uint32_t *vals,
+                 int req_words, int buf_words) {
+    if (buf_words < req_words)
+        buf_words = req_words;
+    if ((req->num_tags == MBOX_MAX_TAGS)
+        || (req->len + 3 + buf_words + 1 > MBOX_MAX_WORDS))
+        return -1;
+    int i = req->len;
+    req->tag_pos[req->num_tags] = i;
+    req->p[i++] = tag;
+    req->p[i++] = buf_words * 4; // value buffer size
+    req->p[i++] = req_words * 4; // request size
+    if (vals != 0)
+        memcpy(&req->p[i], vals, req_words * 4);
+    else
+        memset(&req->p[i], 0, req_words * 4);
+    // clear the rest of the value buffer
+    memset(&req->p[i + req_words], 0, (buf_words - req_words) * 4);
+    req->len = i + buf_words;
+    return req->num_tags++;
+}
+
+// typed helpers for the common tags
+int mbox_req_set_virtual_offset(MBOX_REQ_T *req, unsigned x, unsigned y) {
+    uint32_t v[2] = { x, y };
+    return mbox_req_add(req, MBOX_TAG_SET_VIRTUAL_OFFSET, v, 2, 2);
+}
+
+int mbox_req_get_virtual_offset(MBOX_REQ_T *req) {
+    return mbox_req_add(req, MBOX_TAG_GET_VIRTUAL_OFFSET, 0, 0, 2);
+}
+
+int mbox_req_get_physical_size(MBOX_REQ_T *req) {
+    return mbox_req_add(req, MBOX_TAG_GET_PHYSICAL_SIZE, 0, 0, 2);
+}
+
+int mbox_req_blank(MBOX_REQ_T *req, int on) {
+    uint32_t v = on ? 1 : 0;
+    return mbox_req_add(req, MBOX_TAG_BLANK_SCREEN, &v, 1, 1);
+}
+
+int mbox_req_wait_vsync(MBOX_REQ_T *req) {
+    uint32_t v = 0;
+    return mbox_req_add(req, MBOX_TAG_SET_VSYNC, &v, 1, 1);
+}
+
+// set 'n' palette entries starting from 'first' - colors are 0xRRGGBB
+// as in fbsurf.h PALETTE_T (the firmware wants red in the lowest byte)
+int mbox_req_set_palette(MBOX_REQ_T *req, int first, int n, const uint32_t *rgb) {
+    uint32_t v[2 + 256];
+    int i;
+    if ((first < 0) || (n < 1) || (first + n > 256))
+        return -1;
+    v[0] = first;
+    v[1] = n;
+    for (i = 0; i < n; i++) {
+        uint32_t c = rgb[i];
+        v[2 + i] = ((c >> 16) & 0xFF) | (c & 0xFF00) | ((c & 0xFF) << 16);
+    }
+    return mbox_req_add(req, MBOX_TAG_SET_PALETTE, v, 2 + n, 2 + n);
+}
+
+// submit the whole request with one property call - returns 0 if the
+// firmware processed it, EIO/EINVAL otherwise
+int mbox_submit(MBOX_T *mb, MBOX_REQ_T *req) {
+    req->p[req->len] = 0; // end tag
+    req->p[0] = (req->len + 1) * 4; // total size
+    req->p[1] = MBOX_PROCESS_REQUEST;
+    mb->submits++;
+    if (mb->property(mb, req->p) < 0)
+        return EIO;
+    return (req->p[1] == MBOX_RESPONSE_OK) ? 0 : EINVAL;
+}
+
+// helper function to get the response values of a tag - returns the
+// number of response words, or -1 if the tag was not answered
+static int mbox_resp(const MBOX_REQ_T *req, int h, const uint32_t **vals) {
+    if ((h < 0) || (h >= req->num_tags))
+        return -1;
+    const uint32_t *t = &req->p[req->tag_pos[h]];
+    if (!(t[2] & MBOX_TAG_RESPONSE))
+        return -1;
+    *vals = &t[3];
+    // a response may be longer than the buffer - only the buffer is there
+    int words = (t[2] & ~MBOX_TAG_RESPONSE) / 4;
+    return (words < (int)t[1] / 4) ? words : (int)t[1] / 4;
+}
+
+// read value 'i' of a tag response (0 if not there)
+uint32_t mbox_resp_u32(const MBOX_REQ_T *req, int h, int i) {
+    const uint32_t *v = 0;
+    int n = mbox_resp(req, h, &v);
+    return ((n > i) && (i >= 0)) ? v[i] : 0;
+}
+
+// read a two value response (virtual offset, physical size) - returns
+// 0 or EINVAL if the tag was not answered
+int mbox_resp_virtual_offset(const MBOX_REQ_T *req, int h, unsigned *x, unsigned *y) {
+    const uint32_t *v = 0;
+    if (mbox_resp(req, h, &v) < 2)
+        return EINVAL;
+    *x = v[0];
+    *y = v[1];
+    return 0;
+}
+
+int mbox_resp_physical_size(const MBOX_REQ_T *req, int h, unsigned *w, unsigned *hgt) {
+    return mbox_resp_virtual_offset(req, h, w, hgt);
+}
+
+// the palette response is 0 for valid, 1 for invalid - returns 0 if ok
+int mbox_resp_palette(const MBOX_REQ_T *req, int h) {
+    const uint32_t *v = 0;
+    if (mbox_resp(req, h, &v) < 1)
+        return EINVAL;
+    return (v[0] == 0) ? 0 : EINVAL;
+}
+
+// helper function to do the real ioctl (as mbox_property in fbtestXII.c)
+static int mbox_ioctl_property(MBOX_T *mb, uint32_t *buf) {
+    int ret_val = ioctl(mb->fd, IOCTL_MBOX_PROPERTY, buf);
+    if (ret_val < 0) {
+        printf("ioctl_set_msg failed:%d\n", ret_val);
+    }
+    return ret_val;
+}
+
+// open the char device file used for communicating with the kernel
+// mbox driver - returns 0 or the errno
+int mbox_open(MBOX_T *mb) {
+    mb->property = mbox_ioctl_property;
+    mb->submits = 0;
+    mb->fd = open(DEVICE_FILE_NAME, 0);
+    if (mb->fd < 0) {
+        printf("Can't open device file: %s\n", DEVICE_FILE_NAME);
+        printf("Try creating a device file with: mknod %s c %d 0\n", DEVICE_FILE_NAME, MAJOR_NUM);
+        return errno;
+    }
+    return 0;
+}
+
+void mbox_close(MBOX_T *mb) {
+    if (mb->fd >= 0)
+        close(mb->fd);
+    mb->fd = -1;
+}
+
+// the stand-in 'device' state
+struct {
+    unsigned phys_w, phys_h;
+    unsigned virt_w, virt_h;
+    unsigned xoffset, yoffset;
+    int blank;
+    int vsyncs;
+    uint32_t palette[256];
+} mbox_stub_state = { 1920, 1080, 1920, 2160, 0, 0, 0, 0, { 0 } };
+
+// helper function to answer the tags like the firmware would
+static int mbox_stub_property(MBOX_T *mb, uint32_t *buf) {
+    int i = 2;
+    int words = buf[0] / 4;
+    (void)mb;
+    buf[1] = MBOX_RESPONSE_OK;
+    while ((i < words) && (buf[i] != 0)) {
+        uint32_t tag = buf[i];
+        uint32_t size = buf[i + 1];
+        uint32_t *v = &buf[i + 3];
+        uint32_t resp = 0;
+        switch (tag) {
+        case MBOX_TAG_SET_VIRTUAL_OFFSET:
+            // the firmware keeps the window inside the virtual buffer
+            if (v[0] + mbox_stub_state.phys_w <= mbox_stub_state.virt_w)
+                mbox_stub_state.xoffset = v[0];
+            if (v[1] + mbox_stub_state.phys_h <= mbox_stub_state.virt_h)
+                mbox_stub_state.yoffset = v[1];
+            // fall through
+        case MBOX_TAG_GET_VIRTUAL_OFFSET:
+            v[0] = mbox_stub_state.xoffset;
+            v[1] = mbox_stub_state.yoffset;
+            resp = 8;
+            break;
+        case MBOX_TAG_GET_PHYSICAL_SIZE:
+            v[0] = mbox_stub_state.phys_w;
+            v[1] = mbox_stub_state.phys_h;
+            resp = 8;
+            break;
+        case MBOX_TAG_BLANK_SCREEN:
+            mbox_stub_state.blank = v[0] & 1;
+            resp = 4;
+            break;
+        case MBOX_TAG_SET_VSYNC:
+            mbox_stub_state.vsyncs++;
+            resp = 4;
+            break;
+        case MBOX_TAG_SET_PALETTE:
+            if ((v[0] + v[1] <= 256) && (v[1] >= 1)) {
+                memcpy(&mbox_stub_state.palette[v[0]], &v[2], v[1] * 4);
+                v[0] = 0;
+            }
+            else {
+                v[0] = 1;
+            }
+            resp = 4;
+            break;
+        default:
+            // unknown tags are skipped without a response
+            resp = 0;
+            break;
+        }
+        if (resp > 0)
+            buf[i + 2] = MBOX_TAG_RESPONSE | resp;
+        i += 3 + size / 4;
+    }
+    return 0;
+}
+
+// use the stand-in instead of the real mailbox
+void mbox_open_stub(MBOX_T *mb) {
+    mb->fd = -1;
+    mb->property = mbox_stub_property;
+    mb->submits = 0;
+}
+
+#endif
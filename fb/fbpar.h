@@ -0,0 +1,197 @@
+/*
+ * fbpar.h
+ *
+ * Parallel for over the rows of a surface - a full screen kernel split
+ * into one band of rows per core. The worker threads are started once
+ * (par_init) and pinned to a core each, so a call costs a wake up, not
+ * a thread creation. The calling thread works the first band and is
+ * left unpinned (threads it starts later inherit its affinity). Band
+ * boundaries fall on rows whose start is on a cache line boundary (64
+ * bytes, for a line aligned surface), so no two cores write to the same
+ * cache line.
+ *
+ * The kernel gets its rows as [y0, y1) and must not depend on the rows
+ * of other bands being done, or not done - read from one surface and
+ * write to another if a row needs its neighbours.
+ *
+ * Without par_init, or after par_init(1), everything runs on the calling
+ * thread as before (serial).
+ *
+ * Needs pthreads - build with -lpthread
+ *
+ * Usage:
+ *   void kernel(void *arg, int y0, int y1) { ... rows y0 .. y1 - 1 ... }
+ *   par_init(0);
+ *   par_for(screen.height, screen.line_length, kernel, &args);
+ *   par_exit();
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBPAR_H
+#define FBPAR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#define PAR_MAX_THREADS 8
+#define PAR_CACHE_LINE 64
+
+typedef void (*PAR_FUNC_T)(void *arg, int y0, int y1);
+
+typedef struct {
+    int threads;            // including the calling one (1: serial)
+    pthread_t tid[PAR_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned gen;           // job number
+    int pending;            // threads still working on the job
+    int quit;
+    PAR_FUNC_T fn;          // the job
+    void *arg;
+    int band[PAR_MAX_THREADS + 1]; // rows of thread i: band[i] .. band[i + 1]
+} PAR_POOL_T;
+
+static PAR_POOL_T par_pool = { .threads = 1 };
+
+// helper function to pin the calling thread to a core (the raw system
+// call - pthread_setaffinity_np would need _GNU_SOURCE)
+static void par_pin(int cpu) {
+    unsigned long mask[4];
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+        cpu %= cpus;
+    memset(mask, 0, sizeof(mask));
+    mask[(cpu / (8 * sizeof(long))) % 4] = 1UL << (cpu % (8 * sizeof(long)));
+    syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+}
+
+// a worker thread
+static void *par_thread(void *arg) {
+    int i = (int)(intptr_t)arg;
+    unsigned gen = 0;
+    par_pin(i);
+    for (;;) {
+        pthread_mutex_lock(&par_pool.lock);
+        while ((par_pool.gen == gen) && !par_pool.quit)
+            pthread_cond_wait(&par_pool.start, &par_pool.lock);
+        if (par_pool.quit) {
+            pthread_mutex_unlock(&par_pool.lock);
+            break;
+        }
+        gen = par_pool.gen;
+        pthread_mutex_unlock(&par_pool.lock);
+
+        if (par_pool.band[i] < par_pool.band[i + 1])
+            par_pool.fn(par_pool.arg, par_pool.band[i], par_pool.band[i + 1]);
+
+        pthread_mutex_lock(&par_pool.lock);
+        if (--par_pool.pending == 0)
+            pthread_cond_signal(&par_pool.done);
+        pthread_mutex_unlock(&par_pool.lock);
+    }
+    return 0;
+}
+
+// start the pool - 'threads' 0 for one per core, 1 for serial; the
+// calling thread works as one of them (on any core, the workers take
+// cores 1 .. threads - 1) - returns 0 or errno
+int par_init(int threads) {
+    int i;
+    if (par_pool.threads > 1)
+        return EBUSY;
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > PAR_MAX_THREADS)
+        threads = PAR_MAX_THREADS;
+    memset(&par_pool, 0, sizeof(par_pool));
+    par_pool.threads = 1;
+    if (threads <= 1)
+        return 0;
+    pthread_mutex_init(&par_pool.lock, 0);
+    pthread_cond_init(&par_pool.start, 0);
+    pthread_cond_init(&par_pool.done, 0);
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&par_pool.tid[i], 0, par_thread, (void *)(intptr_t)i) != 0)
+            break;
+        par_pool.threads++;
+    }
+    return (par_pool.threads == threads) ? 0 : EAGAIN;
+}
+
+// stop the threads (back to serial)
+void par_exit(void) {
+    int i;
+    if (par_pool.threads <= 1)
+        return;
+    pthread_mutex_lock(&par_pool.lock);
+    par_pool.quit = 1;
+    pthread_cond_broadcast(&par_pool.start);
+    pthread_mutex_unlock(&par_pool.lock);
+    for (i = 1; i < par_pool.threads; i++)
+        pthread_join(par_pool.tid[i], 0);
+    pthread_mutex_destroy(&par_pool.lock);
+    pthread_cond_destroy(&par_pool.start);
+    pthread_cond_destroy(&par_pool.done);
+    par_pool.threads = 1;
+}
+
+// threads in use (1 if serial)
+int par_threads(void) {
+    return par_pool.threads;
+}
+
+// run fn(arg, y0, y1) over rows 0 .. rows - 1 split into bands - rows
+// 'line_length' bytes apart (0 if not a surface, any split goes); only
+// from the thread that called par_init, returns when all rows are done
+void par_for(int rows, int line_length, PAR_FUNC_T fn, void *arg) {
+    int i, step, per;
+    if (rows <= 0)
+        return;
+    // rows a band may start at: multiples of 'step' start on a line
+    step = 1;
+    if (line_length > 0) {
+        while ((step * line_length) % PAR_CACHE_LINE != 0)
+            step++;
+    }
+    if ((par_pool.threads <= 1) || (rows < 2 * step)) {
+        fn(arg, 0, rows);
+        return;
+    }
+    per = (rows + par_pool.threads - 1) / par_pool.threads;
+    per = (per + step - 1) / step * step;
+    for (i = 0; i <= par_pool.threads; i++)
+        par_pool.band[i] = (i * per < rows) ? i * per : rows;
+
+    pthread_mutex_lock(&par_pool.lock);
+    par_pool.fn = fn;
+    par_pool.arg = arg;
+    par_pool.pending = par_pool.threads - 1;
+    par_pool.gen++;
+    pthread_cond_broadcast(&par_pool.start);
+    pthread_mutex_unlock(&par_pool.lock);
+
+    // this thread does the first band
+    if (par_pool.band[0] < par_pool.band[1])
+        fn(arg, par_pool.band[0], par_pool.band[1]);
+
+    pthread_mutex_lock(&par_pool.lock);
+    while (par_pool.pending > 0)
+        pthread_cond_wait(&par_pool.done, &par_pool.lock);
+    pthread_mutex_unlock(&par_pool.lock);
+}
+
+#endif // FBPAR_H
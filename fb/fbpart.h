@@ -0,0 +1,285 @@
+/*
+ * fbpart.h
+ *
+ * Particles - any number of moving points or small sprites bouncing
+ * inside a rectangle (the bouncing elements of fbtestXIII.c grown to
+ * hundreds of thousands).
+ *
+ * The particles are stored as a structure of arrays - all x positions
+ * one after the other, all y positions, all velocities... - so that the
+ * update moves four particles at a time in SSE2 / NEON registers and
+ * the draw only reads the positions and colors it needs.
+ *
+ * Updating and drawing are separate and both work on a part: update on
+ * a range of particles and draw on a band of screen rows (each band
+ * draws the particles that reach into it, clipped to it), so either one
+ * can be split over the cores with par_for (fbpar.h) without two cores
+ * ever writing the same particle or pixel.
+ *
+ * Usage:
+ *   PART_T ps;
+ *   part_init(&ps, 100000);
+ *   part_add(&ps, x, y, dx, dy, color); ...
+ *   each frame:
+ *     part_update(&ps, 0, ps.num, &bounds);
+ *     part_draw(&screen, &ps, 2, 0, screen.height);
+ *   part_free(&ps);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBPART_H
+#define FBPART_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "fbsurf.h"
+#include "fbsprite.h"
+
+// arrays are allocated in multiples of this (and aligned to it)
+#define PART_ALIGN 16
+
+typedef struct {
+    int num;            // particles
+    int cap;            // room for
+    float *x;           // position (upper left corner of the particle)
+    float *y;
+    float *dx;          // velocity - pixels per update
+    float *dy;
+    uint32_t *color;    // raw color in the surface format
+} PART_T;
+
+// helper function for an aligned array (n rounded up to PART_ALIGN)
+static void *part_alloc(int n, int size) {
+    void *p = 0;
+    n = (n + PART_ALIGN - 1) / PART_ALIGN * PART_ALIGN;
+    if (posix_memalign(&p, 64, (size_t)n * size) != 0)
+        return 0;
+    return p;
+}
+
+void part_free(PART_T *ps) {
+    free(ps->x);
+    free(ps->y);
+    free(ps->dx);
+    free(ps->dy);
+    free(ps->color);
+    memset(ps, 0, sizeof(*ps));
+}
+
+// make room for 'cap' particles (keeping the ones there are) - returns
+// 0 or ENOMEM
+int part_reserve(PART_T *ps, int cap) {
+    PART_T n;
+    if (cap <= ps->cap)
+        return 0;
+    n.x = part_alloc(cap, sizeof(float));
+    n.y = part_alloc(cap, sizeof(float));
+    n.dx = part_alloc(cap, sizeof(float));
+    n.dy = part_alloc(cap, sizeof(float));
+    n.color = part_alloc(cap, sizeof(uint32_t));
+    n.num = ps->num;
+    n.cap = cap;
+    if ((n.x == 0) || (n.y == 0) || (n.dx == 0) || (n.dy == 0) || (n.color == 0)) {
+        part_free(&n);
+        return ENOMEM;
+    }
+    if (ps->num > 0) {
+        memcpy(n.x, ps->x, ps->num * sizeof(float));
+        memcpy(n.y, ps->y, ps->num * sizeof(float));
+        memcpy(n.dx, ps->dx, ps->num * sizeof(float));
+        memcpy(n.dy, ps->dy, ps->num * sizeof(float));
+        memcpy(n.color, ps->color, ps->num * sizeof(uint32_t));
+    }
+    part_free(ps);
+    *ps = n;
+    return 0;
+}
+
+// set up room for 'cap' particles (more are added as needed) - returns 0
+// or ENOMEM
+int part_init(PART_T *ps, int cap) {
+    memset(ps, 0, sizeof(*ps));
+    return part_reserve(ps, (cap > 0) ? cap : PART_ALIGN);
+}
+
+// add a particle - returns its index or -1 if out of memory
+int part_add(PART_T *ps, float x, float y, float dx, float dy, uint32_t color) {
+    int i = ps->num;
+    if ((i == ps->cap) && (part_reserve(ps, ps->cap * 2) != 0))
+        return -1;
+    ps->x[i] = x;
+    ps->y[i] = y;
+    ps->dx[i] = dx;
+    ps->dy[i] = dy;
+    ps->color[i] = color;
+    ps->num++;
+    return i;
+}
+
+// remove a particle - the last one takes its index
+void part_remove(PART_T *ps, int i) {
+    int l = --ps->num;
+    ps->x[i] = ps->x[l];
+    ps->y[i] = ps->y[l];
+    ps->dx[i] = ps->dx[l];
+    ps->dy[i] = ps->dy[l];
+    ps->color[i] = ps->color[l];
+}
+
+// helper function to move n positions and bounce them off lo and hi
+static void part_move(float *p, float *d, int n, float lo, float hi) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+    __m128 lo2 = _mm_set1_ps(2 * lo);
+    __m128 hi2 = _mm_set1_ps(2 * hi);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(d + i);
+        __m128 x = _mm_add_ps(_mm_loadu_ps(p + i), v);
+        __m128 under = _mm_cmplt_ps(x, vlo);
+        __m128 over = _mm_cmpgt_ps(x, vhi);
+        __m128 out = _mm_or_ps(under, over);
+        // mirror at the wall that was crossed, turn the velocity around
+        __m128 m = _mm_or_ps(_mm_and_ps(under, _mm_sub_ps(lo2, x)),
+                             _mm_and_ps(over, _mm_sub_ps(hi2, x)));
+        x = _mm_or_ps(_mm_andnot_ps(out, x), m);
+        x = _mm_min_ps(_mm_max_ps(x, vlo), vhi);
+        _mm_storeu_ps(p + i, x);
+        _mm_storeu_ps(d + i, _mm_xor_ps(v, _mm_and_ps(out, sign)));
+    }
+#elif defined(__ARM_NEON)
+    float32x4_t vlo = vdupq_n_f32(lo);
+    float32x4_t vhi = vdupq_n_f32(hi);
+    float32x4_t lo2 = vdupq_n_f32(2 * lo);
+    float32x4_t hi2 = vdupq_n_f32(2 * hi);
+    uint32x4_t sign = vdupq_n_u32(0x80000000);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vld1q_f32(d + i);
+        float32x4_t x = vaddq_f32(vld1q_f32(p + i), v);
+        uint32x4_t under = vcltq_f32(x, vlo);
+        uint32x4_t over = vcgtq_f32(x, vhi);
+        uint32x4_t out = vorrq_u32(under, over);
+        // mirror at the wall that was crossed, turn the velocity around
+        x = vbslq_f32(under, vsubq_f32(lo2, x), x);
+        x = vbslq_f32(over, vsubq_f32(hi2, x), x);
+        x = vminq_f32(vmaxq_f32(x, vlo), vhi);
+        vst1q_f32(p + i, x);
+        vst1q_f32(d + i, vreinterpretq_f32_u32(
+                  veorq_u32(vreinterpretq_u32_f32(v), vandq_u32(out, sign))));
+    }
+#endif
+    for (; i < n; i++) {
+        float x = p[i] + d[i];
+        if ((x < lo) || (x > hi)) {
+            x = (x < lo) ? 2 * lo - x : 2 * hi - x;
+            d[i] = -d[i];
+        }
+        p[i] = (x < lo) ? lo : (x > hi) ? hi : x;
+    }
+}
+
+// move particles first .. last - 1 one step and bounce them off the
+// sides of 'bounds' (the area the particles' corners stay in: the
+// screen less the particle size)
+void part_update(PART_T *ps, int first, int last, const RECT_T *bounds) {
+    if (last > ps->num)
+        last = ps->num;
+    if (first >= last)
+        return;
+    part_move(ps->x + first, ps->dx + first, last - first,
+              bounds->x, bounds->x + bounds->w - 1);
+    part_move(ps->y + first, ps->dy + first, last - first,
+              bounds->y, bounds->y + bounds->h - 1);
+}
+
+// draw the particles as size x size squares, only their rows y0 .. y1 - 1
+// (clipped to the surface) - one span per row of a square
+void part_draw(SURFACE_T *dst, const PART_T *ps, int size, int y0, int y1) {
+    int i, py, px, r0, r1, c0, c1;
+    if (y0 < 0)
+        y0 = 0;
+    if (y1 > dst->height)
+        y1 = dst->height;
+    if (size == 1) {
+        // points: straight stores, the format picked once
+        int bpp = pix_fmt_bytes(dst->fmt);
+        for (i = 0; i < ps->num; i++) {
+            py = (int)ps->y[i];
+            px = (int)ps->x[i];
+            if ((py < y0) || (py >= y1) || (px < 0) || (px >= dst->width))
+                continue;
+            char *p = dst->data + py * dst->line_length + px * bpp;
+            if (bpp == 2)
+                *((uint16_t *)p) = ps->color[i];
+            else if (bpp == 4)
+                *((uint32_t *)p) = ps->color[i];
+            else if (bpp == 1)
+                *p = ps->color[i];
+            else
+                surface_put_pixel(dst, px, py, ps->color[i]);
+        }
+        return;
+    }
+    for (i = 0; i < ps->num; i++) {
+        py = (int)ps->y[i];
+        if ((py + size <= y0) || (py >= y1))
+            continue;
+        px = (int)ps->x[i];
+        c0 = (px < 0) ? 0 : px;
+        c1 = (px + size > dst->width) ? dst->width : px + size;
+        if (c0 >= c1)
+            continue;
+        r0 = (py < y0) ? y0 : py;
+        r1 = (py + size > y1) ? y1 : py + size;
+        for (; r0 < r1; r0++)
+            surface_fill_span(dst, c0, r0, c1 - c0, ps->color[i]);
+    }
+}
+
+// draw the particles as the sprite (colors not used), only their rows
+// y0 .. y1 - 1
+void part_draw_sprite(SURFACE_T *dst, const PART_T *ps, const SPRITE_T *spr,
+                      int y0, int y1) {
+    RECT_T band;
+    SURFACE_T s;
+    int i, py;
+    if (y0 < 0)
+        y0 = 0;
+    if (y1 > dst->height)
+        y1 = dst->height;
+    if (y0 >= y1)
+        return;
+    band.x = 0;
+    band.y = y0;
+    band.w = dst->width;
+    band.h = y1 - y0;
+    // sprite_draw clips to the band
+    surface_sub(&s, dst, &band);
+    for (i = 0; i < ps->num; i++) {
+        py = (int)ps->y[i];
+        if ((py + spr->height > y0) && (py < y1))
+            sprite_draw(&s, (int)ps->x[i], py - y0, spr);
+    }
+}
+
+#endif // FBPART_H
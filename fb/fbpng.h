@@ -0,0 +1,385 @@
+/*
+ * fbpng.h
+ *
+ * Streaming PNG decoder - inflates (zlib) and unfilters one row at a
+ * time and converts the row straight into the wanted pixel format, so
+ * an image can be decoded into an RGB565 / 8 bit surface (or directly
+ * to the screen) without ever having the whole image in 24/32 bits in
+ * memory: all it keeps is two rows and the zlib window.
+ *
+ * Handles the non-interlaced images of any PNG color type and bit depth
+ * - 16 bit components are cut to 8 bits and the alpha channel is dropped.
+ * Palette images decoded to PIX_FMT_PAL8 without a palette keep their
+ * own indexes (png.pal is the palette to go with them).
+ *
+ * Needs zlib (sudo apt-get install zlib1g-dev) - build with -lz
+ *
+ * Usage:
+ *   PNG_T png;
+ *   png_open(&png, fp);
+ *   for (y = 0; y < png.height; y++)
+ *       png_read_row(&png, row, PIX_FMT_RGB565, 0);
+ *   png_close(&png);
+ * or just:
+ *   png_load(&screen, 0, 0, fp);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBPNG_H
+#define FBPNG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include "fbsurf.h"
+#include "fbconv.h"
+
+// compressed bytes read from the file at a time
+#define PNG_IN_SIZE 8192
+
+// color types
+#define PNG_GRAY       0
+#define PNG_RGB        2
+#define PNG_PALETTE    3
+#define PNG_GRAY_ALPHA 4
+#define PNG_RGBA       6
+
+typedef struct {
+    FILE *fp;
+    z_stream zs;
+    int width;
+    int height;
+    int depth;        // bits per component (1, 2, 4, 8 or 16)
+    int color_type;
+    int channels;     // components per pixel
+    int bpp;          // bytes per complete pixel for the filters (at least 1)
+    int row_bytes;    // bytes per row, without the filter type byte
+    int y;            // next row to read
+    uint8_t *cur;     // filter type byte + the row being decoded
+    uint8_t *prev;    // the previous row unfiltered (with its type byte)
+    uint32_t idat_left; // bytes left in the current IDAT chunk
+    int idat_end;     // no more IDAT chunks
+    PALETTE_T pal;    // PNG_PALETTE images
+    uint8_t in[PNG_IN_SIZE];
+} PNG_T;
+
+// helper function to read a big endian 32 bit value
+static inline uint32_t png_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// helper function to skip 'n' bytes of the file
+static int png_skip(FILE *fp, uint32_t n) {
+    uint8_t buf[256];
+    while (n > 0) {
+        uint32_t k = (n > sizeof(buf)) ? sizeof(buf) : n;
+        if (fread(buf, 1, k, fp) != k)
+            return EIO;
+        n -= k;
+    }
+    return 0;
+}
+
+// read the header chunks up to the image data - returns 0, or EINVAL
+// for what is not a (supported) PNG, EIO / ENOMEM
+int png_open(PNG_T *png, FILE *fp) {
+    static const uint8_t sig[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    uint8_t h[13];
+    int i;
+
+    memset(png, 0, sizeof(*png));
+    png->fp = fp;
+    if ((fread(h, 1, 8, fp) != 8) || (memcmp(h, sig, 8) != 0))
+        return EINVAL;
+
+    // chunks until the first IDAT - IHDR has to be the first one
+    for (;;) {
+        uint32_t len;
+        if (fread(h, 1, 8, fp) != 8)
+            return EIO;
+        len = png_be32(h);
+        if (memcmp(h + 4, "IHDR", 4) == 0) {
+            if ((len != 13) || (fread(h, 1, 13, fp) != 13))
+                return EINVAL;
+            png->width = png_be32(h);
+            png->height = png_be32(h + 4);
+            png->depth = h[8];
+            png->color_type = h[9];
+            if ((h[10] != 0) || (h[11] != 0) || (h[12] != 0)) // interlaced
+                return EINVAL;
+            len = 0;
+        }
+        else if (png->width == 0) {
+            return EINVAL;
+        }
+        else if (memcmp(h + 4, "PLTE", 4) == 0) {
+            uint8_t rgb[3];
+            png->pal.num = (len / 3 > 256) ? 256 : len / 3;
+            for (i = 0; i < png->pal.num; i++) {
+                if (fread(rgb, 1, 3, fp) != 3)
+                    return EIO;
+                png->pal.rgb[i] = (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+            }
+            len -= png->pal.num * 3;
+        }
+        else if (memcmp(h + 4, "IDAT", 4) == 0) {
+            png->idat_left = len;
+            break;
+        }
+        else if (memcmp(h + 4, "IEND", 4) == 0) {
+            return EINVAL;
+        }
+        // the rest of the chunk and its CRC (zlib checks the data itself)
+        if (png_skip(fp, len + 4) != 0)
+            return EIO;
+    }
+
+    switch (png->color_type) {
+    case PNG_GRAY:       png->channels = 1; break;
+    case PNG_RGB:        png->channels = 3; break;
+    case PNG_PALETTE:    png->channels = 1; break;
+    case PNG_GRAY_ALPHA: png->channels = 2; break;
+    case PNG_RGBA:       png->channels = 4; break;
+    default:             return EINVAL;
+    }
+    if ((png->width <= 0) || (png->height <= 0)
+        || ((png->depth != 1) && (png->depth != 2) && (png->depth != 4)
+            && (png->depth != 8) && (png->depth != 16))
+        || ((png->color_type == PNG_PALETTE) && ((png->depth > 8) || (png->pal.num == 0)))
+        || ((png->channels > 1) && (png->color_type != PNG_PALETTE) && (png->depth < 8)))
+        return EINVAL;
+    png->bpp = (png->channels * png->depth + 7) / 8;
+    png->row_bytes = (png->width * png->channels * png->depth + 7) / 8;
+
+    png->cur = calloc(1, png->row_bytes + 1);
+    png->prev = calloc(1, png->row_bytes + 1);
+    if ((png->cur == 0) || (png->prev == 0) || (inflateInit(&png->zs) != Z_OK)) {
+        free(png->cur);
+        free(png->prev);
+        png->cur = png->prev = 0;
+        return ENOMEM;
+    }
+    return 0;
+}
+
+// helper function to inflate the next filtered row into png->cur
+static int png_inflate_row(PNG_T *png) {
+    png->zs.next_out = png->cur;
+    png->zs.avail_out = png->row_bytes + 1;
+    while (png->zs.avail_out > 0) {
+        int ret;
+        if (png->zs.avail_in == 0) {
+            // next piece of IDAT data - the data may go on in another IDAT
+            while ((png->idat_left == 0) && !png->idat_end) {
+                uint8_t h[12];
+                if (fread(h, 1, 12, png->fp) != 12) // CRC + next header
+                    return EIO;
+                if (memcmp(h + 8, "IDAT", 4) == 0)
+                    png->idat_left = png_be32(h + 4);
+                else
+                    png->idat_end = 1;
+            }
+            if (png->idat_end)
+                return EINVAL; // image data ended too soon
+            uint32_t k = (png->idat_left > PNG_IN_SIZE) ? PNG_IN_SIZE : png->idat_left;
+            if (fread(png->in, 1, k, png->fp) != k)
+                return EIO;
+            png->idat_left -= k;
+            png->zs.next_in = png->in;
+            png->zs.avail_in = k;
+        }
+        ret = inflate(&png->zs, Z_NO_FLUSH);
+        if ((ret == Z_STREAM_END) && (png->zs.avail_out > 0))
+            return EINVAL;
+        if ((ret != Z_OK) && (ret != Z_STREAM_END))
+            return EINVAL;
+    }
+    return 0;
+}
+
+// helper function to undo the filter of png->cur (against png->prev)
+static int png_unfilter(PNG_T *png) {
+    uint8_t *c = png->cur + 1;
+    const uint8_t *p = png->prev + 1;
+    int n = png->row_bytes;
+    int bpp = png->bpp;
+    int i;
+    switch (png->cur[0]) {
+    case 0: // none
+        break;
+    case 1: // sub
+        for (i = bpp; i < n; i++)
+            c[i] += c[i - bpp];
+        break;
+    case 2: // up
+        for (i = 0; i < n; i++)
+            c[i] += p[i];
+        break;
+    case 3: // average
+        for (i = 0; i < bpp; i++)
+            c[i] += p[i] >> 1;
+        for (; i < n; i++)
+            c[i] += (c[i - bpp] + p[i]) >> 1;
+        break;
+    case 4: // paeth
+        for (i = 0; i < bpp; i++)
+            c[i] += p[i];
+        for (; i < n; i++) {
+            int a = c[i - bpp], b = p[i], cc = p[i - bpp];
+            int pa = abs(b - cc);
+            int pb = abs(a - cc);
+            int pc = abs(a + b - 2 * cc);
+            c[i] += ((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : cc;
+        }
+        break;
+    default:
+        return EINVAL;
+    }
+    return 0;
+}
+
+// helper function to convert 'n' pixels of the unfiltered row from pixel
+// 'x' on to XRGB8888
+static void png_to_xrgb(const PNG_T *png, uint32_t *out, int x, int n) {
+    const uint8_t *row = png->cur + 1;
+    int step = png->depth / 8;   // bytes per component (0 below 8 bits)
+    int i;
+    if (png->depth < 8) { // packed gray or palette indexes, high bits first
+        int per = 8 / png->depth;
+        int mask = (1 << png->depth) - 1;
+        for (i = 0; i < n; i++) {
+            int px = x + i;
+            int v = (row[px / per] >> ((per - 1 - px % per) * png->depth)) & mask;
+            if (png->color_type == PNG_PALETTE)
+                out[i] = png->pal.rgb[v];
+            else
+                out[i] = (v * 255 / mask) * 0x010101;
+        }
+        return;
+    }
+    row += x * png->channels * step;
+    for (i = 0; i < n; i++, row += png->channels * step) {
+        switch (png->color_type) {
+        case PNG_GRAY:
+        case PNG_GRAY_ALPHA:
+            out[i] = row[0] * 0x010101;
+            break;
+        case PNG_PALETTE:
+            out[i] = png->pal.rgb[row[0]];
+            break;
+        default: // RGB / RGBA - the high byte of 16 bit components
+            out[i] = (row[0] << 16) | (row[step] << 8) | row[2 * step];
+            break;
+        }
+    }
+}
+
+// decode the next row into 'out' in format 'fmt' (with palette 'pal' for
+// PIX_FMT_PAL8) - 'out' takes png->width pixels. Returns 0, or EINVAL
+// for corrupt data / no more rows, EIO
+int png_read_row(PNG_T *png, uint8_t *out, PIX_FMT_T fmt, const PALETTE_T *pal) {
+    uint32_t tmp[CONV_CHUNK];
+    uint8_t *t;
+    int ret, x;
+
+    if (png->y >= png->height)
+        return EINVAL;
+    ret = png_inflate_row(png);
+    if (ret == 0)
+        ret = png_unfilter(png);
+    if (ret != 0)
+        return ret;
+    png->y++;
+
+    // the common cases convert straight from the row
+    if ((png->depth == 8) && (png->color_type == PNG_RGB)) {
+        conv_row(out, fmt, pal, png->cur + 1, PIX_FMT_RGB888, 0, png->width);
+    }
+    else if ((png->depth == 8) && (png->color_type == PNG_PALETTE)) {
+        conv_row(out, fmt, pal ? pal : &png->pal, png->cur + 1, PIX_FMT_PAL8, &png->pal,
+                 png->width);
+    }
+    else {
+        for (x = 0; x < png->width; x += CONV_CHUNK) {
+            int n = (png->width - x > CONV_CHUNK) ? CONV_CHUNK : png->width - x;
+            png_to_xrgb(png, tmp, x, n);
+            if ((fmt == PIX_FMT_PAL8) && (pal == 0) && (png->color_type == PNG_PALETTE))
+                conv_from_xrgb(out + x, tmp, n, fmt, &png->pal);
+            else
+                conv_from_xrgb(out + x * pix_fmt_bytes(fmt), tmp, n, fmt, pal);
+        }
+    }
+
+    // this row is the 'previous' one for the next
+    t = png->prev;
+    png->prev = png->cur;
+    png->cur = t;
+    return 0;
+}
+
+// release what png_open allocated (does not close the file)
+void png_close(PNG_T *png) {
+    if (png->cur != 0)
+        inflateEnd(&png->zs);
+    free(png->cur);
+    free(png->prev);
+    png->cur = png->prev = 0;
+}
+
+// decode a whole PNG into 'dst' with its upper left corner at dx, dy -
+// clipped to 'dst' and converted to its format, a row at a time (a row
+// buffer in dst format is allocated only when clipping on the left,
+// right or top). Returns 0 or an error as png_open / png_read_row
+int png_load(SURFACE_T *dst, int dx, int dy, FILE *fp) {
+    PNG_T *png = malloc(sizeof(PNG_T));
+    int bytes = pix_fmt_bytes(dst->fmt);
+    uint8_t *row = 0;
+    int x0, x1, y, ret;
+
+    if (png == 0)
+        return ENOMEM;
+    ret = png_open(png, fp);
+    if (ret != 0) {
+        free(png);
+        return ret;
+    }
+    x0 = (dx < 0) ? -dx : 0;
+    x1 = (dx + png->width > dst->width) ? dst->width - dx : png->width;
+    if ((x0 > 0) || (x1 < png->width) || (dy < 0)) {
+        row = malloc(png->width * bytes);
+        if (row == 0)
+            ret = ENOMEM;
+    }
+    for (y = 0; (ret == 0) && (y < png->height) && (dy + y < dst->height); y++) {
+        uint8_t *d = (uint8_t *)dst->data + (dy + y) * dst->line_length;
+        if ((dy + y < 0) || (x1 <= x0)) { // nothing of the row shows
+            ret = png_read_row(png, row, dst->fmt, dst->pal);
+        }
+        else if (row != 0) {
+            ret = png_read_row(png, row, dst->fmt, dst->pal);
+            memcpy(d + (dx + x0) * bytes, row + x0 * bytes, (x1 - x0) * bytes);
+        }
+        else {
+            ret = png_read_row(png, d + dx * bytes, dst->fmt, dst->pal);
+        }
+    }
+    free(row);
+    png_close(png);
+    free(png);
+    return ret;
+}
+
+#endif // FBPNG_H
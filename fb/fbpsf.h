@@ -0,0 +1,182 @@
+/*
+ * fbpsf.h
+ *
+ * Loader for the Linux console fonts (PSF version 1 and 2, as found in
+ * /usr/share/consolefonts/, gzipped or not) into a FONT_T (fbfont.h).
+ *
+ * The glyph bits of a PSF file already are in the FONT_T layout, they
+ * are copied as one block. The Unicode table of the font goes into the
+ * font's two-level map (font_map); a font without a table maps
+ * characters 0 .. num - 1 to glyphs in order. Characters the font does
+ * not have are drawn with its U+FFFD or '?' glyph (glyph 0 if neither).
+ * Multi-character sequences of the table are skipped.
+ *
+ * Needs zlib (sudo apt-get install zlib1g-dev) - build with -lz
+ *
+ * Usage:
+ *   FONT_T font;
+ *   if (font_load_psf(&font, "/usr/share/consolefonts/Uni2-Fixed16.psf.gz") == 0) {
+ *       font_draw_text(&screen, x, y, &font, text, fg, bg);
+ *       font_free(&font);
+ *   }
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBPSF_H
+#define FBPSF_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include "fbfont.h"
+
+#define PSF_MAX_SIZE (4 * 1024 * 1024)
+
+static inline uint32_t psf_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// helper function to copy the glyphs - each 'charsize' bytes in the file
+static int psf_glyphs(FONT_T *f, const uint8_t *p, size_t len, int num, int w, int h,
+                      size_t charsize) {
+    int g;
+    f->width = w;
+    f->height = h;
+    f->pitch = (w + 7) / 8;
+    f->num = num;
+    if ((w <= 0) || (h <= 0) || (w > 64) || (h > 64) || (num <= 0) || (num > 0xFFFE)
+        || (charsize < (size_t)h * f->pitch) || ((size_t)num * charsize > len))
+        return EINVAL;
+    f->bits = malloc((size_t)num * h * f->pitch);
+    if (f->bits == 0)
+        return ENOMEM;
+    if (charsize == (size_t)h * f->pitch) {
+        memcpy(f->bits, p, (size_t)num * charsize);
+    }
+    else {
+        for (g = 0; g < num; g++)
+            memcpy(f->bits + (size_t)g * h * f->pitch, p + g * charsize, (size_t)h * f->pitch);
+    }
+    return 0;
+}
+
+// helper function for the PSF2 table: per glyph UTF-8 characters, 0xFE
+// before the sequences, 0xFF at the end
+static int psf2_table(FONT_T *f, const char *p, const char *end) {
+    int g, ret;
+    for (g = 0; (g < f->num) && (p < end); g++) {
+        while ((p < end) && ((uint8_t)*p != 0xFF) && ((uint8_t)*p != 0xFE)) {
+            if ((ret = font_map(f, utf8_next(&p), g)) != 0)
+                return ret;
+        }
+        while ((p < end) && ((uint8_t)*p != 0xFF))
+            p++;
+        p++;
+    }
+    return 0;
+}
+
+// helper function for the PSF1 table: per glyph 16 bit characters,
+// 0xFFFE before the sequences, 0xFFFF at the end
+static int psf1_table(FONT_T *f, const uint8_t *p, const uint8_t *end) {
+    int g, ret, seq;
+    for (g = 0; (g < f->num) && (p + 2 <= end); g++) {
+        for (seq = 0; p + 2 <= end; p += 2) {
+            uint32_t c = p[0] | (p[1] << 8);
+            if (c == 0xFFFF)
+                break;
+            if (c == 0xFFFE)
+                seq = 1;
+            if (!seq && ((ret = font_map(f, c, g)) != 0))
+                return ret;
+        }
+        p += 2;
+    }
+    return 0;
+}
+
+// set up font f from the PSF file in buf (len bytes, buf[len] has to
+// be readable and 0) - returns 0, EINVAL or ENOMEM
+int font_from_psf(FONT_T *f, const uint8_t *buf, size_t len) {
+    int ret, table;
+    size_t end;
+    memset(f, 0, sizeof(*f));
+    if ((len >= 32) && (psf_le32(buf) == 0x864AB572)) {
+        uint32_t hdr = psf_le32(buf + 8);
+        uint32_t num = psf_le32(buf + 16);
+        uint32_t charsize = psf_le32(buf + 20);
+        if ((hdr < 32) || (hdr > len) || (num > 0xFFFE) || (charsize > 64 * 8))
+            return EINVAL;
+        ret = psf_glyphs(f, buf + hdr, len - hdr, num, psf_le32(buf + 28),
+                         psf_le32(buf + 24), charsize);
+        table = psf_le32(buf + 12) & 1;
+        end = hdr + (size_t)num * charsize;
+        if ((ret == 0) && table)
+            ret = psf2_table(f, (const char *)buf + end, (const char *)buf + len);
+    }
+    else if ((len >= 4) && (buf[0] == 0x36) && (buf[1] == 0x04)) {
+        int num = (buf[2] & 0x01) ? 512 : 256;
+        ret = psf_glyphs(f, buf + 4, len - 4, num, 8, buf[3], buf[3]);
+        table = buf[2] & 0x06;
+        end = 4 + (size_t)num * buf[3];
+        if ((ret == 0) && table)
+            ret = psf1_table(f, buf + end, buf + len);
+    }
+    else {
+        return EINVAL;
+    }
+    if (ret != 0) {
+        font_free(f);
+        return ret;
+    }
+    if (!f->unicode)
+        f->first = 0;
+    f->missing = 0;
+    f->missing = font_glyph(f, 0xFFFD);
+    if (f->missing == 0)
+        f->missing = font_glyph(f, '?');
+    return 0;
+}
+
+// load font f from PSF file 'path' (gzipped or not) - returns 0, errno
+// of the open, EIO, EINVAL or ENOMEM
+int font_load_psf(FONT_T *f, const char *path) {
+    gzFile gz;
+    uint8_t *buf;
+    size_t len = 0;
+    int n, ret;
+    memset(f, 0, sizeof(*f));
+    errno = 0;
+    gz = gzopen(path, "rb");
+    if (gz == 0)
+        return (errno != 0) ? errno : ENOMEM;
+    buf = malloc(PSF_MAX_SIZE + 1);
+    if (buf == 0) {
+        gzclose(gz);
+        return ENOMEM;
+    }
+    while ((len < PSF_MAX_SIZE)
+           && ((n = gzread(gz, buf + len, PSF_MAX_SIZE - len)) > 0))
+        len += n;
+    ret = (gzclose(gz) == Z_OK) ? 0 : EIO;
+    if (ret == 0) {
+        buf[len] = 0;
+        ret = font_from_psf(f, buf, len);
+    }
+    free(buf);
+    return ret;
+}
+
+#endif // FBPSF_H
@@ -0,0 +1,325 @@
+/*
+ * fbquant.h
+ *
+ * Color quantization for the 8 bit modes - picks a palette of up to 256
+ * colors for a truecolor image (median cut) and builds the inverse
+ * palette: a 32x64x32 table from the RGB565 value of a color to its
+ * closest palette entry, so that converting to 8 bit is a lookup per
+ * pixel instead of a search through the palette (fbconv.h uses the
+ * table when PALETTE_T lut is set).
+ *
+ * An 8 bit screen is half the memory traffic of an RGB565 one.
+ *
+ * Usage:
+ *   PALETTE_T pal;
+ *   uint8_t *lut = malloc(QUANT_LUT_SIZE);
+ *   quant_median_cut(&pal, 256, &img);
+ *   quant_lut_build(lut, &pal);
+ *   pal.lut = lut;
+ *   quant_put_cmap(fbfd, &pal, 0);
+ *   screen.pal = &pal;
+ *   blit(&screen, 0, 0, &img, 0, 0, 0);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBQUANT_H
+#define FBQUANT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include "fbsurf.h"
+#include "fbconv.h"
+
+// size of the inverse palette: one byte per RGB565 value
+#define QUANT_LUT_SIZE 65536
+
+// a box of the RGB565 color cube (inclusive bounds) for median cut
+typedef struct {
+    int lo[3];    // r, g, b
+    int hi[3];
+    uint32_t count; // pixels in the box
+} QUANT_BOX_T;
+
+// helper function to expand a 5 (r, b) or 6 (g) bit component to 8 bits
+static inline int quant_expand(int v, int c) {
+    return (c == 1) ? ((v << 2) | (v >> 4)) : ((v << 3) | (v >> 2));
+}
+
+// helper function to loop over the histogram entries of a box
+#define QUANT_FOR_BOX(bx, r, g, b) \
+    for (r = (bx)->lo[0]; r <= (bx)->hi[0]; r++) \
+        for (g = (bx)->lo[1]; g <= (bx)->hi[1]; g++) \
+            for (b = (bx)->lo[2]; b <= (bx)->hi[2]; b++)
+
+#define QUANT_INDEX(r, g, b) (((r) << 11) | ((g) << 5) | (b))
+
+// helper function to shrink a box to the colors actually in it
+static void quant_box_shrink(QUANT_BOX_T *bx, const uint32_t *hist) {
+    int lo[3] = { 31, 63, 31 };
+    int hi[3] = { 0, 0, 0 };
+    int r, g, b;
+    bx->count = 0;
+    QUANT_FOR_BOX(bx, r, g, b) {
+        uint32_t n = hist[QUANT_INDEX(r, g, b)];
+        if (n) {
+            bx->count += n;
+            if (r < lo[0]) lo[0] = r;
+            if (r > hi[0]) hi[0] = r;
+            if (g < lo[1]) lo[1] = g;
+            if (g > hi[1]) hi[1] = g;
+            if (b < lo[2]) lo[2] = b;
+            if (b > hi[2]) hi[2] = b;
+        }
+    }
+    if (bx->count) {
+        memcpy(bx->lo, lo, sizeof(lo));
+        memcpy(bx->hi, hi, sizeof(hi));
+    }
+}
+
+// helper function to get the longest side of a box in 8 bit units
+// (green has twice the steps, so they are half as long)
+static inline int quant_box_axis(const QUANT_BOX_T *bx, int *len) {
+    int lr = (bx->hi[0] - bx->lo[0]) * 8;
+    int lg = (bx->hi[1] - bx->lo[1]) * 4;
+    int lb = (bx->hi[2] - bx->lo[2]) * 8;
+    if ((lg >= lr) && (lg >= lb)) {
+        *len = lg;
+        return 1;
+    }
+    *len = (lr >= lb) ? lr : lb;
+    return (lr >= lb) ? 0 : 2;
+}
+
+// helper function to split a box at the median of its longest side
+// into itself and 'nb' - returns 0 if it is a single color
+static int quant_box_split(QUANT_BOX_T *bx, QUANT_BOX_T *nb, const uint32_t *hist) {
+    uint32_t slice[64];
+    uint32_t sum = 0;
+    int len, cut, r, g, b;
+    int c = quant_box_axis(bx, &len);
+    if (len == 0)
+        return 0;
+    memset(slice, 0, sizeof(slice));
+    QUANT_FOR_BOX(bx, r, g, b) {
+        int v = (c == 0) ? r : (c == 1) ? g : b;
+        slice[v] += hist[QUANT_INDEX(r, g, b)];
+    }
+    // the last slice below the median - both halves get something as
+    // the box was shrunk to its colors (lo and hi slices are non-empty)
+    for (cut = bx->lo[c]; cut < bx->hi[c] - 1; cut++) {
+        sum += slice[cut];
+        if (sum * 2 >= bx->count)
+            break;
+    }
+    *nb = *bx;
+    bx->hi[c] = cut;
+    nb->lo[c] = cut + 1;
+    quant_box_shrink(bx, hist);
+    quant_box_shrink(nb, hist);
+    return 1;
+}
+
+// pick a palette of at most 'ncolors' (1-256) for an image with median
+// cut on its RGB565 histogram - fills pal->rgb/num (pal->lut is set to 0)
+// and returns 0, or EINVAL / ENOMEM
+int quant_median_cut(PALETTE_T *pal, int ncolors, const SURFACE_T *img) {
+    uint32_t row[CONV_CHUNK];
+    QUANT_BOX_T boxes[256];
+    uint32_t *hist;
+    int nbox = 1;
+    int i, x, y, r, g, b;
+
+    if ((ncolors < 1) || (ncolors > 256) || (img->width <= 0) || (img->height <= 0))
+        return EINVAL;
+    hist = calloc(QUANT_LUT_SIZE, sizeof(uint32_t));
+    if (hist == 0)
+        return ENOMEM;
+
+    // histogram of the image colors in 5:6:5
+    for (y = 0; y < img->height; y++) {
+        const uint8_t *p = (const uint8_t *)img->data + y * img->line_length;
+        for (x = 0; x < img->width; x += CONV_CHUNK) {
+            int n = (img->width - x > CONV_CHUNK) ? CONV_CHUNK : img->width - x;
+            conv_to_xrgb(row, p + x * pix_fmt_bytes(img->fmt), n, img->fmt, img->pal);
+            for (i = 0; i < n; i++) {
+                uint32_t c = row[i];
+                hist[((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0) | ((c >> 3) & 0x001F)]++;
+            }
+        }
+    }
+
+    // split the box with the most pixels times length until enough boxes
+    boxes[0].lo[0] = boxes[0].lo[1] = boxes[0].lo[2] = 0;
+    boxes[0].hi[0] = 31;
+    boxes[0].hi[1] = 63;
+    boxes[0].hi[2] = 31;
+    quant_box_shrink(&boxes[0], hist);
+    while (nbox < ncolors) {
+        uint64_t best = 0;
+        int bi = -1;
+        for (i = 0; i < nbox; i++) {
+            int len;
+            quant_box_axis(&boxes[i], &len);
+            if ((uint64_t)boxes[i].count * len > best) {
+                best = (uint64_t)boxes[i].count * len;
+                bi = i;
+            }
+        }
+        if ((bi < 0) || !quant_box_split(&boxes[bi], &boxes[nbox], hist))
+            break; // every box is a single color
+        nbox++;
+    }
+
+    // each box becomes the average of its colors
+    for (i = 0; i < nbox; i++) {
+        uint64_t sr = 0, sg = 0, sb = 0;
+        uint64_t n = boxes[i].count ? boxes[i].count : 1;
+        QUANT_FOR_BOX(&boxes[i], r, g, b) {
+            uint32_t h = hist[QUANT_INDEX(r, g, b)];
+            sr += (uint64_t)h * quant_expand(r, 0);
+            sg += (uint64_t)h * quant_expand(g, 1);
+            sb += (uint64_t)h * quant_expand(b, 2);
+        }
+        pal->rgb[i] = (((sr + n / 2) / n) << 16) | (((sg + n / 2) / n) << 8)
+                      | ((sb + n / 2) / n);
+    }
+    for (; i < 256; i++)
+        pal->rgb[i] = 0;
+    pal->num = nbox;
+    pal->lut = 0;
+
+    free(hist);
+    return 0;
+}
+
+// build the inverse palette 'lut' (QUANT_LUT_SIZE bytes) for 'pal': for
+// every RGB565 value the entry closest to its 8 bit expansion - the same
+// entry conv_nearest() would give for that color, found by walking the
+// palette sorted by green outwards and stopping once green alone is
+// further than the best so far. Returns 0 or EINVAL.
+int quant_lut_build(uint8_t *lut, const PALETTE_T *pal) {
+    uint8_t order[256];
+    int pr[256], pg[256], pb[256];
+    int start[64];
+    int n = pal->num;
+    int i, j, r, g, b;
+
+    if ((n < 1) || (n > 256))
+        return EINVAL;
+
+    // palette indexes sorted by green (insertion sort, 256 at most)
+    for (i = 0; i < n; i++) {
+        int v = (pal->rgb[i] >> 8) & 0xFF;
+        for (j = i; (j > 0) && (((pal->rgb[order[j - 1]] >> 8) & 0xFF) > v); j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+    for (i = 0; i < n; i++) {
+        pr[i] = (pal->rgb[order[i]] >> 16) & 0xFF;
+        pg[i] = (pal->rgb[order[i]] >> 8) & 0xFF;
+        pb[i] = pal->rgb[order[i]] & 0xFF;
+    }
+    // first sorted entry with green >= each 6 bit green level
+    for (g = 0, i = 0; g < 64; g++) {
+        while ((i < n) && (pg[i] < quant_expand(g, 1)))
+            i++;
+        start[g] = i;
+    }
+
+    for (r = 0; r < 32; r++) {
+        int cr = quant_expand(r, 0);
+        for (g = 0; g < 64; g++) {
+            int cg = quant_expand(g, 1);
+            int prev = (start[g] < n) ? start[g] : n - 1;
+            for (b = 0; b < 32; b++) {
+                int cb = quant_expand(b, 2);
+                // the neighbour's answer is a good first guess
+                int best = prev;
+                int bestd = (cr - pr[best]) * (cr - pr[best])
+                          + (cg - pg[best]) * (cg - pg[best])
+                          + (cb - pb[best]) * (cb - pb[best]);
+                int up = start[g], down = start[g] - 1;
+                while ((up < n) || (down >= 0)) {
+                    if (up < n) {
+                        int dg = pg[up] - cg;
+                        if (dg * dg > bestd) {
+                            up = n;
+                        }
+                        else {
+                            int d = dg * dg + (cr - pr[up]) * (cr - pr[up])
+                                    + (cb - pb[up]) * (cb - pb[up]);
+                            if ((d < bestd) || ((d == bestd) && (order[up] < order[best]))) {
+                                bestd = d;
+                                best = up;
+                            }
+                            up++;
+                        }
+                    }
+                    if (down >= 0) {
+                        int dg = cg - pg[down];
+                        if (dg * dg > bestd) {
+                            down = -1;
+                        }
+                        else {
+                            int d = dg * dg + (cr - pr[down]) * (cr - pr[down])
+                                    + (cb - pb[down]) * (cb - pb[down]);
+                            if ((d < bestd) || ((d == bestd) && (order[down] < order[best]))) {
+                                bestd = d;
+                                best = down;
+                            }
+                            down--;
+                        }
+                    }
+                }
+                prev = best;
+                lut[QUANT_INDEX(r, g, b)] = order[best];
+            }
+        }
+    }
+    return 0;
+}
+
+// load the palette into the display (8 bit modes) starting at entry
+// 'first' - returns 0 or EIO
+int quant_put_cmap(int fbfd, const PALETTE_T *pal, int first) {
+    unsigned short r[256];
+    unsigned short g[256];
+    unsigned short b[256];
+    struct fb_cmap cmap;
+    int i;
+    memset(r, 0, sizeof(r));
+    memset(g, 0, sizeof(g));
+    memset(b, 0, sizeof(b));
+    for (i = 0; (i < pal->num) && (first + i < 256); i++) {
+        r[i] = ((pal->rgb[i] >> 16) & 0xFF) << 8;
+        g[i] = ((pal->rgb[i] >> 8) & 0xFF) << 8;
+        b[i] = (pal->rgb[i] & 0xFF) << 8;
+    }
+    cmap.start = first;
+    cmap.len = 256 - first; // all the way to the end - see fbtesttile.c
+    cmap.red = r;
+    cmap.green = g;
+    cmap.blue = b;
+    cmap.transp = 0;
+    if (ioctl(fbfd, FBIOPUTCMAP, &cmap)) {
+        return EIO;
+    }
+    return 0;
+}
+
+#endif // FBQUANT_H
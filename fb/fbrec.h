@@ -0,0 +1,576 @@
+/*
+ * fbrec.h
+ *
+ * Frame recorder and replayer - captures what a program presents, frame
+ * by frame with timestamps, into a compact stream that can be played
+ * back later into any surface (to reproduce a glitch or a slow frame
+ * seen somewhere else).
+ *
+ * The render loop only copies the changed rectangles of the presented
+ * page (the damage it composited anyway) into a free buffer and hands
+ * it over - XOR against the previous frame, run length coding and
+ * writing the file all happen on a thread of their own. If the thread
+ * falls behind and all buffers are taken the frame is dropped and the
+ * next one captured whole, so the stream never goes out of sync.
+ *
+ * Stream (host byte order):
+ *   REC_HEADER_T
+ *   per frame: REC_FRAME_HEADER_T, then per rectangle REC_RECT_T and
+ *   'size' bytes: the rectangle's pixels row by row XORed with the
+ *   previous frame, run length coded in whole pixels:
+ *     c < 0x80: c + 1 pixels as they are
+ *     c >= 0x80: ((c & 0x7F) << 8 | next byte) + 1 times the pixel after
+ *
+ * Needs pthreads - build with -lpthread
+ *
+ * Usage:
+ *   REC_T rec;
+ *   rec_open(&rec, fp, w, h, fmt);
+ *   after each flip: rec_frame(&rec, &page, damage, num_damage);
+ *   rec_close(&rec);
+ * and:
+ *   REPLAY_T p;
+ *   replay_open(&p, fp);
+ *   while (replay_next(&p) == 0)
+ *       replay_draw(&p, &dst, 0, 0, p.r, p.num); ... at p.usec
+ *   replay_close(&p);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBREC_H
+#define FBREC_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "fbsurf.h"
+#include "fbconv.h"
+
+#define REC_MAGIC "FBRC"
+#define REC_VERSION 1
+// frames captured but not yet compressed
+#define REC_SLOTS 4
+// changed rectangles per frame (the last one grows to cover any more)
+#define REC_MAX_RECTS 32
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fmt;       // PIX_FMT_T
+} REC_HEADER_T;
+
+typedef struct {
+    uint64_t usec;      // since the recording started
+    uint32_t num;       // rectangles
+} REC_FRAME_HEADER_T;
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint32_t size;      // coded bytes that follow
+} REC_RECT_T;
+
+typedef struct {
+    RECT_T r[REC_MAX_RECTS];
+    int num;
+    uint64_t usec;
+    uint8_t *data;      // rows of the rectangles one after the other
+} REC_SLOT_T;
+
+typedef struct {
+    FILE *fp;
+    int width;
+    int height;
+    PIX_FMT_T fmt;
+    int bpp;
+    struct timespec start;
+    REC_SLOT_T slots[REC_SLOTS];
+    int head;           // next slot to fill (render loop)
+    int tail;           // next slot to compress (thread)
+    int count;          // filled slots
+    int quit;
+    int resync;         // next frame is captured whole
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *prev;      // the previous frame (thread)
+    uint8_t *out;       // coded rectangle (thread)
+    int err;            // write error (thread)
+    // statistics
+    int frames;
+    int dropped;
+    long bytes;         // written
+    long max_capture_usec; // longest rec_frame call
+} REC_T;
+
+typedef struct {
+    FILE *fp;
+    int width;
+    int height;
+    PIX_FMT_T fmt;
+    int bpp;
+    uint8_t *frame;     // the current frame
+    uint8_t *rows;      // rows of a rectangle narrower than the frame
+    uint8_t *in;        // coded rectangle
+    size_t in_size;
+    uint64_t usec;      // of the current frame
+    RECT_T r[REC_MAX_RECTS]; // rectangles changed by it
+    int num;
+} REPLAY_T;
+
+// helper function for microseconds from 'start' to now
+static long rec_usec(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000L
+         + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+// helper function for the worst case coded size of n pixels - a run is
+// never longer than its pixels as they are (rec_rle), so that is all
+// literals
+static inline size_t rec_rle_bound(size_t n, int bpp) {
+    return n * bpp + n / 128 + 3 + bpp;
+}
+
+// helper function to read a pixel of any size as one value
+static inline uint32_t rec_pixel(const uint8_t *p, int bpp) {
+    uint32_t v = 0;
+    memcpy(&v, p, bpp);
+    return v;
+}
+
+// helper function to run length code n pixels of bpp bytes - returns the
+// coded size
+static size_t rec_rle(uint8_t *out, const uint8_t *in, size_t n, int bpp) {
+    size_t i = 0, lit = 0, o = 0, r;
+    while (i < n) {
+        uint32_t v = rec_pixel(in + i * bpp, bpp);
+        for (r = 1; (i + r < n) && (r < 32768) && (rec_pixel(in + (i + r) * bpp, bpp) == v); r++)
+            ;
+        // a run (2 + bpp bytes) that splits a literal adds a literal header
+        // - only worth it if it is not longer than the r pixels as they are
+        // (at least 4 for 1 byte pixels)
+        if ((r < 3) || (r * bpp < 3 + bpp)) {
+            i += r;
+            continue;
+        }
+        // the pixels before the run as they are
+        while (lit < i) {
+            size_t k = (i - lit > 128) ? 128 : i - lit;
+            out[o++] = k - 1;
+            memcpy(out + o, in + lit * bpp, k * bpp);
+            o += k * bpp;
+            lit += k;
+        }
+        out[o++] = 0x80 | ((r - 1) >> 8);
+        out[o++] = (r - 1) & 0xFF;
+        memcpy(out + o, in + i * bpp, bpp);
+        o += bpp;
+        i += r;
+        lit = i;
+    }
+    while (lit < n) {
+        size_t k = (n - lit > 128) ? 128 : n - lit;
+        out[o++] = k - 1;
+        memcpy(out + o, in + lit * bpp, k * bpp);
+        o += k * bpp;
+        lit += k;
+    }
+    return o;
+}
+
+// helper function to undo rec_rle XORing into 'out' (n pixels) - returns
+// 0 or EINVAL if the data does not make exactly n pixels
+static int rec_unrle_xor(uint8_t *out, size_t n, int bpp, const uint8_t *in, size_t size) {
+    size_t i = 0, o = 0, k;
+    int b;
+    n *= bpp;
+    while (i < size) {
+        uint8_t c = in[i++];
+        if (c < 0x80) {
+            k = (c + 1) * bpp;
+            if ((i + k > size) || (o + k > n))
+                return EINVAL;
+            while (k--)
+                out[o++] ^= in[i++];
+        }
+        else {
+            if (i + 1 + bpp > size)
+                return EINVAL;
+            k = ((((c & 0x7F) << 8) | in[i]) + 1) * bpp;
+            i++;
+            if (o + k > n)
+                return EINVAL;
+            if (rec_pixel(in + i, bpp) == 0) {
+                o += k; // unchanged
+            }
+            else {
+                for (; k > 0; k -= bpp)
+                    for (b = 0; b < bpp; b++)
+                        out[o++] ^= in[i + b];
+            }
+            i += bpp;
+        }
+    }
+    return (o == n) ? 0 : EINVAL;
+}
+
+// helper function to code and write one captured frame (thread)
+static int rec_write_frame(REC_T *rec, REC_SLOT_T *slot) {
+    REC_FRAME_HEADER_T fh;
+    REC_RECT_T rh;
+    int i, y;
+    size_t row = 0, bytes;
+    uint8_t *src = slot->data;
+
+    memset(&fh, 0, sizeof(fh));
+    fh.usec = slot->usec;
+    fh.num = slot->num;
+    if (fwrite(&fh, sizeof(fh), 1, rec->fp) != 1)
+        return EIO;
+    rec->bytes += sizeof(fh);
+    for (i = 0; i < slot->num; i++) {
+        const RECT_T *r = &slot->r[i];
+        row = r->w * rec->bpp;
+        // XOR the rows in place against the previous frame (and keep them
+        // as the previous frame for the next one)
+        uint8_t *d = src;
+        for (y = 0; y < r->h; y++) {
+            uint8_t *p = rec->prev + (r->y + y) * rec->width * rec->bpp + r->x * rec->bpp;
+            size_t k;
+            for (k = 0; k < row; k++) {
+                uint8_t c = d[k];
+                d[k] ^= p[k];
+                p[k] = c;
+            }
+            d += row;
+        }
+        bytes = rec_rle(rec->out, src, r->w * r->h, rec->bpp);
+        rh.x = r->x;
+        rh.y = r->y;
+        rh.w = r->w;
+        rh.h = r->h;
+        rh.size = bytes;
+        if ((fwrite(&rh, sizeof(rh), 1, rec->fp) != 1)
+            || (fwrite(rec->out, 1, bytes, rec->fp) != bytes))
+            return EIO;
+        rec->bytes += sizeof(rh) + bytes;
+        src += row * r->h;
+    }
+    return 0;
+}
+
+// the compressing thread
+static void *rec_thread(void *arg) {
+    REC_T *rec = (REC_T *)arg;
+    REC_SLOT_T *slot;
+    // never take the CPU from the render loop (on Linux this sets the
+    // priority of only the calling thread)
+    setpriority(PRIO_PROCESS, 0, 19);
+    for (;;) {
+        pthread_mutex_lock(&rec->lock);
+        while ((rec->count == 0) && !rec->quit)
+            pthread_cond_wait(&rec->cond, &rec->lock);
+        if (rec->count == 0) {
+            pthread_mutex_unlock(&rec->lock);
+            break;
+        }
+        slot = &rec->slots[rec->tail];
+        pthread_mutex_unlock(&rec->lock);
+
+        if ((rec->err == 0) && (rec_write_frame(rec, slot) != 0))
+            rec->err = EIO;
+
+        pthread_mutex_lock(&rec->lock);
+        rec->tail = (rec->tail + 1) % REC_SLOTS;
+        rec->count--;
+        pthread_mutex_unlock(&rec->lock);
+    }
+    return 0;
+}
+
+// start recording w x h frames of 'fmt' to 'fp' - returns 0 or errno
+int rec_open(REC_T *rec, FILE *fp, int w, int h, PIX_FMT_T fmt) {
+    REC_HEADER_T hdr;
+    size_t frame;
+    int i, ok;
+
+    memset(rec, 0, sizeof(*rec));
+    rec->fp = fp;
+    rec->width = w;
+    rec->height = h;
+    rec->fmt = fmt;
+    rec->bpp = pix_fmt_bytes(fmt);
+    rec->resync = 1;
+    frame = (size_t)w * h * rec->bpp;
+    rec->prev = calloc(frame, 1);
+    rec->out = malloc(rec_rle_bound((size_t)w * h, rec->bpp));
+    for (i = 0, ok = (rec->prev != 0) && (rec->out != 0); i < REC_SLOTS; i++) {
+        rec->slots[i].data = malloc(frame);
+        ok = ok && (rec->slots[i].data != 0);
+    }
+    if (!ok) {
+        for (i = 0; i < REC_SLOTS; i++)
+            free(rec->slots[i].data);
+        free(rec->prev);
+        free(rec->out);
+        return ENOMEM;
+    }
+
+    memcpy(hdr.magic, REC_MAGIC, 4);
+    hdr.version = REC_VERSION;
+    hdr.width = w;
+    hdr.height = h;
+    hdr.fmt = fmt;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        for (i = 0; i < REC_SLOTS; i++)
+            free(rec->slots[i].data);
+        free(rec->prev);
+        free(rec->out);
+        return EIO;
+    }
+    rec->bytes = sizeof(hdr);
+
+    pthread_mutex_init(&rec->lock, 0);
+    pthread_cond_init(&rec->cond, 0);
+    clock_gettime(CLOCK_MONOTONIC, &rec->start);
+    if (pthread_create(&rec->thread, 0, rec_thread, rec) != 0) {
+        pthread_mutex_destroy(&rec->lock);
+        pthread_cond_destroy(&rec->cond);
+        for (i = 0; i < REC_SLOTS; i++)
+            free(rec->slots[i].data);
+        free(rec->prev);
+        free(rec->out);
+        return EAGAIN;
+    }
+    return 0;
+}
+
+// capture the presented 'page' - 'damage' (num rectangles, screen
+// coordinates) is what changed since the previous call, 0 for all of it
+void rec_frame(REC_T *rec, const SURFACE_T *page, const RECT_T *damage, int num) {
+    RECT_T all = { 0, 0, rec->width, rec->height };
+    REC_SLOT_T *slot;
+    uint8_t *d;
+    long t0 = rec_usec(&rec->start);
+    long area;
+    int i, y;
+
+    pthread_mutex_lock(&rec->lock);
+    if (rec->count == REC_SLOTS) {
+        // the thread is behind - drop this one, take the next one whole
+        pthread_mutex_unlock(&rec->lock);
+        rec->dropped++;
+        rec->resync = 1;
+        return;
+    }
+    pthread_mutex_unlock(&rec->lock);
+
+    slot = &rec->slots[rec->head];
+    slot->usec = t0;
+    slot->num = 0;
+    if ((damage == 0) || rec->resync) {
+        damage = &all;
+        num = 1;
+        rec->resync = 0;
+    }
+    for (i = 0; i < num; i++) {
+        RECT_T c;
+        if (!rect_intersect(&c, &damage[i], &all))
+            continue;
+        if (slot->num < REC_MAX_RECTS) {
+            slot->r[slot->num++] = c;
+        }
+        else {
+            // too many - grow the last one to cover this too
+            RECT_T *last = &slot->r[REC_MAX_RECTS - 1];
+            int x1 = (last->x + last->w > c.x + c.w) ? last->x + last->w : c.x + c.w;
+            int y1 = (last->y + last->h > c.y + c.h) ? last->y + last->h : c.y + c.h;
+            last->x = (last->x < c.x) ? last->x : c.x;
+            last->y = (last->y < c.y) ? last->y : c.y;
+            last->w = x1 - last->x;
+            last->h = y1 - last->y;
+        }
+    }
+    // overlapping rectangles may add up to more than the slot holds
+    for (i = 0, area = 0; i < slot->num; i++)
+        area += slot->r[i].w * slot->r[i].h;
+    if (area > (long)rec->width * rec->height) {
+        slot->r[0] = all;
+        slot->num = 1;
+    }
+    d = slot->data;
+    for (i = 0; i < slot->num; i++) {
+        const RECT_T *r = &slot->r[i];
+        size_t row = r->w * rec->bpp;
+        for (y = 0; y < r->h; y++) {
+            memcpy(d, surface_pixel(page, r->x, r->y + y), row);
+            d += row;
+        }
+    }
+
+    pthread_mutex_lock(&rec->lock);
+    rec->head = (rec->head + 1) % REC_SLOTS;
+    rec->count++;
+    pthread_cond_signal(&rec->cond);
+    pthread_mutex_unlock(&rec->lock);
+
+    rec->frames++;
+    t0 = rec_usec(&rec->start) - t0;
+    if (t0 > rec->max_capture_usec)
+        rec->max_capture_usec = t0;
+}
+
+// finish writing and stop the thread (does not close the file) - returns
+// 0 or errno if writing failed
+int rec_close(REC_T *rec) {
+    int i;
+    pthread_mutex_lock(&rec->lock);
+    rec->quit = 1;
+    pthread_cond_signal(&rec->cond);
+    pthread_mutex_unlock(&rec->lock);
+    pthread_join(rec->thread, 0);
+    pthread_mutex_destroy(&rec->lock);
+    pthread_cond_destroy(&rec->cond);
+    for (i = 0; i < REC_SLOTS; i++)
+        free(rec->slots[i].data);
+    free(rec->prev);
+    free(rec->out);
+    if ((rec->err == 0) && (fflush(rec->fp) != 0))
+        rec->err = EIO;
+    return rec->err;
+}
+
+// open a recorded stream - returns 0 or errno
+int replay_open(REPLAY_T *p, FILE *fp) {
+    REC_HEADER_T hdr;
+    memset(p, 0, sizeof(*p));
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1)
+        return EIO;
+    if ((memcmp(hdr.magic, REC_MAGIC, 4) != 0) || (hdr.version != REC_VERSION)
+        || (hdr.fmt > PIX_FMT_XRGB8888) || (hdr.width == 0) || (hdr.height == 0)
+        || (hdr.width > 65535) || (hdr.height > 65535))
+        return EINVAL;
+    p->fp = fp;
+    p->width = hdr.width;
+    p->height = hdr.height;
+    p->fmt = hdr.fmt;
+    p->bpp = pix_fmt_bytes(p->fmt);
+    p->frame = calloc((size_t)p->width * p->height, p->bpp);
+    p->rows = malloc((size_t)p->width * p->height * p->bpp);
+    if ((p->frame == 0) || (p->rows == 0)) {
+        free(p->frame);
+        free(p->rows);
+        return ENOMEM;
+    }
+    return 0;
+}
+
+// decode the next frame (p->r, p->num are the rectangles it changed and
+// p->usec when it was shown) - returns 0, ENODATA at the end or errno
+int replay_next(REPLAY_T *p) {
+    REC_FRAME_HEADER_T fh;
+    REC_RECT_T rh;
+    RECT_T all = { 0, 0, p->width, p->height };
+    uint8_t *tmp;
+    int i, y, ret;
+
+    if (fread(&fh, sizeof(fh), 1, p->fp) != 1)
+        return feof(p->fp) ? ENODATA : EIO;
+    if (fh.num > REC_MAX_RECTS)
+        return EINVAL;
+    p->usec = fh.usec;
+    p->num = 0;
+    for (i = 0; i < (int)fh.num; i++) {
+        RECT_T r, c;
+        size_t row;
+        if (fread(&rh, sizeof(rh), 1, p->fp) != 1)
+            return EIO;
+        r.x = rh.x;
+        r.y = rh.y;
+        r.w = rh.w;
+        r.h = rh.h;
+        if (!rect_intersect(&c, &r, &all) || (c.w != r.w) || (c.h != r.h))
+            return EINVAL;
+        if (rh.size > p->in_size) {
+            tmp = realloc(p->in, rh.size);
+            if (tmp == 0)
+                return ENOMEM;
+            p->in = tmp;
+            p->in_size = rh.size;
+        }
+        if (fread(p->in, 1, rh.size, p->fp) != rh.size)
+            return EIO;
+        // rows are contiguous only when the rectangle is full width
+        row = r.w * p->bpp;
+        if (r.w == p->width) {
+            ret = rec_unrle_xor(p->frame + r.y * row, r.w * r.h, p->bpp, p->in, rh.size);
+        }
+        else {
+            for (y = 0; y < r.h; y++)
+                memcpy(p->rows + y * row, p->frame + ((r.y + y) * p->width + r.x) * p->bpp, row);
+            ret = rec_unrle_xor(p->rows, r.w * r.h, p->bpp, p->in, rh.size);
+            for (y = 0; y < r.h; y++)
+                memcpy(p->frame + ((r.y + y) * p->width + r.x) * p->bpp, p->rows + y * row, row);
+        }
+        if (ret != 0)
+            return ret;
+        p->r[p->num++] = r;
+    }
+    return 0;
+}
+
+// draw rectangles of the current frame to 'dst' with the frame's top
+// left corner at dx, dy (clipped, converted to the surface format - an 8
+// bit recording only to an 8 bit surface) - returns 0 or EINVAL
+int replay_draw(const REPLAY_T *p, SURFACE_T *dst, int dx, int dy, const RECT_T *rects, int num) {
+    RECT_T bounds = { 0, 0, dst->width, dst->height };
+    int i, y;
+    if ((p->fmt == PIX_FMT_PAL8) != (dst->fmt == PIX_FMT_PAL8))
+        return EINVAL;
+    for (i = 0; i < num; i++) {
+        RECT_T r = { rects[i].x + dx, rects[i].y + dy, rects[i].w, rects[i].h };
+        RECT_T c;
+        if (!rect_intersect(&c, &r, &bounds))
+            continue;
+        for (y = c.y; y < c.y + c.h; y++) {
+            const uint8_t *src = p->frame
+                + ((y - dy) * p->width + (c.x - dx)) * p->bpp;
+            // 8 bit indexes are kept as they are
+            conv_row((uint8_t *)surface_pixel(dst, c.x, y), dst->fmt, dst->pal,
+                     src, p->fmt, dst->pal, c.w);
+        }
+    }
+    return 0;
+}
+
+void replay_close(REPLAY_T *p) {
+    free(p->frame);
+    free(p->rows);
+    free(p->in);
+    p->frame = 0;
+    p->rows = 0;
+    p->in = 0;
+}
+
+#endif // FBREC_H
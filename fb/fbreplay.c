@@ -0,0 +1,243 @@
+/*
+ * fbreplay.c
+ *
+ * Plays back a recording made with fbrec.h (e.g. ./fbtestcomp rec.fbr)
+ * - at the recorded pace, or as fast as it decodes with 'max'. Each
+ * frame redraws the rectangles the recording says changed, plus those
+ * of the previous frame (the back page is two frames old).
+ *
+ * To build:
+ *   gcc -O2 -o fbreplay fbreplay.c -lpthread
+ *
+ * Usage:
+ *   - to run
+ *        ./fbreplay rec.fbr [max]
+ *   - a recording of a different size is drawn to the top left corner
+ *     (clipped) and converted to the screen format
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbrec.h"
+#include "fbmap.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+int draw(FILE *fp, int max) {
+
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    SURFACE_T page;
+    REPLAY_T p;
+    RECT_T prev[REC_MAX_RECTS];
+    RECT_T all;
+    int num_prev = 0;
+    int i, ret;
+    long late = 0;
+
+    ret = replay_open(&p, fp);
+    if (ret != 0) {
+        printf("Not a recording (%d).\n", ret);
+        return ret;
+    }
+    printf("Recording %dx%d, format %d\n", p.width, p.height, p.fmt);
+
+    clock_gettime(CLOCK_MONOTONIC, &pt);
+
+    for (i = 0; (ret = replay_next(&p)) == 0; i++) {
+
+        // wait for the frame's time
+        if (!max) {
+            long wait = p.usec - rec_usec(&pt);
+            if (wait > 0)
+                usleep(wait);
+            else
+                late -= wait;
+        }
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+        if (i < 2) {
+            // both pages start from the whole first frame
+            all.x = 0;
+            all.y = 0;
+            all.w = p.width;
+            all.h = p.height;
+            ret = replay_draw(&p, &page, 0, 0, &all, 1);
+        }
+        else {
+            ret = replay_draw(&p, &page, 0, 0, prev, num_prev);
+            if (ret == 0)
+                ret = replay_draw(&p, &page, 0, 0, p.r, p.num);
+        }
+        if (ret != 0) {
+            printf("Can not draw an 8 bit recording to this screen.\n");
+            break;
+        }
+        memcpy(prev, p.r, p.num * sizeof(RECT_T));
+        num_prev = p.num;
+
+        // switch page
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+    if (ret == ENODATA) {
+        ret = 0;
+    }
+    else if (ret != 0) {
+        printf("Error in recording (%d) at frame %d.\n", ret, i);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ct);
+    df = timediff(pt, ct);
+    printf("%d frames in %ld s %5ld ms (recorded %ld ms", i, df.tv_sec,
+           df.tv_nsec / 1000000, (long)(p.usec / 1000));
+    if (!max)
+        printf(", late %ld ms in all", late / 1000);
+    printf(")\n");
+
+    replay_close(&p);
+    return ret;
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+    FILE *fp;
+    int ret = 0;
+
+    if (argc < 2) {
+        printf("Usage: %s recording [max]\n", argv[0]);
+        return EINVAL;
+    }
+    fp = fopen(argv[1], "rb");
+    if (fp == 0) {
+        ret = errno;
+        printf("Error opening file %s (errno=%d).\n", argv[1], ret);
+        return ret;
+    }
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        ret = draw(fp, (argc > 2) && (strcmp(argv[2], "max") == 0));
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+    fclose(fp);
+
+    return ret;
+
+}
@@ -0,0 +1,350 @@
+/*
+ * fbrotate.h
+ *
+ * Rotated presenting for portrait mounted displays - draw everything to
+ * a surface in the logical (portrait) orientation, then rotate it, or
+ * just its damaged rectangles, into the framebuffer page by 90, 180 or
+ * 270 degrees clockwise.
+ *
+ * A naive rotation reads rows and writes columns: every pixel written
+ * lands on a different cache line. Here the rectangle is walked in
+ * 32x32 pixel tiles that stay in the cache and each tile in 8x8 (16 bit)
+ * or 4x4 (32 bit) blocks transposed in SSE2 / NEON registers - a block
+ * is read as rows and written as rows. Reading the rows of the block in
+ * reverse order (90) or writing them in reverse order (270) makes the
+ * transpose a rotation. 180 is rows reversed in place, so it needs no
+ * tiles. 8 and 24 bit surfaces use the same tiles without the SIMD.
+ *
+ * Usage:
+ *   rotate(&page, &logical, 0, ROT_90);           // all of it
+ *   rotate(&page, &logical, &damage, ROT_90);     // part of it
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBROTATE_H
+#define FBROTATE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "fbsurf.h"
+
+// clockwise rotations
+#define ROT_0 0
+#define ROT_90 1
+#define ROT_180 2
+#define ROT_270 3
+
+// tile size in pixels (a multiple of the 8x8 blocks)
+#define ROT_TILE 32
+
+// helper function to map a rectangle of a lw x lh logical surface to
+// where it is after the rotation
+static inline void rotate_rect(RECT_T *out, const RECT_T *in, int lw, int lh, int rot) {
+    RECT_T r = *in;
+    switch (rot) {
+    case ROT_90:
+        out->x = lh - r.y - r.h;
+        out->y = r.x;
+        out->w = r.h;
+        out->h = r.w;
+        break;
+    case ROT_180:
+        out->x = lw - r.x - r.w;
+        out->y = lh - r.y - r.h;
+        out->w = r.w;
+        out->h = r.h;
+        break;
+    case ROT_270:
+        out->x = r.y;
+        out->y = lw - r.x - r.w;
+        out->w = r.h;
+        out->h = r.w;
+        break;
+    default:
+        *out = r;
+        break;
+    }
+}
+
+// helper function to transpose a w x h block of pixels: source column j
+// becomes destination row j - the strides are in bytes and may be
+// negative (to go through the rows backwards)
+static void rotate_block(uint8_t *d, int ds, const uint8_t *s, int ss,
+                         int w, int h, int bytes) {
+    int j, k;
+    for (j = 0; j < w; j++) {
+        uint8_t *dr = d + j * ds;
+        const uint8_t *sc = s + j * bytes;
+        switch (bytes) {
+        case 1:
+            for (k = 0; k < h; k++)
+                dr[k] = sc[k * ss];
+            break;
+        case 2:
+            for (k = 0; k < h; k++)
+                ((uint16_t *)dr)[k] = *(const uint16_t *)(sc + k * ss);
+            break;
+        case 4:
+            for (k = 0; k < h; k++)
+                ((uint32_t *)dr)[k] = *(const uint32_t *)(sc + k * ss);
+            break;
+        default:
+            for (k = 0; k < h; k++)
+                memcpy(dr + k * bytes, sc + k * ss, bytes);
+            break;
+        }
+    }
+}
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#define ROT_HAVE_SIMD 1
+
+// the same for an 8x8 block of 16 bit pixels
+static inline void rotate_block16(uint8_t *d, int ds, const uint8_t *s, int ss) {
+#if defined(__SSE2__)
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(s));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(s + ss));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(s + 2 * ss));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(s + 3 * ss));
+    __m128i r4 = _mm_loadu_si128((const __m128i *)(s + 4 * ss));
+    __m128i r5 = _mm_loadu_si128((const __m128i *)(s + 5 * ss));
+    __m128i r6 = _mm_loadu_si128((const __m128i *)(s + 6 * ss));
+    __m128i r7 = _mm_loadu_si128((const __m128i *)(s + 7 * ss));
+    __m128i a0 = _mm_unpacklo_epi16(r0, r1);
+    __m128i b0 = _mm_unpackhi_epi16(r0, r1);
+    __m128i a1 = _mm_unpacklo_epi16(r2, r3);
+    __m128i b1 = _mm_unpackhi_epi16(r2, r3);
+    __m128i a2 = _mm_unpacklo_epi16(r4, r5);
+    __m128i b2 = _mm_unpackhi_epi16(r4, r5);
+    __m128i a3 = _mm_unpacklo_epi16(r6, r7);
+    __m128i b3 = _mm_unpackhi_epi16(r6, r7);
+    __m128i c0 = _mm_unpacklo_epi32(a0, a1);
+    __m128i c1 = _mm_unpackhi_epi32(a0, a1);
+    __m128i c2 = _mm_unpacklo_epi32(a2, a3);
+    __m128i c3 = _mm_unpackhi_epi32(a2, a3);
+    __m128i c4 = _mm_unpacklo_epi32(b0, b1);
+    __m128i c5 = _mm_unpackhi_epi32(b0, b1);
+    __m128i c6 = _mm_unpacklo_epi32(b2, b3);
+    __m128i c7 = _mm_unpackhi_epi32(b2, b3);
+    _mm_storeu_si128((__m128i *)(d), _mm_unpacklo_epi64(c0, c2));
+    _mm_storeu_si128((__m128i *)(d + ds), _mm_unpackhi_epi64(c0, c2));
+    _mm_storeu_si128((__m128i *)(d + 2 * ds), _mm_unpacklo_epi64(c1, c3));
+    _mm_storeu_si128((__m128i *)(d + 3 * ds), _mm_unpackhi_epi64(c1, c3));
+    _mm_storeu_si128((__m128i *)(d + 4 * ds), _mm_unpacklo_epi64(c4, c6));
+    _mm_storeu_si128((__m128i *)(d + 5 * ds), _mm_unpackhi_epi64(c4, c6));
+    _mm_storeu_si128((__m128i *)(d + 6 * ds), _mm_unpacklo_epi64(c5, c7));
+    _mm_storeu_si128((__m128i *)(d + 7 * ds), _mm_unpackhi_epi64(c5, c7));
+#else
+    uint16x8x2_t t01 = vtrnq_u16(vld1q_u16((const uint16_t *)(s)),
+                                 vld1q_u16((const uint16_t *)(s + ss)));
+    uint16x8x2_t t23 = vtrnq_u16(vld1q_u16((const uint16_t *)(s + 2 * ss)),
+                                 vld1q_u16((const uint16_t *)(s + 3 * ss)));
+    uint16x8x2_t t45 = vtrnq_u16(vld1q_u16((const uint16_t *)(s + 4 * ss)),
+                                 vld1q_u16((const uint16_t *)(s + 5 * ss)));
+    uint16x8x2_t t67 = vtrnq_u16(vld1q_u16((const uint16_t *)(s + 6 * ss)),
+                                 vld1q_u16((const uint16_t *)(s + 7 * ss)));
+    // columns 0/4, 2/6 and 1/5, 3/7 in the halves
+    uint32x4x2_t u0 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[0]), vreinterpretq_u32_u16(t23.val[0]));
+    uint32x4x2_t u1 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[1]), vreinterpretq_u32_u16(t23.val[1]));
+    uint32x4x2_t u2 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[0]), vreinterpretq_u32_u16(t67.val[0]));
+    uint32x4x2_t u3 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[1]), vreinterpretq_u32_u16(t67.val[1]));
+    vst1q_u32((uint32_t *)(d), vcombine_u32(vget_low_u32(u0.val[0]), vget_low_u32(u2.val[0])));
+    vst1q_u32((uint32_t *)(d + ds), vcombine_u32(vget_low_u32(u1.val[0]), vget_low_u32(u3.val[0])));
+    vst1q_u32((uint32_t *)(d + 2 * ds), vcombine_u32(vget_low_u32(u0.val[1]), vget_low_u32(u2.val[1])));
+    vst1q_u32((uint32_t *)(d + 3 * ds), vcombine_u32(vget_low_u32(u1.val[1]), vget_low_u32(u3.val[1])));
+    vst1q_u32((uint32_t *)(d + 4 * ds), vcombine_u32(vget_high_u32(u0.val[0]), vget_high_u32(u2.val[0])));
+    vst1q_u32((uint32_t *)(d + 5 * ds), vcombine_u32(vget_high_u32(u1.val[0]), vget_high_u32(u3.val[0])));
+    vst1q_u32((uint32_t *)(d + 6 * ds), vcombine_u32(vget_high_u32(u0.val[1]), vget_high_u32(u2.val[1])));
+    vst1q_u32((uint32_t *)(d + 7 * ds), vcombine_u32(vget_high_u32(u1.val[1]), vget_high_u32(u3.val[1])));
+#endif
+}
+
+// ... and for a 4x4 block of 32 bit pixels
+static inline void rotate_block32(uint8_t *d, int ds, const uint8_t *s, int ss) {
+#if defined(__SSE2__)
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(s));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(s + ss));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(s + 2 * ss));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(s + 3 * ss));
+    __m128i a0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i a1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i a2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i a3 = _mm_unpackhi_epi32(r2, r3);
+    _mm_storeu_si128((__m128i *)(d), _mm_unpacklo_epi64(a0, a1));
+    _mm_storeu_si128((__m128i *)(d + ds), _mm_unpackhi_epi64(a0, a1));
+    _mm_storeu_si128((__m128i *)(d + 2 * ds), _mm_unpacklo_epi64(a2, a3));
+    _mm_storeu_si128((__m128i *)(d + 3 * ds), _mm_unpackhi_epi64(a2, a3));
+#else
+    uint32x4x2_t a = vtrnq_u32(vld1q_u32((const uint32_t *)(s)),
+                               vld1q_u32((const uint32_t *)(s + ss)));
+    uint32x4x2_t b = vtrnq_u32(vld1q_u32((const uint32_t *)(s + 2 * ss)),
+                               vld1q_u32((const uint32_t *)(s + 3 * ss)));
+    vst1q_u32((uint32_t *)(d), vcombine_u32(vget_low_u32(a.val[0]), vget_low_u32(b.val[0])));
+    vst1q_u32((uint32_t *)(d + ds), vcombine_u32(vget_low_u32(a.val[1]), vget_low_u32(b.val[1])));
+    vst1q_u32((uint32_t *)(d + 2 * ds), vcombine_u32(vget_high_u32(a.val[0]), vget_high_u32(b.val[0])));
+    vst1q_u32((uint32_t *)(d + 3 * ds), vcombine_u32(vget_high_u32(a.val[1]), vget_high_u32(b.val[1])));
+#endif
+}
+
+// helper function to reverse a row of n pixels from s to d
+static void rotate_reverse_row(uint8_t *d, const uint8_t *s, int n, int bytes) {
+    int i = 0;
+    if (bytes == 2) {
+        uint16_t *dp = (uint16_t *)d;
+        const uint16_t *sp = (const uint16_t *)s;
+        for (; i + 8 <= n; i += 8) {
+#if defined(__SSE2__)
+            __m128i v = _mm_loadu_si128((const __m128i *)(sp + n - i - 8));
+            v = _mm_shufflelo_epi16(_mm_shufflehi_epi16(v, 0x1B), 0x1B);
+            _mm_storeu_si128((__m128i *)(dp + i), _mm_shuffle_epi32(v, 0x4E));
+#else
+            uint16x8_t v = vrev64q_u16(vld1q_u16(sp + n - i - 8));
+            vst1q_u16(dp + i, vcombine_u16(vget_high_u16(v), vget_low_u16(v)));
+#endif
+        }
+        for (; i < n; i++)
+            dp[i] = sp[n - 1 - i];
+        return;
+    }
+    if (bytes == 4) {
+        uint32_t *dp = (uint32_t *)d;
+        const uint32_t *sp = (const uint32_t *)s;
+        for (; i + 4 <= n; i += 4) {
+#if defined(__SSE2__)
+            __m128i v = _mm_loadu_si128((const __m128i *)(sp + n - i - 4));
+            _mm_storeu_si128((__m128i *)(dp + i), _mm_shuffle_epi32(v, 0x1B));
+#else
+            uint32x4_t v = vrev64q_u32(vld1q_u32(sp + n - i - 4));
+            vst1q_u32(dp + i, vcombine_u32(vget_high_u32(v), vget_low_u32(v)));
+#endif
+        }
+        for (; i < n; i++)
+            dp[i] = sp[n - 1 - i];
+        return;
+    }
+    for (; i < n; i++)
+        memcpy(d + i * bytes, s + (n - 1 - i) * bytes, bytes);
+}
+
+#else
+
+// helper function to reverse a row of n pixels from s to d
+static void rotate_reverse_row(uint8_t *d, const uint8_t *s, int n, int bytes) {
+    int i;
+    for (i = 0; i < n; i++)
+        memcpy(d + i * bytes, s + (n - 1 - i) * bytes, bytes);
+}
+
+#endif
+
+// helper function to rotate (transpose) a tile - the strides as in
+// rotate_block, the full 8x8 / 4x4 blocks with SIMD
+static void rotate_tile(uint8_t *d, int ds, const uint8_t *s, int ss,
+                        int w, int h, int bytes) {
+#if defined(ROT_HAVE_SIMD)
+    int b = (bytes == 2) ? 8 : (bytes == 4) ? 4 : 0;
+    if (b != 0) {
+        int bw = w - w % b;
+        int bh = h - h % b;
+        int i, j;
+        for (j = 0; j < bw; j += b) {
+            for (i = 0; i < bh; i += b) {
+                // block at source column j, row i -> destination row j, column i
+                if (bytes == 2)
+                    rotate_block16(d + j * ds + i * 2, ds, s + i * ss + j * 2, ss);
+                else
+                    rotate_block32(d + j * ds + i * 4, ds, s + i * ss + j * 4, ss);
+            }
+        }
+        // the edges that do not make a full block
+        if (bh < h)
+            rotate_block(d + bh * bytes, ds, s + bh * ss, ss, bw, h - bh, bytes);
+        if (bw < w)
+            rotate_block(d + bw * ds, ds, s + bw * bytes, ss, w - bw, h, bytes);
+        return;
+    }
+#endif
+    rotate_block(d, ds, s, ss, w, h, bytes);
+}
+
+// rotate the 'srect' part (0 = all) of the logical surface 'src' into
+// 'dst' - the physical page, src->height wide and src->width high for
+// 90 and 270 - to where it goes after the rotation. The formats have to
+// match. Returns 0, or EINVAL for a size / format mismatch
+int rotate(SURFACE_T *dst, const SURFACE_T *src, const RECT_T *srect, int rot) {
+    RECT_T bounds = { 0, 0, src->width, src->height };
+    RECT_T r;
+    int bytes = pix_fmt_bytes(src->fmt);
+    int lw = src->width;
+    int lh = src->height;
+    int tx, ty, y;
+
+    if (dst->fmt != src->fmt)
+        return EINVAL;
+    if ((rot == ROT_90) || (rot == ROT_270)) {
+        if ((dst->width < lh) || (dst->height < lw))
+            return EINVAL;
+    }
+    else if ((dst->width < lw) || (dst->height < lh)) {
+        return EINVAL;
+    }
+    if (!rect_intersect(&r, srect ? srect : &bounds, &bounds))
+        return 0;
+
+    switch (rot) {
+    case ROT_90:
+    case ROT_270:
+        for (ty = r.y; ty < r.y + r.h; ty += ROT_TILE) {
+            int th = (r.y + r.h - ty < ROT_TILE) ? r.y + r.h - ty : ROT_TILE;
+            for (tx = r.x; tx < r.x + r.w; tx += ROT_TILE) {
+                int tw = (r.x + r.w - tx < ROT_TILE) ? r.x + r.w - tx : ROT_TILE;
+                if (rot == ROT_90) {
+                    // logical column x is physical row x, bottom row first
+                    rotate_tile((uint8_t *)surface_pixel(dst, lh - ty - th, tx),
+                                dst->line_length,
+                                (const uint8_t *)surface_pixel(src, tx, ty + th - 1),
+                                -src->line_length, tw, th, bytes);
+                }
+                else {
+                    // logical column x is physical row lw - 1 - x
+                    rotate_tile((uint8_t *)surface_pixel(dst, ty, lw - 1 - tx),
+                                -dst->line_length,
+                                (const uint8_t *)surface_pixel(src, tx, ty),
+                                src->line_length, tw, th, bytes);
+                }
+            }
+        }
+        break;
+    case ROT_180:
+        for (y = r.y; y < r.y + r.h; y++) {
+            rotate_reverse_row((uint8_t *)surface_pixel(dst, lw - r.x - r.w, lh - 1 - y),
+                               (const uint8_t *)surface_pixel(src, r.x, y), r.w, bytes);
+        }
+        break;
+    default:
+        for (y = r.y; y < r.y + r.h; y++) {
+            memcpy(surface_pixel(dst, r.x, y), surface_pixel(src, r.x, y), r.w * bytes);
+        }
+        break;
+    }
+    return 0;
+}
+
+#endif // FBROTATE_H
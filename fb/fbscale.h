@@ -0,0 +1,368 @@
+/*
+ * fbscale.h
+ *
+ * Image scaling - a (part of a) surface scaled into a rectangle of
+ * another one, for example straight into the back page, with
+ * nearest neighbour, bilinear or box (averaging, for shrinking) filtering.
+ *
+ * The source position is stepped in 16.16 fixed point and everything
+ * that depends only on the column (source x, weight / span) is worked
+ * out once into tables before the rows - for the columns inside dst
+ * only, so zooming in costs no more than the visible part. Rows go
+ * through XRGB8888 row buffers (fbconv.h converts to and from other
+ * formats); each needed source row is converted and filtered
+ * horizontally only once - the bilinear filter keeps the last two - and
+ * the vertical pass has SSE2 and NEON versions. Nearest neighbour
+ * between surfaces of the same format copies pixels directly. Nothing
+ * is read back from dst.
+ *
+ * Usage:
+ *   RECT_T r;
+ *   scale_fit(&r, page.width, page.height, img.width, img.height);
+ *   scale(&page, &r, &img, 0, SCALE_BILINEAR);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBSCALE_H
+#define FBSCALE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "fbsurf.h"
+#include "fbconv.h"
+
+// filters
+#define SCALE_NEAREST 0
+#define SCALE_BILINEAR 1
+#define SCALE_BOX 2     // average of the covered pixels (nearest when enlarging)
+
+// helper function to get the largest rectangle with the aspect ratio of
+// a sw x sh image centered in a dw x dh area
+static inline void scale_fit(RECT_T *r, int dw, int dh, int sw, int sh) {
+    if ((long)dw * sh <= (long)dh * sw) { // full width
+        r->w = dw;
+        r->h = (int)((long)sh * dw / sw);
+    }
+    else {                                // full height
+        r->w = (int)((long)sw * dh / sh);
+        r->h = dh;
+    }
+    r->x = (dw - r->w) / 2;
+    r->y = (dh - r->h) / 2;
+}
+
+// helper function to interpolate between two XRGB8888 pixels, f = 0-255
+// (of b) - two channels at a time, the sums fit in their 16 bits
+static inline uint32_t scale_lerp(uint32_t a, uint32_t b, uint32_t f) {
+    uint32_t rb = (((a & 0xFF00FF) * (256 - f) + (b & 0xFF00FF) * f) >> 8) & 0xFF00FF;
+    uint32_t g = (((a & 0x00FF00) * (256 - f) + (b & 0x00FF00) * f) >> 8) & 0x00FF00;
+    return rb | g;
+}
+
+// interpolate two rows of XRGB8888 pixels with the same weight f (1-255)
+// - exactly what scale_lerp gives, top bytes cleared
+static void scale_lerp_row(uint32_t *out, const uint32_t *a, const uint32_t *b,
+                           int f, int n) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i fb = _mm_set1_epi16(f);
+    __m128i fa = _mm_set1_epi16(256 - f);
+    __m128i mask = _mm_set1_epi32(0x00FFFFFF);
+    for (; i + 4 <= n; i += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        // a * (256 - f) + b * f <= 255 * 256 - fits unsigned 16 bits
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), fa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), fb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), fa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), fb));
+        lo = _mm_srli_epi16(lo, 8);
+        hi = _mm_srli_epi16(hi, 8);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_and_si128(_mm_packus_epi16(lo, hi), mask));
+    }
+#elif defined(__ARM_NEON)
+    uint8x8_t fb = vdup_n_u8(f);
+    uint8x8_t fa = vdup_n_u8(256 - f); // f is never 0 here
+    uint32x4_t mask = vdupq_n_u32(0x00FFFFFF);
+    for (; i + 4 <= n; i += 4) {
+        uint8x16_t va = vreinterpretq_u8_u32(vld1q_u32(a + i));
+        uint8x16_t vb = vreinterpretq_u8_u32(vld1q_u32(b + i));
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), fa), vget_low_u8(vb), fb);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), fa), vget_high_u8(vb), fb);
+        uint8x16_t r = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+        vst1q_u32(out + i, vandq_u32(vreinterpretq_u32_u8(r), mask));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = scale_lerp(a[i], b[i], f);
+}
+
+// helper function to get source row 'sy' of the source rectangle as
+// XRGB8888 - without converting when the source already is that
+static inline const uint32_t *scale_src_row(const SURFACE_T *src, const RECT_T *sr,
+                                            int sy, uint32_t *buf) {
+    const uint8_t *p = (const uint8_t *)surface_pixel(src, sr->x, sr->y + sy);
+    if (src->fmt == PIX_FMT_XRGB8888)
+        return (const uint32_t *)p;
+    conv_to_xrgb(buf, p, sr->w, src->fmt, src->pal);
+    return buf;
+}
+
+// helper function to filter a source row horizontally to the dst width
+static void scale_bilinear_h(uint32_t *out, const uint32_t *s, const int *xs,
+                             const uint8_t *xf, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        int x = xs[i];
+        out[i] = xf[i] ? scale_lerp(s[x], s[x + 1], xf[i]) : (s[x] & 0xFFFFFF);
+    }
+}
+
+// helper function to add the pixels of the column spans of a source row
+// to the per column sums (r, g, b) - red and blue are summed together in
+// the halves of one word, which holds for spans of up to 256 pixels
+static void scale_box_h(uint32_t *acc, const uint32_t *s, const int *xs,
+                        const int *xe, int n) {
+    int i, x;
+    for (i = 0; i < n; i++) {
+        if (xe[i] - xs[i] <= 256) {
+            uint32_t rb = 0, g = 0;
+            for (x = xs[i]; x < xe[i]; x++) {
+                rb += s[x] & 0xFF00FF;
+                g += s[x] & 0x00FF00;
+            }
+            acc[i * 3] += rb >> 16;
+            acc[i * 3 + 1] += g >> 8;
+            acc[i * 3 + 2] += rb & 0xFFFF;
+        }
+        else {
+            for (x = xs[i]; x < xe[i]; x++) {
+                acc[i * 3] += (s[x] >> 16) & 0xFF;
+                acc[i * 3 + 1] += (s[x] >> 8) & 0xFF;
+                acc[i * 3 + 2] += s[x] & 0xFF;
+            }
+        }
+    }
+}
+
+// helper function for the rounded average of n pixels' channel sum -
+// in 64 bits (a thumbnail box can cover millions of pixels), at most 255
+static inline uint32_t scale_box_avg(uint32_t sum, uint32_t n) {
+    uint64_t v = ((uint64_t)sum + n / 2) / n;
+    return (v > 255) ? 255 : (uint32_t)v;
+}
+
+// helper function to get the source pixels [*s0, *s1) averaged for dst
+// pixel 'i' of 'n' - the one under its center when enlarging
+static inline void scale_box_span(int i, int n, int len, int64_t step, int *s0, int *s1) {
+    if (step <= 0x10000) {
+        *s0 = (i * step + step / 2) >> 16;
+        *s1 = *s0 + 1;
+        return;
+    }
+    *s0 = (i * step) >> 16;
+    *s1 = (i == n - 1) ? len : ((i + 1) * step) >> 16;
+}
+
+// scale the 'srect' part of 'src' (0 = all of it) to fill 'drect' of
+// 'dst' (0 = all of it) - clipped to dst. Returns 0, or EINVAL for an
+// empty source or destination rectangle / ENOMEM
+int scale(SURFACE_T *dst, const RECT_T *drect, const SURFACE_T *src,
+          const RECT_T *srect, int filter) {
+    RECT_T sbounds = { 0, 0, src->width, src->height };
+    RECT_T dbounds = { 0, 0, dst->width, dst->height };
+    RECT_T sr, dr, cr;
+    int dbytes = pix_fmt_bytes(dst->fmt);
+    int64_t xstep, ystep;
+    int *xs, *xe;
+    uint8_t *xf;
+    uint32_t *mem;
+    uint32_t *rows[2], *sbuf, *out, *acc = 0, *cnt = 0;
+    int ry[2] = { -1, -1 };
+    int cnt_rows = 0;
+    int x, y, x0, n, prev = -1;
+
+    if (!rect_intersect(&sr, srect ? srect : &sbounds, &sbounds))
+        return EINVAL;
+    dr = drect ? *drect : dbounds;
+    if ((dr.w <= 0) || (dr.h <= 0))
+        return EINVAL;
+    if (!rect_intersect(&cr, &dr, &dbounds))
+        return 0;
+    xstep = ((int64_t)sr.w << 16) / dr.w;
+    ystep = ((int64_t)sr.h << 16) / dr.h;
+    if ((filter == SCALE_BOX) && (xstep <= 0x10000) && (ystep <= 0x10000))
+        filter = SCALE_NEAREST;
+    // only the n visible columns x0 .. x0 + n - 1 of dr are worked out
+    // (a zoomed in dr can be far wider than dst)
+    x0 = cr.x - dr.x;
+    n = cr.w;
+
+    // column tables and row buffers in one block
+    xs = malloc(2 * n * sizeof(int) + n);
+    mem = malloc((3 * n + sr.w) * sizeof(uint32_t)
+                 + ((filter == SCALE_BOX) ? 4 * n * sizeof(uint32_t) : 0));
+    if ((xs == 0) || (mem == 0)) {
+        free(xs);
+        free(mem);
+        return ENOMEM;
+    }
+    xe = xs + n;
+    xf = (uint8_t *)(xs + 2 * n);
+    rows[0] = mem;
+    rows[1] = mem + n;
+    out = mem + 2 * n;
+    sbuf = mem + 3 * n;
+    if (filter == SCALE_BOX) {
+        acc = sbuf + sr.w;
+        cnt = acc + 3 * n;
+    }
+
+    // per visible column: the source x (relative to sr) and the weight of
+    // x + 1 - or for the box the source columns to average
+    for (x = 0; x < n; x++) {
+        int64_t sx;
+        switch (filter) {
+        case SCALE_BILINEAR:
+            sx = (x0 + x) * xstep + xstep / 2 - 0x8000; // pixel centers
+            if (sx < 0)
+                sx = 0;
+            xs[x] = sx >> 16;
+            xf[x] = (sx >> 8) & 0xFF;
+            if (xs[x] >= sr.w - 1) {
+                xs[x] = sr.w - 1;
+                xf[x] = 0;
+            }
+            break;
+        case SCALE_BOX:
+            scale_box_span(x0 + x, dr.w, sr.w, xstep, &xs[x], &xe[x]);
+            break;
+        default:
+            xs[x] = ((x0 + x) * xstep + xstep / 2) >> 16;
+            break;
+        }
+    }
+
+    for (y = cr.y; y < cr.y + cr.h; y++) {
+        uint8_t *d = (uint8_t *)surface_pixel(dst, cr.x, y);
+        const uint32_t *row = out;
+        int64_t sy;
+        int y0, f;
+
+        if (filter == SCALE_BILINEAR) {
+            sy = (y - dr.y) * ystep + ystep / 2 - 0x8000;
+            if (sy < 0)
+                sy = 0;
+            y0 = sy >> 16;
+            f = (sy >> 8) & 0xFF;
+            if (y0 >= sr.h - 1) {
+                y0 = sr.h - 1;
+                f = 0;
+            }
+            // the two rows filtered horizontally - usually one or both
+            // are there from the previous dst row
+            if (ry[1] == y0) {
+                uint32_t *t = rows[0];
+                rows[0] = rows[1];
+                rows[1] = t;
+                ry[1] = ry[0];
+                ry[0] = y0;
+            }
+            if (ry[0] != y0) {
+                scale_bilinear_h(rows[0], scale_src_row(src, &sr, y0, sbuf), xs, xf, n);
+                ry[0] = y0;
+            }
+            if (f == 0) {
+                row = rows[0];
+            }
+            else {
+                if (ry[1] != y0 + 1) {
+                    scale_bilinear_h(rows[1], scale_src_row(src, &sr, y0 + 1, sbuf), xs, xf, n);
+                    ry[1] = y0 + 1;
+                }
+                scale_lerp_row(out, rows[0], rows[1], f, n);
+            }
+        }
+        else if (filter == SCALE_BOX) {
+            int sy0, sy1;
+            scale_box_span(y - dr.y, dr.h, sr.h, ystep, &sy0, &sy1);
+            memset(acc, 0, 3 * n * sizeof(uint32_t));
+            for (y0 = sy0; y0 < sy1; y0++)
+                scale_box_h(acc, scale_src_row(src, &sr, y0, sbuf), xs, xe, n);
+            // divide by the pixel counts - the counts per column only
+            // change with the number of rows
+            if (sy1 - sy0 != cnt_rows) {
+                cnt_rows = sy1 - sy0;
+                for (x = 0; x < n; x++)
+                    cnt[x] = (xe[x] - xs[x]) * cnt_rows;
+            }
+            for (x = 0; x < n; x++) {
+                out[x] = (scale_box_avg(acc[x * 3], cnt[x]) << 16)
+                       | (scale_box_avg(acc[x * 3 + 1], cnt[x]) << 8)
+                       | scale_box_avg(acc[x * 3 + 2], cnt[x]);
+            }
+        }
+        else {
+            // a repeated source row is picked from the source again (or
+            // its converted pixels kept in 'out') - never read back from
+            // dst, that may be the screen
+            y0 = ((y - dr.y) * ystep + ystep / 2) >> 16;
+            if ((src->fmt == dst->fmt) && (dbytes != 1 || src->pal == dst->pal)) {
+                // no conversion - straight from the source row
+                const uint8_t *s = (const uint8_t *)surface_pixel(src, sr.x, sr.y + y0);
+                switch (dbytes) {
+                case 1:
+                    for (x = 0; x < n; x++)
+                        d[x] = s[xs[x]];
+                    break;
+                case 2:
+                    for (x = 0; x < n; x++)
+                        ((uint16_t *)d)[x] = ((const uint16_t *)s)[xs[x]];
+                    break;
+                case 3:
+                    for (x = 0; x < n; x++)
+                        memcpy(d + x * 3, s + xs[x] * 3, 3);
+                    break;
+                default:
+                    for (x = 0; x < n; x++)
+                        ((uint32_t *)d)[x] = ((const uint32_t *)s)[xs[x]];
+                    break;
+                }
+                continue;
+            }
+            if (y0 != prev) {
+                const uint32_t *s = scale_src_row(src, &sr, y0, sbuf);
+                for (x = 0; x < n; x++)
+                    out[x] = s[xs[x]];
+                prev = y0;
+            }
+        }
+
+        conv_from_xrgb(d, row, n, dst->fmt, dst->pal);
+    }
+
+    free(xs);
+    free(mem);
+    return 0;
+}
+
+#endif // FBSCALE_H
@@ -0,0 +1,194 @@
+/*
+ * fbsprite.h
+ *
+ * Run-length encoded transparent sprites - every row of the sprite is
+ * encoded once (at load time) as a list of runs: number of transparent
+ * pixels to skip, followed by number of opaque pixels to copy. The
+ * opaque pixels are stored packed, already converted to the format of
+ * the target surface, so drawing is just a memcpy per opaque run -
+ * no per-pixel color key tests.
+ *
+ * Usage:
+ *   SPRITE_T spr;
+ *   sprite_encode(&spr, &image, 0, BLACK, PIX_FMT_PAL8, 0);
+ *   sprite_draw(&screen, x, y, &spr);
+ *   sprite_free(&spr);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBSPRITE_H
+#define FBSPRITE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fbsurf.h"
+#include "fbblit.h"
+
+typedef struct {
+    uint16_t skip;    // transparent pixels before the run
+    uint16_t len;     // opaque pixels in the run
+} SPRITE_RUN_T;
+
+typedef struct {
+    int width;
+    int height;
+    PIX_FMT_T fmt;          // format of the stored pixels
+    const PALETTE_T *pal;   // ... and their palette (PIX_FMT_PAL8)
+    int *row_run;           // first run of each row (height + 1 entries)
+    int *row_pix;           // first stored pixel of each row
+    SPRITE_RUN_T *runs;
+    char *pixels;           // opaque pixels only, packed row by row
+} SPRITE_T;
+
+void sprite_free(SPRITE_T *spr) {
+    free(spr->row_run);
+    free(spr->row_pix);
+    free(spr->runs);
+    free(spr->pixels);
+    memset(spr, 0, sizeof(*spr));
+}
+
+// encode the 'r' part of 'src' (0 for all of it) - source pixels equal
+// to 'key' (raw source value as with BLIT_COLORKEY) are transparent, the
+// rest is converted to 'fmt' (with palette 'pal' for PIX_FMT_PAL8)
+// - returns 0, EINVAL or ENOMEM
+int sprite_encode(SPRITE_T *spr, const SURFACE_T *src, const RECT_T *r,
+                  uint32_t key, PIX_FMT_T fmt, const PALETTE_T *pal) {
+    RECT_T all = { 0, 0, src->width, src->height };
+    RECT_T sr = all;
+    int x, y, nruns = 0, npix = 0;
+    int sb = pix_fmt_bytes(src->fmt);
+    int db = pix_fmt_bytes(fmt);
+
+    memset(spr, 0, sizeof(*spr));
+    if ((r != 0) && !rect_intersect(&sr, r, &all))
+        return EINVAL;
+
+    // first pass: count the runs and the opaque pixels
+    for (y = 0; y < sr.h; y++) {
+        const uint8_t *sp = (const uint8_t *)surface_pixel(src, sr.x, sr.y + y);
+        x = 0;
+        while (x < sr.w) {
+            int x0 = x;
+            while ((x < sr.w) && (blit_raw_pixel(sp + x * sb, src->fmt) == key))
+                x++;
+            int x1 = x;
+            while ((x < sr.w) && (x - x1 < 0xFFFF)
+                   && (blit_raw_pixel(sp + x * sb, src->fmt) != key))
+                x++;
+            // long transparent stretches need 'empty' runs in between
+            nruns += 1 + (x1 - x0) / 0xFFFF;
+            npix += x - x1;
+        }
+    }
+
+    spr->width = sr.w;
+    spr->height = sr.h;
+    spr->fmt = fmt;
+    spr->pal = pal;
+    spr->row_run = malloc((sr.h + 1) * sizeof(int));
+    spr->row_pix = malloc((sr.h + 1) * sizeof(int));
+    spr->runs = malloc((nruns > 0 ? nruns : 1) * sizeof(SPRITE_RUN_T));
+    spr->pixels = malloc((npix > 0 ? npix : 1) * db);
+    if (!spr->row_run || !spr->row_pix || !spr->runs || !spr->pixels) {
+        sprite_free(spr);
+        return ENOMEM;
+    }
+
+    // second pass: store the runs and convert the opaque pixels
+    nruns = 0;
+    npix = 0;
+    for (y = 0; y < sr.h; y++) {
+        const uint8_t *sp = (const uint8_t *)surface_pixel(src, sr.x, sr.y + y);
+        spr->row_run[y] = nruns;
+        spr->row_pix[y] = npix;
+        x = 0;
+        while (x < sr.w) {
+            int x0 = x;
+            while ((x < sr.w) && (blit_raw_pixel(sp + x * sb, src->fmt) == key))
+                x++;
+            int x1 = x;
+            while ((x < sr.w) && (x - x1 < 0xFFFF)
+                   && (blit_raw_pixel(sp + x * sb, src->fmt) != key))
+                x++;
+            while (x1 - x0 > 0xFFFF) {
+                spr->runs[nruns].skip = 0xFFFF;
+                spr->runs[nruns].len = 0;
+                nruns++;
+                x0 += 0xFFFF;
+            }
+            spr->runs[nruns].skip = x1 - x0;
+            spr->runs[nruns].len = x - x1;
+            nruns++;
+            if (x > x1) {
+                conv_row((uint8_t *)spr->pixels + npix * db, fmt, pal,
+                         sp + x1 * sb, src->fmt, src->pal, x - x1);
+                npix += x - x1;
+            }
+        }
+    }
+    spr->row_run[sr.h] = nruns;
+    spr->row_pix[sr.h] = npix;
+    return 0;
+}
+
+// draw the sprite with its upper left corner at x,y - clipped to the
+// surface; converts on the fly if the surface format differs from the
+// sprite format (encode to the screen format to avoid that)
+void sprite_draw(SURFACE_T *dst, int x, int y, const SPRITE_T *spr) {
+    int db = pix_fmt_bytes(spr->fmt);
+    int ddb = pix_fmt_bytes(dst->fmt);
+    int same = (dst->fmt == spr->fmt)
+            && ((spr->fmt != PIX_FMT_PAL8) || (dst->pal == spr->pal) || (dst->pal == 0));
+    int row, i;
+
+    // visible rows
+    int r0 = (y < 0) ? -y : 0;
+    int r1 = (y + spr->height > dst->height) ? dst->height - y : spr->height;
+    // visible columns (relative to the sprite)
+    int cx0 = (x < 0) ? -x : 0;
+    int cx1 = (x + spr->width > dst->width) ? dst->width - x : spr->width;
+    if ((r0 >= r1) || (cx0 >= cx1))
+        return;
+
+    for (row = r0; row < r1; row++) {
+        uint8_t *dp = (uint8_t *)surface_pixel(dst, x, y + row);
+        const uint8_t *sp = (const uint8_t *)spr->pixels + spr->row_pix[row] * db;
+        int sx = 0;
+        for (i = spr->row_run[row]; i < spr->row_run[row + 1]; i++) {
+            int a, b;
+            sx += spr->runs[i].skip;
+            a = sx;
+            b = sx + spr->runs[i].len;
+            // clip the run to the visible columns
+            if (a < cx0)
+                a = cx0;
+            if (b > cx1)
+                b = cx1;
+            if (a < b) {
+                if (same)
+                    memcpy(dp + a * ddb, sp + (a - sx) * db, (b - a) * db);
+                else
+                    conv_row(dp + a * ddb, dst->fmt, dst->pal,
+                             sp + (a - sx) * db, spr->fmt, spr->pal, b - a);
+            }
+            sp += spr->runs[i].len * db;
+            sx += spr->runs[i].len;
+            if (sx >= cx1)
+                break;
+        }
+    }
+}
+
+#endif
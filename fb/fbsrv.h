@@ -0,0 +1,328 @@
+/*
+ * fbsrv.h
+ *
+ * Protocol and client side of the display server fbsrvd.c - the server
+ * owns /dev/fb0 (the mode, the console, the pages) and any number of
+ * programs draw to it at the same time through surfaces it hands out.
+ *
+ * A surface is a memfd the server creates, sizes and seals against
+ * resizing and passes to the client over the Unix socket (SCM_RIGHTS) -
+ * both map the same pages, so pixels are never copied between the
+ * processes. The client draws to the surface, tells the server what it
+ * changed (srv_damage) and the server composites the damaged areas of
+ * all surfaces into the back page (fbcomp.h) and flips. After the flip
+ * it sends a frame message: a client should not draw to a surface it
+ * has damaged before that, or the server may read a half drawn frame.
+ *
+ * Surfaces are in the screen's pixel format (srv.fmt).
+ *
+ * Usage:
+ *   SRV_CONN_T srv;
+ *   SURFACE_T s;
+ *   int id;
+ *   srv_connect(&srv, SRV_SOCKET_PATH);
+ *   id = srv_surface_create(&srv, &s, 100, 100, 320, 200, 1);
+ *   each frame: draw to s; srv_damage(&srv, id, &r); srv_wait_frame(&srv);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBSRV_H
+#define FBSRV_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fbsurf.h"
+
+#define SRV_SOCKET_PATH "/tmp/fbsrv.sock"
+
+// message types
+#define SRV_HELLO 1    // c->s: - ; s->c: screen width, height, fmt
+#define SRV_CREATE 2   // c->s: x, y, w, h, z ; s->c: id, line_length + the memfd (or err)
+#define SRV_STYLE 3    // c->s: id, opacity, flags, key (BLIT_COLORKEY), opaque (x, y, w, h)
+#define SRV_DAMAGE 4   // c->s: id, x, y, w, h (w 0 for all of it)
+#define SRV_MOVE 5     // c->s: id, x, y
+#define SRV_DESTROY 6  // c->s: id
+#define SRV_FRAME 7    // s->c: the damage sent so far is on the screen
+
+// one fixed size message both ways (SOCK_SEQPACKET keeps them apart)
+typedef struct {
+    int type;
+    int id;           // surface
+    int x;
+    int y;
+    int w;
+    int h;
+    int z;
+    int fmt;          // PIX_FMT_T
+    int line_length;
+    int opacity;
+    int flags;
+    uint32_t key;
+    int err;          // 0 or an errno value from the server
+} SRV_MSG_T;
+
+typedef struct {
+    int fd;           // the socket
+    int width;        // screen size and format
+    int height;
+    PIX_FMT_T fmt;
+    int frames;       // frame messages received but not waited for yet
+} SRV_CONN_T;
+
+// helper function to send a message, with a file descriptor if 'pass'
+// >= 0 - 'flags' for sendmsg
+static int srv_sendmsg(int sock, const SRV_MSG_T *msg, int pass, int flags) {
+    struct msghdr mh;
+    struct iovec iov;
+    char ctl[CMSG_SPACE(sizeof(int))];
+    memset(&mh, 0, sizeof(mh));
+    iov.iov_base = (void *)msg;
+    iov.iov_len = sizeof(*msg);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (pass >= 0) {
+        struct cmsghdr *cm;
+        memset(ctl, 0, sizeof(ctl));
+        mh.msg_control = ctl;
+        mh.msg_controllen = sizeof(ctl);
+        cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cm), &pass, sizeof(int));
+    }
+    if (sendmsg(sock, &mh, MSG_NOSIGNAL | flags) != sizeof(*msg))
+        return errno ? errno : EIO;
+    return 0;
+}
+
+// send a message, with a file descriptor if 'pass' >= 0 - returns 0 or errno
+int srv_send(int sock, const SRV_MSG_T *msg, int pass) {
+    return srv_sendmsg(sock, msg, pass, 0);
+}
+
+// send a message without waiting (the server to its clients - one that
+// does not read must not hold up the others) - returns 0, EAGAIN when
+// the other end's queue is full or errno
+int srv_post(int sock, const SRV_MSG_T *msg, int pass) {
+    int ret = srv_sendmsg(sock, msg, pass, MSG_DONTWAIT);
+    return (ret == EWOULDBLOCK) ? EAGAIN : ret;
+}
+
+// receive a message and the file descriptor passed with it (-1 if none,
+// 'pass' may be 0 to close any) - returns 0, EPIPE when the other end
+// has gone or errno
+int srv_recv(int sock, SRV_MSG_T *msg, int *pass) {
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    char ctl[CMSG_SPACE(sizeof(int))];
+    ssize_t n;
+    int fd = -1;
+    memset(&mh, 0, sizeof(mh));
+    iov.iov_base = msg;
+    iov.iov_len = sizeof(*msg);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctl;
+    mh.msg_controllen = sizeof(ctl);
+    n = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+    if (n == 0)
+        return EPIPE;
+    if (n < 0)
+        return errno;
+    for (cm = CMSG_FIRSTHDR(&mh); cm != 0; cm = CMSG_NXTHDR(&mh, cm)) {
+        if ((cm->cmsg_level == SOL_SOCKET) && (cm->cmsg_type == SCM_RIGHTS))
+            memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+    }
+    if (pass != 0)
+        *pass = fd;
+    else if (fd >= 0)
+        close(fd);
+    if (n != sizeof(*msg))
+        return EINVAL;
+    return 0;
+}
+
+// helper function to wait for the reply of a type - frame messages that
+// come in between are counted
+static int srv_reply(SRV_CONN_T *c, int type, SRV_MSG_T *msg, int *pass) {
+    int ret;
+    for (;;) {
+        ret = srv_recv(c->fd, msg, pass);
+        if (ret != 0)
+            return ret;
+        if (msg->type == type)
+            return msg->err;
+        if (msg->type == SRV_FRAME)
+            c->frames++;
+        if ((pass != 0) && (*pass >= 0))
+            close(*pass);
+    }
+}
+
+// connect to the server at 'path' - returns 0 or errno
+int srv_connect(SRV_CONN_T *c, const char *path) {
+    struct sockaddr_un addr;
+    SRV_MSG_T msg;
+    int ret;
+    memset(c, 0, sizeof(*c));
+    c->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (c->fd < 0)
+        return errno;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ret = errno;
+        close(c->fd);
+        return ret;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SRV_HELLO;
+    ret = srv_send(c->fd, &msg, -1);
+    if (ret == 0)
+        ret = srv_reply(c, SRV_HELLO, &msg, 0);
+    if (ret != 0) {
+        close(c->fd);
+        return ret;
+    }
+    c->width = msg.w;
+    c->height = msg.h;
+    c->fmt = msg.fmt;
+    return 0;
+}
+
+void srv_disconnect(SRV_CONN_T *c) {
+    close(c->fd);
+    c->fd = -1;
+}
+
+// get a w x h surface shown at x, y (z order as fbcomp.h) - maps it to
+// 's' and returns its id, or -errno
+int srv_surface_create(SRV_CONN_T *c, SURFACE_T *s, int x, int y, int w, int h, int z) {
+    SRV_MSG_T msg;
+    int fd = -1;
+    int ret;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SRV_CREATE;
+    msg.x = x;
+    msg.y = y;
+    msg.w = w;
+    msg.h = h;
+    msg.z = z;
+    ret = srv_send(c->fd, &msg, -1);
+    if (ret == 0)
+        ret = srv_reply(c, SRV_CREATE, &msg, &fd);
+    if ((ret == 0) && (fd < 0))
+        ret = EIO;
+    if (ret != 0) {
+        if (fd >= 0)
+            close(fd);
+        return -ret;
+    }
+    s->data = mmap(0, msg.line_length * h, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps it
+    if (s->data == MAP_FAILED) {
+        ret = errno;
+        msg.type = SRV_DESTROY;
+        srv_send(c->fd, &msg, -1);
+        return -ret;
+    }
+    s->width = w;
+    s->height = h;
+    s->line_length = msg.line_length;
+    s->fmt = msg.fmt;
+    s->pal = 0;
+    return msg.id;
+}
+
+// opacity (0-255), color key (flags BLIT_COLORKEY) and the part known to
+// be opaque (0 for all of it) of a surface - as fbcomp.h
+int srv_surface_style(SRV_CONN_T *c, int id, int opacity, int flags, uint32_t key,
+                      const RECT_T *opaque) {
+    SRV_MSG_T msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SRV_STYLE;
+    msg.id = id;
+    msg.opacity = opacity;
+    msg.flags = flags;
+    msg.key = key;
+    if (opaque != 0) {
+        msg.x = opaque->x;
+        msg.y = opaque->y;
+        msg.w = opaque->w;
+        msg.h = opaque->h;
+    }
+    else {
+        msg.w = -1; // all
+    }
+    return srv_send(c->fd, &msg, -1);
+}
+
+// tell the server a part of the surface changed (0 for all of it)
+int srv_damage(SRV_CONN_T *c, int id, const RECT_T *r) {
+    SRV_MSG_T msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SRV_DAMAGE;
+    msg.id = id;
+    if (r != 0) {
+        msg.x = r->x;
+        msg.y = r->y;
+        msg.w = r->w;
+        msg.h = r->h;
+    }
+    return srv_send(c->fd, &msg, -1);
+}
+
+int srv_move(SRV_CONN_T *c, int id, int x, int y) {
+    SRV_MSG_T msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SRV_MOVE;
+    msg.id = id;
+    msg.x = x;
+    msg.y = y;
+    return srv_send(c->fd, &msg, -1);
+}
+
+// give the surface back (and unmap it from 's')
+int srv_surface_destroy(SRV_CONN_T *c, int id, SURFACE_T *s) {
+    SRV_MSG_T msg;
+    munmap(s->data, s->line_length * s->height);
+    s->data = 0;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SRV_DESTROY;
+    msg.id = id;
+    return srv_send(c->fd, &msg, -1);
+}
+
+// wait until the server has shown what was damaged - returns 0 or errno
+int srv_wait_frame(SRV_CONN_T *c) {
+    SRV_MSG_T msg;
+    int ret;
+    if (c->frames == 0) {
+        ret = srv_reply(c, SRV_FRAME, &msg, 0);
+        if (ret != 0)
+            return ret;
+        c->frames++;
+    }
+    c->frames--;
+    return 0;
+}
+
+#endif // FBSRV_H
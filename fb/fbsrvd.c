@@ -0,0 +1,471 @@
+/*
+ * fbsrvd.c
+ *
+ * Display server: owns the framebuffer and lets several programs draw to
+ * it at once (fb/fbsrv.h). Each client surface is a sealed memfd shared
+ * with the client and is a layer of fbcomp.h - the damage the clients
+ * send is composited into the back page, the pages are flipped and the
+ * clients told the frame is out.
+ *
+ * The server never waits for a client: messages to the clients are sent
+ * without blocking - a client that does not read its replies is dropped,
+ * a frame message that does not fit is sent when the client reads again
+ * - and the damage is presented at least every FRAME_MS even if some
+ * client keeps sending.
+ *
+ * To build:
+ *   gcc -O2 -o fbsrvd fbsrvd.c
+ *
+ * Usage:
+ *   - to run
+ *        ./fbsrvd [socket path]
+ *   - then start clients (fbtestclient), Ctrl+C to quit
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+
+#include "fbcomp.h"
+#include "fbsrv.h"
+
+#define MAX_CLIENTS 32
+#define MAX_SURFACES COMP_MAX_LAYERS
+// biggest surface side accepted
+#define MAX_SURFACE_SIZE 4096
+// longest time damage waits for the clients to go quiet
+#define FRAME_MS 16
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+typedef struct {
+    int used;
+    int client;       // owner (index to clients)
+    int layer;        // fbcomp.h handle
+    SURFACE_T surf;   // shared memory mapping
+    size_t size;
+} SRV_SURFACE_T;
+
+typedef struct {
+    int fd;
+    int frame;        // sent damage, waits for a frame message
+    int stalled;      // owed a frame message its queue had no room for
+} SRV_CLIENT_T;
+
+SRV_SURFACE_T surfaces[MAX_SURFACES];
+SRV_CLIENT_T clients[MAX_CLIENTS];
+int num_clients = 0;
+COMP_T comp;
+
+volatile sig_atomic_t running = 1;
+
+// signal handler to end the main loop (poll returns EINTR)
+void sig_handler(int signo) {
+    running = 0;
+}
+
+// helper function to find a surface of a client - 0 if not its
+SRV_SURFACE_T *find_surface(int client, int id) {
+    if ((id < 0) || (id >= MAX_SURFACES))
+        return 0;
+    if (!surfaces[id].used || (surfaces[id].client != client))
+        return 0;
+    return &surfaces[id];
+}
+
+// helper function to make a shared surface - returns its id or -errno
+// (the memfd to pass to the client in 'memfd')
+int create_surface(int client, const SRV_MSG_T *msg, int *memfd) {
+    SRV_SURFACE_T *s;
+    int id, bpp, ret;
+    if ((msg->w <= 0) || (msg->h <= 0)
+        || (msg->w > MAX_SURFACE_SIZE) || (msg->h > MAX_SURFACE_SIZE))
+        return -EINVAL;
+    for (id = 0; id < MAX_SURFACES; id++) {
+        if (!surfaces[id].used)
+            break;
+    }
+    if (id == MAX_SURFACES)
+        return -ENOSPC;
+    s = &surfaces[id];
+    bpp = pix_fmt_bytes(pix_fmt_from_vinfo(&vinfo));
+    s->surf.width = msg->w;
+    s->surf.height = msg->h;
+    s->surf.line_length = (msg->w * bpp + 3) & ~3;
+    s->surf.fmt = pix_fmt_from_vinfo(&vinfo);
+    s->surf.pal = 0;
+    s->size = (size_t)s->surf.line_length * msg->h;
+
+    // sealed so that the client can not shrink it under our mapping
+    *memfd = memfd_create("fbsrv", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (*memfd < 0)
+        return -errno;
+    if ((ftruncate(*memfd, s->size) != 0)
+        || (fcntl(*memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)) {
+        ret = errno;
+        close(*memfd);
+        return -ret;
+    }
+    s->surf.data = mmap(0, s->size, PROT_READ, MAP_SHARED, *memfd, 0);
+    if (s->surf.data == MAP_FAILED) {
+        ret = errno;
+        close(*memfd);
+        return -ret;
+    }
+    s->layer = comp_layer_add(&comp, &s->surf, msg->x, msg->y, msg->z);
+    if (s->layer < 0) {
+        munmap(s->surf.data, s->size);
+        close(*memfd);
+        return -ENOSPC;
+    }
+    // a window until told otherwise
+    comp_layer_set_opaque(&comp, s->layer, 0);
+    s->used = 1;
+    s->client = client;
+    return id;
+}
+
+void destroy_surface(SRV_SURFACE_T *s) {
+    comp_layer_remove(&comp, s->layer);
+    munmap(s->surf.data, s->size);
+    s->used = 0;
+}
+
+// helper function to act on one message - returns 0 or errno when the
+// client should be dropped
+int handle_message(int client, const SRV_MSG_T *msg) {
+    SRV_MSG_T reply;
+    SRV_SURFACE_T *s = 0;
+    RECT_T r;
+    int fd = -1;
+    int ret;
+
+    memset(&reply, 0, sizeof(reply));
+    reply.type = msg->type;
+    if ((msg->type != SRV_HELLO) && (msg->type != SRV_CREATE)) {
+        s = find_surface(client, msg->id);
+        if (s == 0)
+            return EINVAL;
+    }
+    switch (msg->type) {
+    case SRV_HELLO:
+        reply.w = vinfo.xres;
+        reply.h = vinfo.yres;
+        reply.fmt = pix_fmt_from_vinfo(&vinfo);
+        return srv_post(clients[client].fd, &reply, -1);
+    case SRV_CREATE:
+        ret = create_surface(client, msg, &fd);
+        if (ret < 0) {
+            reply.err = -ret;
+        }
+        else {
+            reply.id = ret;
+            reply.w = surfaces[ret].surf.width;
+            reply.h = surfaces[ret].surf.height;
+            reply.fmt = surfaces[ret].surf.fmt;
+            reply.line_length = surfaces[ret].surf.line_length;
+        }
+        ret = srv_post(clients[client].fd, &reply, fd);
+        if (fd >= 0)
+            close(fd);  // the client has it now, the mapping keeps ours
+        return ret;
+    case SRV_STYLE:
+        comp_layer_set_opacity(&comp, s->layer, msg->opacity);
+        comp_layer_set_key(&comp, s->layer, msg->flags & BLIT_COLORKEY, msg->key);
+        r.x = msg->x;
+        r.y = msg->y;
+        r.w = msg->w;
+        r.h = msg->h;
+        comp_layer_set_opaque(&comp, s->layer, (msg->w < 0) ? 0 : &r);
+        return 0;
+    case SRV_DAMAGE:
+        if (msg->w != 0) {
+            RECT_T all = { 0, 0, s->surf.width, s->surf.height };
+            RECT_T d = { msg->x, msg->y, msg->w, msg->h };
+            if (rect_intersect(&r, &d, &all))
+                comp_layer_damage(&comp, s->layer, &r);
+        }
+        else {
+            comp_layer_damage(&comp, s->layer, 0);
+        }
+        clients[client].frame = 1;
+        return 0;
+    case SRV_MOVE:
+        comp_layer_move(&comp, s->layer, msg->x, msg->y);
+        return 0;
+    case SRV_DESTROY:
+        destroy_surface(s);
+        return 0;
+    }
+    return EINVAL;
+}
+
+void drop_client(int client) {
+    int i;
+    for (i = 0; i < MAX_SURFACES; i++) {
+        if (surfaces[i].used && (surfaces[i].client == client))
+            destroy_surface(&surfaces[i]);
+    }
+    close(clients[client].fd);
+    // keep the table packed - the last client takes this index
+    num_clients--;
+    if (client != num_clients) {
+        clients[client] = clients[num_clients];
+        for (i = 0; i < MAX_SURFACES; i++) {
+            if (surfaces[i].used && (surfaces[i].client == num_clients))
+                surfaces[i].client = client;
+        }
+    }
+}
+
+// helper function to send a client its frame message - it stays owed
+// (stalled) while the client's queue is full
+void send_frame(int client) {
+    SRV_MSG_T msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = SRV_FRAME;
+    clients[client].stalled = (srv_post(clients[client].fd, &msg, -1) == EAGAIN);
+}
+
+// helper function for milliseconds since 'start'
+long ms_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000L
+         + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+// helper function to composite the damage into the back page and flip
+void present() {
+    SURFACE_T page;
+    int i;
+
+    // change page to draw to (between 0 and 1)
+    cur_page = (cur_page + 1) % 2;
+    surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+    comp_compose(&comp, &page, cur_page, 0);
+
+    // switch page
+    vinfo.yoffset = cur_page * vinfo.yres;
+    vinfo.activate = FB_ACTIVATE_VBL;
+    if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+        printf("Error panning display.\n");
+    }
+
+    // one frame message covers any still owed
+    for (i = 0; i < num_clients; i++) {
+        if (clients[i].frame && !clients[i].stalled) {
+            clients[i].frame = 0;
+            send_frame(i);
+        }
+    }
+}
+
+// the server loop
+void serve(const char *path) {
+    struct sockaddr_un addr;
+    struct pollfd fds[MAX_CLIENTS + 1];
+    SRV_MSG_T msg;
+    int sock, i, n;
+    int dirty = 1;
+    struct timespec shown;
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        printf("Error creating socket (errno=%d).\n", errno);
+        return;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if ((bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        || (listen(sock, 8) != 0)) {
+        printf("Error listening on %s (errno=%d).\n", path, errno);
+        close(sock);
+        return;
+    }
+    printf("Listening on %s\n", path);
+
+    comp_init(&comp, vinfo.xres, vinfo.yres, 2, 0);
+    clock_gettime(CLOCK_MONOTONIC, &shown);
+
+    while (running) {
+        fds[0].fd = sock;
+        fds[0].events = POLLIN;
+        for (i = 0; i < num_clients; i++) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN | (clients[i].stalled ? POLLOUT : 0);
+        }
+        // take in everything the clients have sent before compositing, so
+        // one frame covers all of it - block only when there is nothing
+        // to show, and show it anyway when it has waited for a frame
+        n = poll(fds, num_clients + 1, dirty ? 0 : -1);
+        if (n < 0) {
+            if (errno != EINTR)
+                printf("Error polling (errno=%d).\n", errno);
+            continue;
+        }
+        if ((n == 0) || (dirty && (ms_since(&shown) >= FRAME_MS))) {
+            present();
+            dirty = 0;
+            clock_gettime(CLOCK_MONOTONIC, &shown);
+            if (n == 0)
+                continue;
+        }
+        // one message per client per round (backwards, as dropping moves
+        // the last client in place)
+        for (i = num_clients - 1; i >= 0; i--) {
+            if (fds[i + 1].revents == 0)
+                continue;
+            if ((fds[i + 1].revents & POLLOUT) && clients[i].stalled) {
+                send_frame(i);
+                if (!(fds[i + 1].revents & ~POLLOUT))
+                    continue;
+            }
+            if ((srv_recv(clients[i].fd, &msg, 0) != 0)
+                || (handle_message(i, &msg) != 0)) {
+                drop_client(i);
+            }
+            dirty = 1;
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(sock, 0, 0, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                if (num_clients < MAX_CLIENTS) {
+                    clients[num_clients].fd = fd;
+                    clients[num_clients].frame = 0;
+                    clients[num_clients].stalled = 0;
+                    num_clients++;
+                }
+                else {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    while (num_clients > 0)
+        drop_client(num_clients - 1);
+    close(sock);
+    unlink(path);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+    const char *path = (argc > 1) ? argv[1] : SRV_SOCKET_PATH;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // quit cleanly on Ctrl+C or kill
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // serve...
+        serve(path);
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
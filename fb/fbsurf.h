@@ -0,0 +1,203 @@
+/*
+ * fbsurf.h
+ *
+ * A minimal 'surface' - pointer to the pixels plus the dimensions and
+ * line length - used by the drawing helpers so that they can draw
+ * either to a page of the mmapped framebuffer or to an off-screen
+ * buffer in RAM.
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBSURF_H
+#define FBSURF_H
+
+#include <stdint.h>
+#include <string.h>
+#include <linux/fb.h>
+
+#include "fbfill.h"
+
+// pixel layouts used across the examples - note that the names
+// follow the byte order in memory
+typedef enum {
+    PIX_FMT_PAL8     = 0, // 8 bit palette index (fbtest5, fbtestXIII, ...)
+    PIX_FMT_RGB565   = 1, // 16 bit 5:6:5 (fbtest6 put_pixel_RGB565)
+    PIX_FMT_BGR888   = 2, // 24 bit framebuffer: b, g, r (fbtest6 put_pixel_RGB24)
+    PIX_FMT_RGB888   = 3, // 24 bit r, g, b as in P6 PPM and the raw files
+    PIX_FMT_XRGB8888 = 4  // 32 bit 0xXXRRGGBB (b, g, r, x in memory)
+} PIX_FMT_T;
+
+// a rectangle - note the width/height rather than the lower right corner
+typedef struct {
+    int x;
+    int y;
+    int w;
+    int h;
+} RECT_T;
+
+// palette for the 8 bit surfaces - 0xRRGGBB entries
+// (what FBIOPUTCMAP gets, just 8 bits per component)
+typedef struct {
+    uint32_t rgb[256];
+    int num;          // number of entries in use
+    const uint8_t *lut; // RGB565 value -> entry (fbquant.h), 0 = search
+} PALETTE_T;
+
+typedef struct {
+    char *data;       // the upper left pixel
+    int width;        // in pixels
+    int height;       // in pixels
+    int line_length;  // bytes from one row to the next (finfo.line_length)
+    PIX_FMT_T fmt;
+    const PALETTE_T *pal; // PIX_FMT_PAL8 only, may be 0
+} SURFACE_T;
+
+// helper function to get the bytes per pixel for a format
+static inline int pix_fmt_bytes(PIX_FMT_T fmt) {
+    switch (fmt) {
+    case PIX_FMT_PAL8:     return 1;
+    case PIX_FMT_RGB565:   return 2;
+    case PIX_FMT_XRGB8888: return 4;
+    default:               return 3;
+    }
+}
+
+// helper function to get the format matching the current video mode
+static inline PIX_FMT_T pix_fmt_from_vinfo(struct fb_var_screeninfo *vinfo) {
+    switch (vinfo->bits_per_pixel) {
+    case 8:  return PIX_FMT_PAL8;
+    case 16: return PIX_FMT_RGB565;
+    case 32: return PIX_FMT_XRGB8888;
+    default: return (vinfo->red.offset == 0) ? PIX_FMT_RGB888 : PIX_FMT_BGR888;
+    }
+}
+
+// helper function to describe one page of the framebuffer as a surface
+static inline void surface_from_fb(SURFACE_T *s, char *fbp, int page,
+                                   struct fb_var_screeninfo *vinfo,
+                                   struct fb_fix_screeninfo *finfo) {
+    s->data = fbp + page * finfo->line_length * vinfo->yres;
+    s->width = vinfo->xres;
+    s->height = vinfo->yres;
+    s->line_length = finfo->line_length;
+    s->fmt = pix_fmt_from_vinfo(vinfo);
+    s->pal = 0;
+}
+
+// helper function to describe a part of a surface as a surface of its own
+// (the rectangle has to be inside the parent)
+static inline void surface_sub(SURFACE_T *s, const SURFACE_T *parent,
+                               const RECT_T *r) {
+    s->data = parent->data + r->y * parent->line_length
+                           + r->x * pix_fmt_bytes(parent->fmt);
+    s->width = r->w;
+    s->height = r->h;
+    s->line_length = parent->line_length;
+    s->fmt = parent->fmt;
+    s->pal = parent->pal;
+}
+
+// helper function to get the address of a pixel
+static inline char *surface_pixel(const SURFACE_T *s, int x, int y) {
+    return s->data + y * s->line_length + x * pix_fmt_bytes(s->fmt);
+}
+
+// helper function to intersect two rectangles - returns 0 if they
+// do not overlap (and leaves an empty rectangle in 'out')
+static inline int rect_intersect(RECT_T *out, const RECT_T *a, const RECT_T *b) {
+    int x0 = (a->x > b->x) ? a->x : b->x;
+    int y0 = (a->y > b->y) ? a->y : b->y;
+    int x1 = (a->x + a->w < b->x + b->w) ? a->x + a->w : b->x + b->w;
+    int y1 = (a->y + a->h < b->y + b->h) ? a->y + a->h : b->y + b->h;
+    if ((x1 <= x0) || (y1 <= y0)) {
+        out->x = out->y = out->w = out->h = 0;
+        return 0;
+    }
+    out->x = x0;
+    out->y = y0;
+    out->w = x1 - x0;
+    out->h = y1 - y0;
+    return 1;
+}
+
+// helper function to test if two rectangles overlap
+static inline int rect_overlaps(const RECT_T *a, const RECT_T *b) {
+    return (a->x < b->x + b->w) && (b->x < a->x + a->w)
+        && (a->y < b->y + b->h) && (b->y < a->y + a->h);
+}
+
+// helper function to 'plot' a pixel - the color is the value as stored
+// in the surface (palette index, 5:6:5 value or 0xRRGGBB)
+static inline void surface_put_pixel(SURFACE_T *s, int x, int y, uint32_t c) {
+    char *p = surface_pixel(s, x, y);
+    switch (s->fmt) {
+    case PIX_FMT_PAL8:
+        *p = c;
+        break;
+    case PIX_FMT_RGB565:
+        *((uint16_t *)p) = c;
+        break;
+    case PIX_FMT_XRGB8888:
+        *((uint32_t *)p) = c;
+        break;
+    case PIX_FMT_BGR888:
+        p[0] = c;
+        p[1] = c >> 8;
+        p[2] = c >> 16;
+        break;
+    case PIX_FMT_RGB888:
+        p[0] = c >> 16;
+        p[1] = c >> 8;
+        p[2] = c;
+        break;
+    }
+}
+
+// helper function to fill a horizontal run of pixels - no clipping,
+// the span has to be inside the surface
+static inline void surface_fill_span(SURFACE_T *s, int x, int y, int w, uint32_t c) {
+    char *p = surface_pixel(s, x, y);
+    int i;
+    switch (s->fmt) {
+    case PIX_FMT_PAL8:
+        memset(p, c, w);
+        break;
+    case PIX_FMT_RGB565:
+        fill16_span((uint16_t *)p, w, fill16_solid(c), 0);
+        break;
+    case PIX_FMT_XRGB8888:
+        fill32_span((uint32_t *)p, w, c);
+        break;
+    default:
+        for (i = 0; i < w; i++)
+            surface_put_pixel(s, x + i, y, c);
+        break;
+    }
+}
+
+// helper function to fill a rectangle clipped to the surface
+static inline void surface_fill_rect(SURFACE_T *s, int x, int y, int w, int h, uint32_t c) {
+    RECT_T all = { 0, 0, s->width, s->height };
+    RECT_T r = { x, y, w, h };
+    int cy;
+    if (!rect_intersect(&r, &r, &all))
+        return;
+    if (s->fmt == PIX_FMT_RGB565) {
+        // full width rectangles become one span when there is no padding
+        fill16_rect(s->data, s->line_length, r.x, r.y, r.w, r.h, c);
+        return;
+    }
+    for (cy = r.y; cy < r.y + r.h; cy++)
+        surface_fill_span(s, r.x, cy, r.w, c);
+}
+
+#endif
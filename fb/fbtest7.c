@@ -3,6 +3,12 @@
  *
  * http://raspberrycompote.blogspot.ie/2013/04/low-level-graphics-on-raspberry-pi-part.html
  *
+ * The gradient is drawn in bands of rows on all cores (fbpar.h) - give
+ * the number of threads to use as an argument (1 for one core).
+ *
+ * To build:
+ *   gcc -O2 -o fbtest7 fbtest7.c -lm -lpthread
+ *
  * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
  *
  * Licensed under the Creative Commons Attribution 3.0 Unported License
@@ -22,6 +28,9 @@
 #include <fcntl.h>
 #include <linux/fb.h>
 #include <sys/mman.h>
+#include <time.h>
+
+#include "fbpar.h"
 
 // 'global' variables to store screen info
 char *fbp = 0;
@@ -56,9 +65,8 @@ void put_pixel_RGB565(int x, int y, int r, int g, int b)
 
 }
 
-// helper function for drawing - no more need to go mess with
-// the main function when just want to change what to draw...
-void draw() {
+// draw rows y0 .. y1 - 1 of the gradient (one band of par_for)
+void draw_rows(void *arg, int y0, int y1) {
 
     int x, y;
     int r, g, b;
@@ -67,7 +75,7 @@ void draw() {
     int cg = vinfo.yres / 3 + vinfo.yres / 4;
     int cb = vinfo.yres / 3 + vinfo.yres / 4 + vinfo.yres / 4;
 
-    for (y = 0; y < (vinfo.yres); y++) {
+    for (y = y0; y < y1; y++) {
         for (x = 0; x < vinfo.xres; x++) {
             dr = (int)sqrt((cr - x)*(cr - x)+(cr - y)*(cr - y));
             r = 255 - 256 * dr / cr;
@@ -90,6 +98,22 @@ void draw() {
 
 }
 
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    struct timespec pt;
+    struct timespec ct;
+
+    clock_gettime(CLOCK_MONOTONIC, &pt);
+    par_for(vinfo.yres, finfo.line_length, draw_rows, 0);
+    clock_gettime(CLOCK_MONOTONIC, &ct);
+    printf("drawn in %ld ms on %d threads\n",
+           (ct.tv_sec - pt.tv_sec) * 1000 + (ct.tv_nsec - pt.tv_nsec) / 1000000,
+           par_threads());
+
+}
+
 // application entry point
 int main(int argc, char* argv[])
 {
@@ -98,6 +122,10 @@ int main(int argc, char* argv[])
     struct fb_var_screeninfo orig_vinfo;
     long int screensize = 0;
 
+    // threads for drawing (0 = one per core)
+    if (par_init((argc > 1) ? atoi(argv[1]) : 0) != 0) {
+        printf("Could not start all threads.\n");
+    }
 
     // Open the file for reading and writing
     fbfd = open("/dev/fb0", O_RDWR);
@@ -149,6 +177,7 @@ int main(int argc, char* argv[])
     }
     // close fb file    
     close(fbfd);
+    par_exit();
 
     return 0;
   
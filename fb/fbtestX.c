@@ -23,6 +23,8 @@
 #include <sys/mman.h>
 #include <linux/kd.h>
 
+#include "fbwc.h"
+
 // 'global' variables to store screen info
 char *fbp = 0;
 struct fb_var_screeninfo vinfo;
@@ -52,7 +54,7 @@ void fill_rect(int x, int y, int w, int h, int c) {
 // helper function to clear the screen - fill whole 
 // screen with given color
 void clear_screen(int c) {
-    memset(fbp, c, vinfo.xres * vinfo.yres);
+    wc_fill(fbp, vinfo.xres * vinfo.yres, wc_pattern8(c));
 }
 
 // helper function for drawing - no more need to go mess with
@@ -22,6 +22,8 @@
 #include <linux/fb.h>
 #include <sys/mman.h>
 
+#include "fbwc.h"
+
 // 'global' variables to store screen info
 int fbfd = 0;
 char *fbp = 0;
@@ -55,7 +57,7 @@ void fill_rect(int x, int y, int w, int h, int c) {
 }
 
 void clear_screen(int c) {
-    memset(fbp + cur_page * page_size, c, page_size);
+    wc_fill(fbp + cur_page * page_size, page_size, wc_pattern8(c));
 }
 
 // helper function for drawing - no more need to go mess with
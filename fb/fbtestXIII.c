@@ -26,6 +26,8 @@
 #include "vcio.h"
 #include <time.h>
 
+#include "fbwc.h"
+
 // 'global' variables to store screen info
 int fbfd = 0;
 char *fbp = 0;
@@ -117,7 +119,7 @@ void fill_rect(int x, int y, int w, int h, int c) {
 }
 
 void clear_screen(int c) {
-    memset(fbp + cur_page * page_size, c, page_size);
+    wc_fill(fbp + cur_page * page_size, page_size, wc_pattern8(c));
 }
 
 // helper function for drawing - no more need to go mess with
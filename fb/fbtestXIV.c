@@ -28,6 +28,8 @@
 #include <linux/kd.h>
 #include <linux/ioctl.h>
 
+#include "fbwc.h"
+
 // 'global' variables to store screen info
 int fbfd = 0;
 char *fbp = 0;
@@ -69,7 +71,7 @@ void fill_rect(int x, int y, int w, int h, int c) {
 
 // helper to clear (fill with given color) the screen
 void clear_screen(int c) {
-    memset(fbp + cur_page * page_size, c, page_size);
+    wc_fill(fbp + cur_page * page_size, page_size, wc_pattern8(c));
 }
 
 // helper function for drawing - no more need to go mess with
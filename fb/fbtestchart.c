@@ -0,0 +1,232 @@
+/*
+ * fbtestchart.c
+ *
+ * Three strip charts (fbchart.h) of made-up telemetry - a few new
+ * samples per frame are drawn as new columns only, then the charts are
+ * copied to the screen - and the time both take.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestchart fbtestchart.c -lm
+ *
+ * Usage:
+ *   - to run
+ *        ./fbtestchart
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+#include <math.h>
+
+#include "fbmap.h"
+#include "fbchart.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+#define CHARTS 3
+#define PER_FRAME 3
+
+// 5:6:5 colors
+#define RGB565(r, g, b) ((((r) >> 3) << 11) | (((g) >> 2) << 5) | ((b) >> 3))
+
+// helper function for microseconds between two times
+static long usecs(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000L
+         + (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+// helper function for the next sample of chart i at time t
+static float sample(int i, long t) {
+    static float walk = 50.0f;
+    switch (i) {
+    case 0:
+        return 60.0f * sinf(t * 0.02f) + 15.0f * sinf(t * 0.31f);
+    case 1:
+        // a gap now and then
+        return ((t / 200) % 5 == 4) ? NAN : (float)(t % 150);
+    default:
+        walk += (rand() % 11) - 5;
+        if (walk < 0)
+            walk = 0;
+        if (walk > 100)
+            walk = 100;
+        return walk;
+    }
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    static const uint32_t colors[CHARTS] = {
+        RGB565(255, 255, 0), RGB565(0, 255, 255), RGB565(255, 96, 96)
+    };
+    static const float ranges[CHARTS][2] = {
+        { -80.0f, 80.0f }, { 0.0f, 150.0f }, { 0.0f, 100.0f }
+    };
+    CHART_T chart[CHARTS];
+    SURFACE_T screen;
+    struct timespec t0;
+    struct timespec t1;
+    float v[PER_FRAME];
+    long add_us = 0, present_us = 0;
+    long t = 0;
+    int i, j, k, frame;
+    int w = vinfo.xres - 40;
+    int h = (vinfo.yres - 20 * (CHARTS + 1)) / CHARTS;
+
+    surface_from_fb(&screen, fbp, 0, &vinfo, &finfo);
+    surface_fill_rect(&screen, 0, 0, screen.width, screen.height, RGB565(32, 32, 48));
+    for (i = 0; i < CHARTS; i++) {
+        if (chart_init(&chart[i], w, h, screen.fmt, ranges[i][0], ranges[i][1]) != 0) {
+            printf("Failed to malloc.\n");
+            while (--i >= 0)
+                chart_free(&chart[i]);
+            return;
+        }
+        chart[i].fg = colors[i];
+        chart[i].bg = RGB565(0, 0, 0);
+        chart[i].grid = RGB565(48, 64, 48);
+        chart[i].grid_x = 60;
+        chart[i].grid_y = h / 4;
+        chart_clear(&chart[i]);
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    // loop for a while
+    for (frame = 0; frame < (fps * secs); frame++) {
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < CHARTS; i++) {
+            for (k = 0; k < PER_FRAME; k++)
+                v[k] = sample(i, t + k);
+            chart_add(&chart[i], v, PER_FRAME);
+        }
+        t += PER_FRAME;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        add_us += usecs(t0, t1);
+
+        for (i = 0; i < CHARTS; i++)
+            chart_present(&chart[i], &screen, 20, 20 + i * (h + 20));
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        present_us += usecs(t1, t0);
+
+        // zoom out the first one for a while
+        if (frame == fps * secs / 2)
+            chart_range(&chart[0], -160.0f, 160.0f);
+
+        usleep(1000000 / fps);
+    }
+
+    printf("%d charts of %dx%d, %d samples each per frame:\n", CHARTS, w, h, PER_FRAME);
+    printf("  drawing %ld us, copying %ld us per frame\n",
+           add_us / frame, present_us / frame);
+
+    for (j = 0; j < CHARTS; j++)
+        chart_free(&chart[j]);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
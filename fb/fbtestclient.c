@@ -0,0 +1,150 @@
+/*
+ * fbtestclient.c
+ *
+ * A client of the display server fbsrvd.c: gets a window surface from
+ * the server, bounces a box in it and slides the window across the
+ * screen - only the box's old and new place are sent as damage, and
+ * the next frame is drawn once the server has shown the previous one.
+ * Start several at once to see them composited together.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestclient fbtestclient.c
+ *
+ * Usage:
+ *   - start ./fbsrvd first, then
+ *        ./fbtestclient [x y [socket path]]
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fbconv.h"
+#include "fbsrv.h"
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to get a 0xRRGGBB color in the surface format
+uint32_t raw_color(const SURFACE_T *s, uint32_t rgb) {
+    uint32_t c = 0;
+    conv_from_xrgb((uint8_t *)&c, &rgb, 1, s->fmt, 0);
+    return c;
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    SRV_CONN_T srv;
+    SURFACE_T win;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    int id, i, ret;
+    int wx = (argc > 2) ? atoi(argv[1]) : 100;
+    int wy = (argc > 2) ? atoi(argv[2]) : 100;
+    const char *path = (argc > 3) ? argv[3] : SRV_SOCKET_PATH;
+    int w = 240;
+    int h = 160;
+    int box = 32;
+    int bx = 0, by = 0, dbx = 3, dby = 2;
+    int dwx = 1;
+    uint32_t bg, fg;
+
+    ret = srv_connect(&srv, path);
+    if (ret != 0) {
+        printf("Error connecting to %s (errno=%d).\n", path, ret);
+        return ret;
+    }
+    printf("Screen %dx%d\n", srv.width, srv.height);
+
+    id = srv_surface_create(&srv, &win, wx, wy, w, h, 1);
+    if (id < 0) {
+        printf("Error creating surface (errno=%d).\n", -id);
+        srv_disconnect(&srv);
+        return -id;
+    }
+
+    srand(getpid());
+    bg = raw_color(&win, 0x202040 + (rand() & 0x3F3F3F));
+    fg = raw_color(&win, 0xFFFF00 ^ (rand() & 0x7F7F7F));
+    surface_fill_rect(&win, 0, 0, w, h, bg);
+    surface_fill_rect(&win, 0, 0, w, 8, raw_color(&win, 0x0000FF));
+    srv_damage(&srv, id, 0);
+    srv_wait_frame(&srv);
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // erase the box, move it and draw it again
+        RECT_T old = { bx, 8 + by, box, box };
+        surface_fill_rect(&win, old.x, old.y, box, box, bg);
+        bx += dbx;
+        by += dby;
+        if ((bx < 0) || (bx > w - box)) {
+            dbx = -dbx;
+            bx += 2 * dbx;
+        }
+        if ((by < 0) || (by > h - 8 - box)) {
+            dby = -dby;
+            by += 2 * dby;
+        }
+        RECT_T cur = { bx, 8 + by, box, box };
+        surface_fill_rect(&win, cur.x, cur.y, box, box, fg);
+        srv_damage(&srv, id, &old);
+        srv_damage(&srv, id, &cur);
+
+        // slide the window back and forth
+        wx += dwx;
+        if ((wx < 0) || (wx > srv.width - w)) {
+            dwx = -dwx;
+            wx += 2 * dwx;
+        }
+        srv_move(&srv, id, wx, wy);
+
+        // do not touch the surface before the server has shown it
+        ret = srv_wait_frame(&srv);
+        if (ret != 0) {
+            printf("Server gone (errno=%d).\n", ret);
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("%d frames in %ld s %5ld ms\n", i, df.tv_sec, df.tv_nsec / 1000000);
+
+    srv_surface_destroy(&srv, id, &win);
+    srv_disconnect(&srv);
+
+    return 0;
+
+}
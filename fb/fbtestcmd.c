@@ -0,0 +1,260 @@
+/*
+ * fbtestcmd.c
+ *
+ * The fbtestXIII bouncing rectangles (plus some fbtestXX lines, circles
+ * and text) drawn through the recorded command buffer in fbcmd.h - the
+ * frame is recorded first and then executed in one pass. At the end the
+ * last recorded frame is replayed a number of times to benchmark the
+ * execution.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestcmd fbtestcmd.c
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbcmd.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+#define NUM_ELEMS 200
+int xs[NUM_ELEMS];
+int ys[NUM_ELEMS];
+int dxs[NUM_ELEMS];
+int dys[NUM_ELEMS];
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// record one frame of the animation (and move the elements)
+void record_frame(CMDBUF_T *cb, int w, int h, int frame) {
+    int n, x;
+    char text[32];
+
+    // clear the previous image (= fill entire screen)
+    cmd_fill_rect(cb, 0, 0, vinfo.xres, vinfo.yres, 0);
+
+    // some static lines and circles
+    for (x = 0; x < vinfo.xres; x += 40) {
+        cmd_line(cb, 0, 0, x, vinfo.yres - 1, 2);
+    }
+    cmd_circle(cb, 3 * vinfo.xres / 4, vinfo.yres / 4, vinfo.yres / 6, 4);
+    cmd_fill_circle(cb, 3 * vinfo.xres / 4, 3 * vinfo.yres / 4, vinfo.yres / 8, 6);
+
+    for (n = 0; n < NUM_ELEMS; n++) {
+        // draw the bouncing rectangle
+        cmd_fill_rect(cb, xs[n], ys[n], w, h, (n % 15) + 1);
+
+        // move the rectangle
+        xs[n] += dxs[n];
+        ys[n] += dys[n];
+
+        // check for display sides
+        if ((xs[n] < 0) || (xs[n] > (vinfo.xres - w))) {
+            dxs[n] = -dxs[n]; // reverse direction
+            xs[n] += 2 * dxs[n]; // counteract the move already done above
+        }
+        // same for vertical dir
+        if ((ys[n] < 0) || (ys[n] > (vinfo.yres - h))) {
+            dys[n] = -dys[n];
+            ys[n] += 2 * dys[n];
+        }
+    }
+
+    sprintf(text, "FRAME %d", frame);
+    cmd_text(cb, FONTW, FONTH, text, 15);
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i, n, w, h;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    CMDBUF_T cb;
+    CMD_STATS_T stats;
+    SURFACE_T page;
+
+    cmdbuf_init(&cb);
+
+    // rectangle dimensions
+    w = vinfo.yres / 10;
+    h = w;
+
+    for (n = 0; n < NUM_ELEMS; n++) {
+        xs[n] = rand() % (vinfo.xres - w);
+        ys[n] = rand() % (vinfo.yres - h);
+        dxs[n] = (rand() % 10) + 1;
+        dys[n] = (rand() % 10) + 1;
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+
+        // record and execute the frame
+        cmdbuf_reset(&cb);
+        record_frame(&cb, w, h, i);
+        if (cmdbuf_execute(&cb, &page, 0, &stats) != 0) {
+            printf("Out of memory.\n");
+            break;
+        }
+
+        // switch page
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("done in %ld s %5ld ms\n", df.tv_sec, df.tv_nsec / 1000000);
+    printf("last frame: %d recorded, %d culled, %d merged, %d executed\n",
+           stats.recorded, stats.culled, stats.merged, stats.executed);
+
+    // replay the last frame into the current page for a benchmark
+    int replays = 1000;
+    clock_gettime(CLOCK_REALTIME, &pt);
+    for (i = 0; i < replays; i++) {
+        cmdbuf_execute(&cb, &page, 0, 0);
+    }
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("%d replays in %ld s %5ld ms\n", replays, df.tv_sec, df.tv_nsec / 1000000);
+
+    cmdbuf_free(&cb);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 8;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
@@ -0,0 +1,342 @@
+/*
+ * fbtestcomp.c
+ *
+ * Layers composited with fbcomp.h: a static background, bouncing ring
+ * sprites, an opaque 'window' and a translucent text panel updated every
+ * frame - only the damaged areas are recomposited into the back page and
+ * the layers hidden under opaque ones are not read at all.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestcomp fbtestcomp.c -lpthread
+ *
+ * Usage:
+ *   - to run
+ *        ./fbtestcomp [recording]
+ *   - with a file name the frames are also recorded to it (fbrec.h), to
+ *     be played back with fbreplay
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbcmd.h"
+#include "fbcomp.h"
+#include "fbrec.h"
+#include "fbmap.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+// frame recording (0 if not)
+FILE *recfp = 0;
+
+#define NUM_ELEMS 10
+int xs[NUM_ELEMS];
+int ys[NUM_ELEMS];
+int dxs[NUM_ELEMS];
+int dys[NUM_ELEMS];
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to allocate an RGB565 surface
+int make_surface(SURFACE_T *s, int w, int h) {
+    s->data = calloc(w * h, 2);
+    s->width = w;
+    s->height = h;
+    s->line_length = w * 2;
+    s->fmt = PIX_FMT_RGB565;
+    s->pal = 0;
+    return (s->data != 0);
+}
+
+// helper function to draw the background: a gradient with a grid
+void make_background(SURFACE_T *img) {
+    int x, y;
+    for (y = 0; y < img->height; y++) {
+        for (x = 0; x < img->width; x++) {
+            uint32_t c = ((x * 31 / img->width) << 11) | ((y * 63 / img->height) << 5) | 8;
+            if ((x % 40 == 0) || (y % 40 == 0))
+                c = 0x8410;
+            surface_put_pixel(img, x, y, c);
+        }
+    }
+}
+
+// helper function to draw a ring on transparent (0) background
+void make_ring(SURFACE_T *img, uint32_t c) {
+    int x, y;
+    int r = img->width / 2;
+    for (y = 0; y < img->height; y++) {
+        for (x = 0; x < img->width; x++) {
+            int dx = x - r;
+            int dy = y - r;
+            int d2 = dx * dx + dy * dy;
+            if ((d2 < r * r) && (d2 >= (r * 3 / 4) * (r * 3 / 4)))
+                surface_put_pixel(img, x, y, (dx + dy < -r / 2) ? 0xFFFF : c);
+        }
+    }
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i, n, w;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    SURFACE_T page;
+    SURFACE_T bg, ring[NUM_ELEMS], window, panel;
+    int ring_layer[NUM_ELEMS];
+    int panel_layer;
+    COMP_T comp;
+    COMP_STATS_T stats;
+    CMDBUF_T cb;
+    char text[32];
+    long written = 0, read = 0;
+    int occluded = 0;
+    REC_T rec;
+    COMP_DAMAGE_T damage;
+    uint32_t colors[] = { 0xF800, 0x07E0, 0x001F, 0xFFE0, 0xF81F, 0x07FF };
+
+    // ring dimensions
+    w = vinfo.yres / 8;
+
+    if (!make_surface(&bg, vinfo.xres, vinfo.yres)
+        || !make_surface(&window, vinfo.xres / 4, vinfo.yres / 3)
+        || !make_surface(&panel, 24 * FONTW, 3 * FONTH)) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    make_background(&bg);
+    surface_fill_rect(&window, 0, 0, window.width, window.height, 0x4208);
+    surface_fill_rect(&window, 4, 4, window.width - 8, FONTH + 4, 0x001F);
+
+    comp_init(&comp, vinfo.xres, vinfo.yres, 2, 0);
+    comp_layer_set_opaque(&comp, comp_layer_add(&comp, &bg, 0, 0, 0), 0);
+    for (n = 0; n < NUM_ELEMS; n++) {
+        if (!make_surface(&ring[n], w, w)) {
+            printf("Failed to malloc.\n");
+            return;
+        }
+        make_ring(&ring[n], colors[n % 6]);
+        xs[n] = rand() % (vinfo.xres - w);
+        ys[n] = rand() % (vinfo.yres - w);
+        dxs[n] = (rand() % 6) + 1;
+        dys[n] = (rand() % 6) + 1;
+        ring_layer[n] = comp_layer_add(&comp, &ring[n], xs[n], ys[n], 1);
+        comp_layer_set_key(&comp, ring_layer[n], BLIT_COLORKEY, 0);
+    }
+    // an opaque window over the rings, a translucent panel over it all
+    comp_layer_set_opaque(&comp, comp_layer_add(&comp, &window,
+                          vinfo.xres / 2, vinfo.yres / 3, 2), 0);
+    panel_layer = comp_layer_add(&comp, &panel, 16, 16, 3);
+    comp_layer_set_opacity(&comp, panel_layer, 160);
+
+    cmdbuf_init(&cb);
+
+    if ((recfp != 0) && (rec_open(&rec, recfp, vinfo.xres, vinfo.yres,
+                                  pix_fmt_from_vinfo(&vinfo)) != 0)) {
+        printf("Error starting recording.\n");
+        fclose(recfp);
+        recfp = 0;
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // move the rings
+        for (n = 0; n < NUM_ELEMS; n++) {
+            xs[n] += dxs[n];
+            ys[n] += dys[n];
+            if ((xs[n] < 0) || (xs[n] > (vinfo.xres - w))) {
+                dxs[n] = -dxs[n];
+                xs[n] += 2 * dxs[n];
+            }
+            if ((ys[n] < 0) || (ys[n] > (vinfo.yres - w))) {
+                dys[n] = -dys[n];
+                ys[n] += 2 * dys[n];
+            }
+            comp_layer_move(&comp, ring_layer[n], xs[n], ys[n]);
+        }
+
+        // update the text on the panel - only the text row is damaged
+        RECT_T text_rect = { FONTW, FONTH, 22 * FONTW, FONTH };
+        sprintf(text, "FRAME %d", i);
+        cmdbuf_reset(&cb);
+        cmd_fill_rect(&cb, text_rect.x, text_rect.y, text_rect.w, text_rect.h, 0);
+        cmd_text(&cb, text_rect.x, text_rect.y, text, 0xFFFF);
+        cmdbuf_execute(&cb, &panel, 0, 0);
+        comp_layer_damage(&comp, panel_layer, &text_rect);
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+        damage = comp.damage[cur_page];
+        comp_compose(&comp, &page, cur_page, &stats);
+        written += stats.pixels_written;
+        read += stats.pixels_read;
+        occluded += stats.layers_occluded;
+
+        // switch page
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+
+        // what was composited is all that can differ from the last frame
+        if (recfp != 0)
+            rec_frame(&rec, &page, damage.r, damage.num);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("done in %ld s %5ld ms\n", df.tv_sec, df.tv_nsec / 1000000);
+    printf("per frame: %ld pixels written, %ld read (screen %d), %d layer cells occluded\n",
+           written / i, read / i, vinfo.xres * vinfo.yres, occluded / i);
+    if (recfp != 0) {
+        if (rec_close(&rec) != 0)
+            printf("Error writing recording.\n");
+        printf("recorded %d frames (%d dropped), %ld kB, capture at most %ld us\n",
+               rec.frames, rec.dropped, rec.bytes / 1024, rec.max_capture_usec);
+    }
+
+    cmdbuf_free(&cb);
+    for (n = 0; n < NUM_ELEMS; n++)
+        free(ring[n].data);
+    free(bg.data);
+    free(window.data);
+    free(panel.data);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    if (argc > 1) {
+        recfp = fopen(argv[1], "wb");
+        if (recfp == 0) {
+            printf("Error opening %s.\n", argv[1]);
+            return(1);
+        }
+    }
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+    if (recfp != 0)
+        fclose(recfp);
+
+    return 0;
+
+}
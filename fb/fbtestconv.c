@@ -0,0 +1,99 @@
+/*
+ * fbtestconv.c
+ *
+ * Checks the pixel format conversion kernels of fbconv.h against each
+ * other and times each one the CPU supports converting full 1920x1080
+ * frames - no framebuffer needed.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestconv fbtestconv.c
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fbconv.h"
+
+#define WIDTH  1920
+#define HEIGHT 1080
+#define FRAMES 20
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to time FRAMES conversions of a whole frame, in us
+long time_conv(uint8_t *out, PIX_FMT_T ofmt, const uint8_t *in, PIX_FMT_T ifmt) {
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    int obpp = pix_fmt_bytes(ofmt);
+    int ibpp = pix_fmt_bytes(ifmt);
+    int i, y;
+
+    clock_gettime(CLOCK_MONOTONIC, &pt);
+    for (i = 0; i < FRAMES; i++) {
+        for (y = 0; y < HEIGHT; y++) {
+            conv_row(out + y * WIDTH * obpp, ofmt, 0,
+                     in + y * WIDTH * ibpp, ifmt, 0, WIDTH);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ct);
+    df = timediff(pt, ct);
+    return (df.tv_sec * 1000000 + df.tv_nsec / 1000) / FRAMES;
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+    uint8_t *a = malloc(WIDTH * HEIGHT * 4);
+    uint8_t *b = malloc(WIDTH * HEIGHT * 4);
+    int errors, i;
+    CONV_IMPL_ID_T id;
+
+    if ((a == 0) || (b == 0)) {
+        printf("Failed to malloc.\n");
+        return 1;
+    }
+    for (i = 0; i < WIDTH * HEIGHT * 4; i++)
+        a[i] = rand();
+
+    errors = conv_selftest();
+    printf("Self test: %d errors, using %s\n", errors, conv_impl()->name);
+
+    printf("us per %dx%d frame:  888->565  565->8888  8888->888\n", WIDTH, HEIGHT);
+    for (id = 0; id < CONV_NUM_IMPL; id++) {
+        if (conv_select(id) != 0)
+            continue;
+        printf("%-8s %20ld %10ld %10ld\n", conv_impl()->name,
+               time_conv(b, PIX_FMT_RGB565, a, PIX_FMT_RGB888),
+               time_conv(b, PIX_FMT_XRGB8888, a, PIX_FMT_RGB565),
+               time_conv(b, PIX_FMT_RGB888, a, PIX_FMT_XRGB8888));
+    }
+
+    free(a);
+    free(b);
+
+    return (errors != 0);
+}
@@ -0,0 +1,324 @@
+/*
+ * fbtestgrid.c
+ *
+ * The bouncing elements of fbtestXIII.c bouncing off each other too -
+ * two thousand of them by default. The grid (fbgrid.h) finds the
+ * colliding pairs, tells which areas changed and which elements are in
+ * them, so only the damaged areas are cleared and redrawn. The element
+ * under the middle of the screen (grid_hit) is drawn white.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestgrid fbtestgrid.c
+ *
+ * Usage:
+ *   - to run
+ *        ./fbtestgrid [elements]
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbconv.h"
+#include "fbgrid.h"
+#include "fbmap.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+#define ELEM_SIZE 8
+#define MAX_DAMAGE 64
+
+int num_elems;
+int *xs;
+int *ys;
+int *dxs;
+int *dys;
+
+GRID_T grid;
+int hit = -1;
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// two elements overlap - bounce them apart if they are coming closer
+// (equal masses: trade velocities)
+void collide(void *arg, int a, int b) {
+    int t;
+    int *count = arg;
+    if ((xs[b] - xs[a]) * (dxs[b] - dxs[a]) + (ys[b] - ys[a]) * (dys[b] - dys[a]) >= 0)
+        return;
+    t = dxs[a]; dxs[a] = dxs[b]; dxs[b] = t;
+    t = dys[a]; dys[a] = dys[b]; dys[b] = t;
+    (*count)++;
+}
+
+// helper function to redraw an area - background and the elements in it
+void redraw(SURFACE_T *page, const RECT_T *r, int *ids) {
+    int i, n;
+    RECT_T er, cr;
+    surface_fill_rect(page, r->x, r->y, r->w, r->h, 0);
+    n = grid_query(&grid, r, ids, num_elems);
+    for (i = 0; i < n; i++) {
+        er.x = xs[ids[i]];
+        er.y = ys[ids[i]];
+        er.w = ELEM_SIZE;
+        er.h = ELEM_SIZE;
+        if (rect_intersect(&cr, &er, r)) {
+            int c = ids[i] % 64;
+            uint32_t color = (ids[i] == hit) ? 0xffff
+                           : conv_rgb_to_565(255 - c * 2, 128 + c * 2, c * 4);
+            surface_fill_rect(page, cr.x, cr.y, cr.w, cr.h, color);
+        }
+    }
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i, n, x, y, dx, dy;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    SURFACE_T page;
+    RECT_T r;
+    RECT_T damage[MAX_DAMAGE];
+    RECT_T prev[MAX_DAMAGE];
+    RECT_T all;
+    int num_damage = 0, num_prev = 0;
+    int *ids;
+    long pairs = 0, bounces = 0;
+
+    if (grid_init(&grid, vinfo.xres, vinfo.yres, 5, num_elems) != 0) {
+        printf("Failed to set up the grid.\n");
+        return;
+    }
+    ids = malloc(num_elems * sizeof(int));
+    if (ids == 0) {
+        printf("Failed to malloc.\n");
+        grid_free(&grid);
+        return;
+    }
+
+    for (n = 0; n < num_elems; n++) {
+        xs[n] = rand() % (vinfo.xres - ELEM_SIZE);
+        ys[n] = rand() % (vinfo.yres - ELEM_SIZE);
+        dxs[n] = (rand() % 7) - 3;
+        dys[n] = (rand() % 7) - 3;
+        if ((dxs[n] == 0) && (dys[n] == 0))
+            dxs[n] = 1;
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_MONOTONIC, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // move the elements and tell the grid
+        for (n = 0; n < num_elems; n++) {
+            x = xs[n] + dxs[n];
+            y = ys[n] + dys[n];
+            dx = dxs[n];
+            dy = dys[n];
+
+            // check for display sides
+            if ((x < 0) || (x > (int)vinfo.xres - ELEM_SIZE)) {
+                dx = -dx; // reverse direction
+                x = x + 2 * dx; // counteract the move already done above
+            }
+            // same for vertical dir
+            if ((y < 0) || (y > (int)vinfo.yres - ELEM_SIZE)) {
+                dy = -dy;
+                y = y + 2 * dy;
+            }
+
+            xs[n] = x;
+            ys[n] = y;
+            dxs[n] = dx;
+            dys[n] = dy;
+            r.x = x;
+            r.y = y;
+            r.w = ELEM_SIZE;
+            r.h = ELEM_SIZE;
+            grid_set(&grid, n, &r);
+        }
+
+        // bounce off each other (for the next move)
+        pairs += grid_pairs(&grid, collide, &bounces);
+        hit = grid_hit(&grid, vinfo.xres / 2, vinfo.yres / 2);
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+
+        // the page is two frames old - redraw what changed in both
+        memcpy(prev, damage, num_damage * sizeof(RECT_T));
+        num_prev = num_damage;
+        num_damage = grid_damage(&grid, damage, MAX_DAMAGE);
+        if (i < 2) {
+            all.x = 0;
+            all.y = 0;
+            all.w = vinfo.xres;
+            all.h = vinfo.yres;
+            redraw(&page, &all, ids);
+        }
+        else {
+            for (n = 0; n < num_prev; n++)
+                redraw(&page, &prev[n], ids);
+            for (n = 0; n < num_damage; n++)
+                redraw(&page, &damage[n], ids);
+        }
+
+        // switch page
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ct);
+    df = timediff(pt, ct);
+    printf("done in %ld s %5ld ms\n", df.tv_sec, df.tv_nsec / 1000000);
+    printf("%d elements: %ld overlapping pairs, %ld bounces per frame\n",
+           num_elems, pairs / i, bounces / i);
+
+    free(ids);
+    grid_free(&grid);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    num_elems = (argc > 1) ? atoi(argv[1]) : 2000;
+    if (num_elems <= 0) {
+        printf("Usage: %s [elements]\n", argv[0]);
+        return 1;
+    }
+    xs = malloc(num_elems * sizeof(int));
+    ys = malloc(num_elems * sizeof(int));
+    dxs = malloc(num_elems * sizeof(int));
+    dys = malloc(num_elems * sizeof(int));
+    if ((xs == 0) || (ys == 0) || (dxs == 0) || (dys == 0)) {
+        printf("Failed to malloc.\n");
+        return 1;
+    }
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+    free(xs);
+    free(ys);
+    free(dxs);
+    free(dys);
+
+    return 0;
+
+}
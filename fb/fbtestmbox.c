@@ -0,0 +1,326 @@
+/*
+ * fbtestmbox.c
+ *
+ * The fbtestXIII page flipping with batched mailbox requests (fbmbox.h) -
+ * every frame the virtual offset, a rotated palette and the vsync wait
+ * go to the firmware in one property call instead of one call each.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestmbox fbtestmbox.c
+ *
+ * Usage:
+ *   ./fbtestmbox       - on the Pi (needs the mailbox device file, see below)
+ *   ./fbtestmbox stub  - checks the request building against the stand-in
+ *                        mailbox, no framebuffer needed
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbmbox.h"
+#include "fbwc.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+MBOX_T mb;
+int page_size = 0;
+int cur_page = 0;
+
+#define NUM_ELEMS 200
+int xs[NUM_ELEMS];
+int ys[NUM_ELEMS];
+int dxs[NUM_ELEMS];
+int dys[NUM_ELEMS];
+
+// colors 1-15 - rotated every frame
+uint32_t pal[15] = {
+    0x0000AC, 0x00AC00, 0x00ACAC, 0xAC0000, 0xAC00AC, 0xAC5400, 0xACACAC,
+    0x545454, 0x5454FF, 0x54FF54, 0x54FFFF, 0xFF5454, 0xFF54FF, 0xFFFF54,
+    0xFFFFFF
+};
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to draw a rectangle in given color
+void fill_rect(int x, int y, int w, int h, int c) {
+    int cy;
+    for (cy = 0; cy < h; cy++) {
+        memset(fbp + cur_page * page_size + (y + cy) * finfo.line_length + x, c, w);
+    }
+}
+
+void clear_screen(int c) {
+    wc_fill(fbp + cur_page * page_size, page_size, wc_pattern8(c));
+}
+
+// helper function to check the requests against the stand-in mailbox
+int test_stub() {
+    MBOX_REQ_T req;
+    unsigned x, y, w, h;
+    int errors = 0;
+
+    mbox_open_stub(&mb);
+    mbox_req_init(&req);
+    int hoffs = mbox_req_set_virtual_offset(&req, 0, 1080);
+    int hpal = mbox_req_set_palette(&req, 1, 15, pal);
+    int hblank = mbox_req_blank(&req, 0);
+    int hvsync = mbox_req_wait_vsync(&req);
+    int hsize = mbox_req_get_physical_size(&req);
+    int hbad = mbox_req_set_virtual_offset(&req, 0, 5000); // out of range
+
+    if (mbox_submit(&mb, &req) != 0) {
+        printf("submit failed\n");
+        return 1;
+    }
+    if ((mbox_resp_virtual_offset(&req, hoffs, &x, &y) != 0) || (x != 0) || (y != 1080)) {
+        printf("virtual offset: got %u,%u\n", x, y);
+        errors++;
+    }
+    if (mbox_resp_palette(&req, hpal) != 0) {
+        printf("palette rejected\n");
+        errors++;
+    }
+    if (mbox_stub_state.palette[15] != 0xFFFFFF) {
+        printf("palette entry 15 is 0x%08x\n", mbox_stub_state.palette[15]);
+        errors++;
+    }
+    if (mbox_stub_state.palette[1] != 0xAC0000) { // red in the lowest byte
+        printf("palette entry 1 is 0x%08x\n", mbox_stub_state.palette[1]);
+        errors++;
+    }
+    if ((mbox_resp_u32(&req, hblank, 0) != 0) || (mbox_resp_u32(&req, hvsync, 0) != 0)
+        || (mbox_stub_state.vsyncs != 1)) {
+        printf("blank/vsync not answered\n");
+        errors++;
+    }
+    if ((mbox_resp_physical_size(&req, hsize, &w, &h) != 0) || (w != 1920) || (h != 1080)) {
+        printf("physical size: got %ux%u\n", w, h);
+        errors++;
+    }
+    // the firmware keeps the old offset if the new one is out of range
+    if ((mbox_resp_virtual_offset(&req, hbad, &x, &y) != 0) || (y != 1080)) {
+        printf("out of range offset: got %u,%u\n", x, y);
+        errors++;
+    }
+    if (mb.submits != 1) {
+        printf("%d round trips instead of 1\n", mb.submits);
+        errors++;
+    }
+    // a full buffer is refused, not overrun
+    mbox_req_init(&req);
+    if ((mbox_req_set_palette(&req, 0, 256, pal) != -1)
+        && (mbox_req_set_palette(&req, 0, 256, pal) != -1)) {
+        printf("buffer overrun not detected\n");
+        errors++;
+    }
+
+    printf("%s (%d errors)\n", errors ? "FAILED" : "ok", errors);
+    return errors ? 1 : 0;
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i, n, w, h;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    MBOX_REQ_T req;
+
+    // rectangle dimensions
+    w = vinfo.yres / 10;
+    h = w;
+
+    for (n = 0; n < NUM_ELEMS; n++) {
+        xs[n] = rand() % (vinfo.xres - w);
+        ys[n] = rand() % (vinfo.yres - h);
+        dxs[n] = (rand() % 10) + 1;
+        dys[n] = (rand() % 10) + 1;
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+
+        // clear the previous image (= fill entire screen)
+        clear_screen(0);
+
+        for (n = 0; n < NUM_ELEMS; n++) {
+            // draw the bouncing rectangle
+            fill_rect(xs[n], ys[n], w, h, (n % 15) + 1);
+
+            // move the rectangle
+            xs[n] += dxs[n];
+            ys[n] += dys[n];
+
+            // check for display sides
+            if ((xs[n] < 0) || (xs[n] > (vinfo.xres - w))) {
+                dxs[n] = -dxs[n]; // reverse direction
+                xs[n] += 2 * dxs[n]; // counteract the move already done above
+            }
+            // same for vertical dir
+            if ((ys[n] < 0) || (ys[n] > (vinfo.yres - h))) {
+                dys[n] = -dys[n];
+                ys[n] += 2 * dys[n];
+            }
+        }
+
+        // rotate the palette
+        uint32_t tmp = pal[0];
+        memmove(&pal[0], &pal[1], 14 * sizeof(uint32_t));
+        pal[14] = tmp;
+
+        // switch page, set the palette and wait for vsync - one round trip
+        mbox_req_init(&req);
+        mbox_req_set_virtual_offset(&req, 0, cur_page * vinfo.yres);
+        mbox_req_set_palette(&req, 1, 15, pal);
+        mbox_req_wait_vsync(&req);
+        if (mbox_submit(&mb, &req) != 0) {
+            printf("Mailbox request failed.\n");
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("done in %ld s %5ld ms, %d mailbox round trips\n",
+           df.tv_sec, df.tv_nsec / 1000000, mb.submits);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    if ((argc > 1) && (strcmp(argv[1], "stub") == 0)) {
+        return test_stub();
+    }
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 8;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    page_size = finfo.line_length * vinfo.yres;
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap\n");
+    }
+    else if (mbox_open(&mb) != 0) {
+        printf("Failed to open the mailbox\n");
+    }
+    else {
+        // draw...
+        draw();
+        mbox_close(&mb);
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
@@ -0,0 +1,226 @@
+/*
+ * fbtestpart.c
+ *
+ * The bouncing rectangles of fbtestXIII.c as particles (fbpart.h) - a
+ * hundred thousand 2x2 points by default. Each frame the particles are
+ * moved in slices and drawn in bands of rows, both spread over the cores
+ * (fbpar.h), and the time of both phases is reported.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestpart fbtestpart.c -lpthread
+ *
+ * Usage:
+ *   - to run
+ *        ./fbtestpart [particles [threads]]
+ *   - threads 1 runs everything on one core
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbconv.h"
+#include "fbpart.h"
+#include "fbpar.h"
+#include "fbmap.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+#define PART_SIZE 2
+
+PART_T parts;
+RECT_T bounds;
+SURFACE_T page;
+
+// helper function for microseconds between two times
+static long usecs(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000L
+         + (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+// move a slice of the particles (one band of par_for)
+void update_slice(void *arg, int first, int last) {
+    part_update(&parts, first, last, &bounds);
+}
+
+// clear a band of rows and draw the particles in it (one band of par_for)
+void draw_band(void *arg, int y0, int y1) {
+    memset(page.data + y0 * page.line_length, 0, (y1 - y0) * page.line_length);
+    part_draw(&page, &parts, PART_SIZE, y0, y1);
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw(int num) {
+
+    int i, n;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec t0;
+    long update_us = 0, draw_us = 0;
+
+    if (part_init(&parts, num) != 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    bounds.x = 0;
+    bounds.y = 0;
+    bounds.w = vinfo.xres - PART_SIZE + 1;
+    bounds.h = vinfo.yres - PART_SIZE + 1;
+    for (n = 0; n < num; n++) {
+        int c = n % 64;
+        part_add(&parts, rand() % bounds.w, rand() % bounds.h,
+                 ((rand() % 801) - 400) / 100.0f, ((rand() % 801) - 400) / 100.0f,
+                 conv_rgb_to_565(255 - c * 2, 128 + c * 2, c * 4));
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_MONOTONIC, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+
+        // move - slices of the arrays that start on cache lines
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        par_for(parts.num, sizeof(float), update_slice, 0);
+        clock_gettime(CLOCK_MONOTONIC, &ct);
+        update_us += usecs(t0, ct);
+
+        // draw - bands of rows
+        par_for(page.height, page.line_length, draw_band, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        draw_us += usecs(ct, t0);
+
+        // switch page
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ct);
+    printf("done in %ld ms\n", usecs(pt, ct) / 1000);
+    printf("%d particles on %d threads, per frame: update %ld us, draw %ld us\n",
+           parts.num, par_threads(), update_us / i, draw_us / i);
+
+    part_free(&parts);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+    int num = (argc > 1) ? atoi(argv[1]) : 100000;
+
+    // threads (0 = one per core)
+    if (par_init((argc > 2) ? atoi(argv[2]) : 0) != 0) {
+        printf("Could not start all threads.\n");
+    }
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw(num);
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+    par_exit();
+
+    return 0;
+
+}
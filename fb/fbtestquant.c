@@ -0,0 +1,242 @@
+/*
+ * fbtestquant.c
+ *
+ * Shows a 24 bit P6 PPM image in an 8 bit mode: fbquant.h picks a 256
+ * color palette for the image and builds its inverse table, the palette
+ * goes to the display and the image is blitted (converted) to the screen
+ * - once searching the palette for every pixel and once with the table
+ * lookup, to compare.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestquant fbtestquant.c
+ *
+ * Usage:
+ *   ./fbtestquant [image.ppm]     (default ../img/test24.ppm)
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbblit.h"
+#include "fbquant.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to get the time since 'pt' in ms
+long elapsed_ms(struct timespec pt) {
+    struct timespec ct;
+    struct timespec df;
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    return df.tv_sec * 1000 + df.tv_nsec / 1000000;
+}
+
+// helper function to read a P6 PPM (depth 255) into an RGB888 surface
+int read_ppm(char *fpath, SURFACE_T *img) {
+    FILE *fp = fopen(fpath, "r");
+    int width, height, depth;
+    if (fp == 0) {
+        printf("Error opening file %s.\n", fpath);
+        return 0;
+    }
+    if ((fscanf(fp, "P6 %d %d %d", &width, &height, &depth) != 3)
+        || (depth != 255) || (fgetc(fp) == EOF)) {
+        printf("Not a 24 bit P6 ppm.\n");
+        fclose(fp);
+        return 0;
+    }
+    img->data = malloc(width * height * 3);
+    img->width = width;
+    img->height = height;
+    img->line_length = width * 3;
+    img->fmt = PIX_FMT_RGB888;
+    img->pal = 0;
+    if ((img->data == 0) || (fread(img->data, 3, width * height, fp) != width * height)) {
+        printf("Read data failed.\n");
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    return 1;
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw(SURFACE_T *img, PALETTE_T *pal) {
+
+    struct timespec pt;
+    SURFACE_T screen;
+    uint8_t *lut = malloc(QUANT_LUT_SIZE);
+
+    if (lut == 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    clock_gettime(CLOCK_REALTIME, &pt);
+    quant_lut_build(lut, pal);
+    printf("inverse palette in %ld ms\n", elapsed_ms(pt));
+
+    surface_from_fb(&screen, fbp, 0, &vinfo, &finfo);
+    screen.pal = pal;
+
+    // searching the palette for each pixel
+    pal->lut = 0;
+    clock_gettime(CLOCK_REALTIME, &pt);
+    blit(&screen, 0, 0, img, 0, 0, 0);
+    printf("blit with palette search in %ld ms\n", elapsed_ms(pt));
+    sleep(2);
+
+    // the same with the table lookup
+    memset(fbp, 0, finfo.line_length * vinfo.yres);
+    pal->lut = lut;
+    clock_gettime(CLOCK_REALTIME, &pt);
+    blit(&screen, 0, 0, img, 0, 0, 0);
+    printf("blit with inverse palette in %ld ms\n", elapsed_ms(pt));
+    sleep(5);
+
+    pal->lut = 0;
+    free(lut);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+    struct timespec pt;
+    SURFACE_T img;
+    PALETTE_T pal;
+
+    // quantize before touching the display
+    if (!read_ppm((argc > 1) ? argv[1] : "../img/test24.ppm", &img)) {
+        return(1);
+    }
+    clock_gettime(CLOCK_REALTIME, &pt);
+    if (quant_median_cut(&pal, 256, &img) != 0) {
+        printf("Failed to quantize.\n");
+        return(1);
+    }
+    printf("%dx%d image, %d colors in %ld ms\n", img.width, img.height,
+           pal.num, elapsed_ms(pt));
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 8;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // Set palette - the one picked for the image
+    if (quant_put_cmap(fbfd, &pal, 0) != 0) {
+        printf("Error setting palette.\n");
+    }
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw(&img, &pal);
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+    free(img.data);
+
+    return 0;
+
+}
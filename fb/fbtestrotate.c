@@ -0,0 +1,274 @@
+/*
+ * fbtestrotate.c
+ *
+ * Portrait mode on a landscape framebuffer with fbrotate.h: everything
+ * is drawn to a 'logical' surface standing on its side (yres x xres)
+ * and only the rectangles that changed - in this or the previous frame,
+ * as the pages alternate - are rotated (by 90 degrees unless told
+ * otherwise) into the back page.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestrotate fbtestrotate.c
+ *
+ * Usage:
+ *   ./fbtestrotate [90|180|270]
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbsurf.h"
+#include "fbrotate.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+int rot = ROT_90;
+
+#define NUM_ELEMS 10
+int xs[NUM_ELEMS];
+int ys[NUM_ELEMS];
+int dxs[NUM_ELEMS];
+int dys[NUM_ELEMS];
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to get the time since 'pt' in us
+long elapsed_us(struct timespec pt) {
+    struct timespec ct;
+    struct timespec df;
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    return df.tv_sec * 1000000 + df.tv_nsec / 1000;
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i, n, w;
+    struct timespec pt;
+    SURFACE_T page;
+    SURFACE_T logical;
+    RECT_T damage[2 * NUM_ELEMS];
+    RECT_T prev[2 * NUM_ELEMS];
+    int ndamage, nprev = 0;
+    long full_us = 0, damage_us = 0;
+    uint32_t colors[] = { 0xF800, 0x07E0, 0x001F, 0xFFE0, 0xF81F, 0x07FF };
+
+    // the logical surface - the physical one turned on its side
+    logical.width = (rot == ROT_180) ? vinfo.xres : vinfo.yres;
+    logical.height = (rot == ROT_180) ? vinfo.yres : vinfo.xres;
+    logical.line_length = logical.width * 2;
+    logical.fmt = PIX_FMT_RGB565;
+    logical.pal = 0;
+    logical.data = calloc(logical.line_length, logical.height);
+    if (logical.data == 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+
+    // rectangle dimensions
+    w = logical.width / 8;
+
+    for (n = 0; n < NUM_ELEMS; n++) {
+        xs[n] = rand() % (logical.width - w);
+        ys[n] = rand() % (logical.height - w);
+        dxs[n] = (rand() % 6) + 1;
+        dys[n] = (rand() % 6) + 1;
+    }
+    // a frame 'up' in the logical orientation
+    surface_fill_rect(&logical, 0, 0, logical.width, 8, 0xFFFF);
+    surface_fill_rect(&logical, 0, 0, 8, logical.height / 2, 0xFFFF);
+
+    // both pages once in full - and how long a full frame takes
+    for (i = 0; i < 2; i++) {
+        surface_from_fb(&page, fbp, i, &vinfo, &finfo);
+        clock_gettime(CLOCK_REALTIME, &pt);
+        rotate(&page, &logical, 0, rot);
+        full_us += elapsed_us(pt);
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // move the rectangles - the old and the new place are damaged
+        ndamage = 0;
+        for (n = 0; n < NUM_ELEMS; n++) {
+            RECT_T old = { xs[n], ys[n], w, w };
+            surface_fill_rect(&logical, xs[n], ys[n], w, w, 0);
+            xs[n] += dxs[n];
+            ys[n] += dys[n];
+            if ((xs[n] < 8) || (xs[n] > (logical.width - w))) {
+                dxs[n] = -dxs[n];
+                xs[n] += 2 * dxs[n];
+            }
+            if ((ys[n] < 8) || (ys[n] > (logical.height - w))) {
+                dys[n] = -dys[n];
+                ys[n] += 2 * dys[n];
+            }
+            damage[ndamage++] = old;
+        }
+        for (n = 0; n < NUM_ELEMS; n++) {
+            RECT_T cur = { xs[n], ys[n], w, w };
+            surface_fill_rect(&logical, xs[n], ys[n], w, w, colors[n % 6]);
+            damage[ndamage++] = cur;
+        }
+
+        // change page to draw to (between 0 and 1) - it is two frames
+        // behind, so it needs the previous frame's damage as well
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+        clock_gettime(CLOCK_REALTIME, &pt);
+        for (n = 0; n < nprev; n++)
+            rotate(&page, &logical, &prev[n], rot);
+        for (n = 0; n < ndamage; n++)
+            rotate(&page, &logical, &damage[n], rot);
+        damage_us += elapsed_us(pt);
+        memcpy(prev, damage, sizeof(damage));
+        nprev = ndamage;
+
+        // switch page
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+
+    printf("rotate %d: full frame %ld us, damaged parts %ld us per frame\n",
+           rot * 90, full_us / 2, damage_us / i);
+
+    free(logical.data);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    if (argc > 1) {
+        rot = atoi(argv[1]) / 90;
+        if ((rot < ROT_90) || (rot > ROT_270)) {
+            printf("Usage: %s [90|180|270]\n", argv[0]);
+            return(1);
+        }
+    }
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
@@ -0,0 +1,247 @@
+/*
+ * fbtestscale.c
+ *
+ * Zooming in and out of a 'photo' bigger than the screen with fbscale.h
+ * - every frame a part of the image is scaled (bilinear) to fill the
+ * back page, then a still of the whole image shrunk to fit (box filter).
+ *
+ * To build:
+ *   gcc -O2 -o fbtestscale fbtestscale.c
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbscale.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to draw the 'photo': color gradients, rings and a
+// fine checkerboard in the middle (shows the difference of the filters)
+void make_image(SURFACE_T *img) {
+    int x, y;
+    for (y = 0; y < img->height; y++) {
+        uint32_t *p = (uint32_t *)(img->data + y * img->line_length);
+        for (x = 0; x < img->width; x++) {
+            int dx = x - img->width / 2;
+            int dy = y - img->height / 2;
+            int d = (dx * dx + dy * dy) / 2000;
+            uint32_t c = ((x * 255 / img->width) << 16) | ((y * 255 / img->height) << 8)
+                         | ((d & 1) ? 0xC0 : 0x20);
+            if ((abs(dx) < 64) && (abs(dy) < 64))
+                c = ((x ^ y) & 1) ? 0xFFFFFF : 0;
+            p[x] = c;
+        }
+    }
+}
+
+// helper function to show the back page
+void flip() {
+    vinfo.yoffset = cur_page * vinfo.yres;
+    vinfo.activate = FB_ACTIVATE_VBL;
+    if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+        printf("Error panning display.\n");
+    }
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    SURFACE_T page;
+    SURFACE_T img;
+    RECT_T sr, r;
+
+    // the image - 2.5 times the screen size in XRGB8888
+    img.width = vinfo.xres * 5 / 2;
+    img.height = vinfo.yres * 5 / 2;
+    img.line_length = img.width * 4;
+    img.fmt = PIX_FMT_XRGB8888;
+    img.pal = 0;
+    img.data = malloc(img.line_length * img.height);
+    if (img.data == 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    make_image(&img);
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+
+    // loop for a while - zoom from 1:4 to 4:1 and back at the middle
+    for (i = 0; i < (fps * secs); i++) {
+        int t = i % (fps * secs / 2);
+        int z = (t < fps * secs / 4) ? t : fps * secs / 2 - t;
+        // visible part of the image: from the whole image to a quarter of the screen
+        sr.w = img.width - (long)(img.width - vinfo.xres / 4) * z / (fps * secs / 4);
+        sr.h = img.height - (long)(img.height - vinfo.yres / 4) * z / (fps * secs / 4);
+        sr.x = (img.width - sr.w) / 2;
+        sr.y = (img.height - sr.h) / 2;
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+        scale(&page, 0, &img, &sr, SCALE_BILINEAR);
+        flip();
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("bilinear: %d frames in %ld s %5ld ms\n", i, df.tv_sec, df.tv_nsec / 1000000);
+
+    // the whole image shrunk to fit - nearest and box
+    cur_page = (cur_page + 1) % 2;
+    surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+    memset(page.data, 0, page.line_length * page.height);
+    scale_fit(&r, page.width, page.height, img.width, img.height);
+    clock_gettime(CLOCK_REALTIME, &pt);
+    scale(&page, &r, &img, 0, SCALE_NEAREST);
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("nearest: %ld ms\n", df.tv_nsec / 1000000);
+    flip();
+    sleep(2);
+
+    cur_page = (cur_page + 1) % 2;
+    surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+    memset(page.data, 0, page.line_length * page.height);
+    clock_gettime(CLOCK_REALTIME, &pt);
+    scale(&page, &r, &img, 0, SCALE_BOX);
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("box: %ld ms\n", df.tv_nsec / 1000000);
+    flip();
+    sleep(2);
+
+    free(img.data);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
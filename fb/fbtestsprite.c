@@ -0,0 +1,274 @@
+/*
+ * fbtestsprite.c
+ *
+ * The fbtestXIII bouncing elements as transparent (ring shaped) sprites
+ * using the run-length encoded sprites in fbsprite.h - at the end the
+ * same sprite is drawn a number of times both with the color-keyed
+ * blit and as the RLE sprite to compare the timing.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestsprite fbtestsprite.c
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbsprite.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+#define NUM_ELEMS 200
+int xs[NUM_ELEMS];
+int ys[NUM_ELEMS];
+int dxs[NUM_ELEMS];
+int dys[NUM_ELEMS];
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to draw the sprite image: a ring with a 'shine'
+// on transparent (0) background - mostly transparent, like an icon
+void make_ring(SURFACE_T *img, int c) {
+    int x, y;
+    int r = img->width / 2;
+    memset(img->data, 0, img->line_length * img->height);
+    for (y = 0; y < img->height; y++) {
+        for (x = 0; x < img->width; x++) {
+            int dx = x - r;
+            int dy = y - r;
+            int d2 = dx * dx + dy * dy;
+            if ((d2 < r * r) && (d2 >= (r * 3 / 4) * (r * 3 / 4))) {
+                surface_put_pixel(img, x, y, (dx + dy < -r / 2) ? 15 : c);
+            }
+        }
+    }
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i, n, w, h;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    SURFACE_T page;
+    SPRITE_T sprites[15];
+
+    // element dimensions
+    w = vinfo.yres / 10;
+    h = w;
+
+    // one sprite per color
+    char *pixels = malloc(w * h);
+    if (pixels == 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    SURFACE_T img = { pixels, w, h, w, PIX_FMT_PAL8, 0 };
+    for (n = 0; n < 15; n++) {
+        make_ring(&img, n + 1);
+        if (sprite_encode(&sprites[n], &img, 0, 0, PIX_FMT_PAL8, 0) != 0) {
+            printf("Failed to encode sprite.\n");
+            return;
+        }
+    }
+
+    for (n = 0; n < NUM_ELEMS; n++) {
+        xs[n] = rand() % (vinfo.xres - w);
+        ys[n] = rand() % (vinfo.yres - h);
+        dxs[n] = (rand() % 10) + 1;
+        dys[n] = (rand() % 10) + 1;
+    }
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        // change page to draw to (between 0 and 1)
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+
+        // clear the previous image (= fill entire screen)
+        memset(page.data, 8, page.line_length * page.height);
+
+        for (n = 0; n < NUM_ELEMS; n++) {
+            // draw the bouncing sprite (may be partially outside)
+            sprite_draw(&page, xs[n], ys[n], &sprites[n % 15]);
+
+            // move the element
+            xs[n] += dxs[n];
+            ys[n] += dys[n];
+
+            // check for display sides - let the sprites go half way out
+            if ((xs[n] < -w / 2) || (xs[n] > (vinfo.xres - w / 2))) {
+                dxs[n] = -dxs[n]; // reverse direction
+                xs[n] += 2 * dxs[n]; // counteract the move already done above
+            }
+            // same for vertical dir
+            if ((ys[n] < -h / 2) || (ys[n] > (vinfo.yres - h / 2))) {
+                dys[n] = -dys[n];
+                ys[n] += 2 * dys[n];
+            }
+        }
+
+        // switch page
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("done in %ld s %5ld ms\n", df.tv_sec, df.tv_nsec / 1000000);
+
+    // compare color-keyed blit and RLE sprite
+    int draws = 100000;
+    clock_gettime(CLOCK_REALTIME, &pt);
+    for (i = 0; i < draws; i++) {
+        blit(&page, xs[i % NUM_ELEMS], ys[i % NUM_ELEMS], &img, 0, BLIT_COLORKEY, 0);
+    }
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("%d keyed blits in %ld s %5ld ms\n", draws, df.tv_sec, df.tv_nsec / 1000000);
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+    for (i = 0; i < draws; i++) {
+        sprite_draw(&page, xs[i % NUM_ELEMS], ys[i % NUM_ELEMS], &sprites[14]);
+    }
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("%d RLE sprites in %ld s %5ld ms\n", draws, df.tv_sec, df.tv_nsec / 1000000);
+
+    for (n = 0; n < 15; n++) {
+        sprite_free(&sprites[n]);
+    }
+    free(pixels);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 8;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
@@ -0,0 +1,273 @@
+/*
+ * fbtesttile.c
+ *
+ * Hardware scrolled tile map (see fbtile.h) - a map of fbtest5y style
+ * checkerboard and colored block tiles scrolled around with the pan
+ * offset, drawing only the tiles that come into view.
+ *
+ * To build:
+ *   gcc -O2 -o fbtesttile fbtesttile.c
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbtile.h"
+
+#define TILE 20     // tile size as in fbtest5y.c
+#define NUM_TILES 4
+#define MAP_W 128   // map size in tiles
+#define MAP_H 128
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+uint8_t map[MAP_W * MAP_H];
+
+static struct timespec timediff(struct timespec start, struct timespec end) {
+  struct timespec temp;
+  if ((end.tv_nsec - start.tv_nsec) < 0) {
+    temp.tv_sec = end.tv_sec - start.tv_sec - 1;
+    temp.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
+  }
+  else {
+    temp.tv_sec = end.tv_sec - start.tv_sec;
+    temp.tv_nsec = end.tv_nsec - start.tv_nsec;
+  }
+  return temp;
+}
+
+// helper function to draw the tile set: black, blue, a small
+// checkerboard and the fbtest5y colored block (custom colors 16+)
+void make_tiles(SURFACE_T *tiles) {
+    int n, x, y;
+    for (n = 0; n < NUM_TILES; n++) {
+        for (y = 0; y < TILE; y++) {
+            for (x = 0; x < TILE; x++) {
+                int c;
+                switch (n) {
+                case 0: c = 0; break;
+                case 1: c = 1; break;
+                case 2: c = ((x / 5 + y / 5) % 2) ? 1 : 9; break;
+                default: c = 16 + (y % 16); break;
+                }
+                surface_put_pixel(tiles, n * TILE + x, y, c);
+            }
+        }
+    }
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    int i, x, y;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec df;
+    SURFACE_T canvas;
+    TILEMAP_T tm;
+
+    char *pixels = malloc(NUM_TILES * TILE * TILE);
+    if (pixels == 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    SURFACE_T tiles = { pixels, NUM_TILES * TILE, TILE, NUM_TILES * TILE, PIX_FMT_PAL8, 0 };
+    make_tiles(&tiles);
+
+    // checkerboard with random colored blocks
+    for (y = 0; y < MAP_H; y++) {
+        for (x = 0; x < MAP_W; x++) {
+            map[y * MAP_W + x] = ((x + y) % 2) ? (rand() % 8 == 0 ? 3 : 1) : (rand() % 8 == 0 ? 2 : 0);
+        }
+    }
+
+    // the whole virtual framebuffer is the canvas
+    canvas.data = fbp;
+    canvas.width = vinfo.xres_virtual;
+    canvas.height = vinfo.yres_virtual;
+    canvas.line_length = finfo.line_length;
+    canvas.fmt = PIX_FMT_PAL8;
+    canvas.pal = 0;
+    if (tilemap_init(&tm, &canvas, vinfo.xres, vinfo.yres, &tiles, TILE, TILE,
+                     map, MAP_W, MAP_H, TILE_SCROLL_X | TILE_SCROLL_Y) != 0) {
+        printf("Virtual framebuffer too small.\n");
+        free(pixels);
+        return;
+    }
+
+    int fps = 60;
+    int secs = 10;
+    long total = 0;
+    // tiles a full redraw would need every frame
+    int full = (vinfo.xres / TILE + 1) * (vinfo.yres / TILE + 1);
+
+    clock_gettime(CLOCK_REALTIME, &pt);
+
+    // loop for a while - diagonal scroll, turning every 2 seconds
+    int camx = 0, camy = 0, dx = 3, dy = 1;
+    for (i = 0; i < (fps * secs); i++) {
+        if ((i % (2 * fps)) == 0) {
+            dy = -dy;
+        }
+        camx += dx;
+        camy += dy;
+
+        tilemap_scroll_to(&tm, camx, camy);
+        total += tm.tiles_drawn;
+
+        if (tilemap_pan(&tm, fbfd, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ct);
+    df = timediff(pt, ct);
+    printf("done in %ld s %5ld ms\n", df.tv_sec, df.tv_nsec / 1000000);
+    printf("%ld tiles drawn (full redraws would be %ld)\n", total, (long)full * fps * secs);
+
+    free(pixels);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+    int vw, vh;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info - the virtual size is what the tile map needs
+    vinfo.bits_per_pixel = 8;
+    vinfo.xres = 640;
+    vinfo.yres = 360;
+    tile_virtual_size(vinfo.xres, vinfo.yres, TILE, TILE,
+                      TILE_SCROLL_X | TILE_SCROLL_Y, &vw, &vh);
+    vinfo.xres_virtual = vw;
+    vinfo.yres_virtual = vh;
+    vinfo.xoffset = 0;
+    vinfo.yoffset = 0;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+    // check what we really got
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Virtual %dx%d\n", vinfo.xres_virtual, vinfo.yres_virtual);
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // Set palette - red-yellow gradient after the default 16 colors
+    unsigned short r[256];
+    unsigned short g[256];
+    unsigned short b[256];
+    memset(r, 0, sizeof(r));
+    memset(g, 0, sizeof(g));
+    memset(b, 0, sizeof(b));
+    int i;
+    for (i = 0; i < 16; i++) {
+        r[i] = 255 << 8;
+        g[i] = ((15 - i) * 16) << 8;
+        b[i] = 0;
+    }
+    struct fb_cmap pal;
+    pal.start = 16; // start our colors after the default 16
+    pal.len = 256; // kludge to force bcm fb drv to commit palette...
+    pal.red = r;
+    pal.green = g;
+    pal.blue = b;
+    pal.transp = 0; // we want all colors non-transparent == null
+    if (ioctl(fbfd, FBIOPUTCMAP, &pal)) {
+        printf("Error setting palette.\n");
+    }
+
+    // map fb to user mem
+    screensize = finfo.smem_len;
+    fbp = (char*)mmap(0,
+              screensize,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
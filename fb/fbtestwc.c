@@ -0,0 +1,218 @@
+/*
+ * fbtestwc.c
+ *
+ * Benchmark of the framebuffer fill and copy methods (fbwc.h) on this
+ * machine - clears and copies whole pages (1920x1080 16 bit if the
+ * driver allows, the current size otherwise) with each method and
+ * prints the time and bandwidth, then lets wc_tune pick one and flips
+ * through a few cleared pages with it.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestwc fbtestwc.c
+ *
+ * Usage:
+ *   - to run
+ *        ./fbtestwc
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbmap.h"
+#include "fbwc.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+int cur_page = 0;
+
+#define ROUNDS 20
+
+// helper function for microseconds since 'start'
+static long usecs(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000L
+         + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+// helper function to print a result
+static void report(const char *what, int method, long us, long bytes) {
+    printf("  %-6s %-6s %6ld us per page, %5ld MB/s\n", what, wc_name(method),
+           us / ROUNDS, (us > 0) ? bytes * ROUNDS / us : 0);
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    struct timespec t0;
+    SURFACE_T page;
+    SURFACE_T shadow;
+    int m, i;
+    long us;
+    long page_size = finfo.line_length * vinfo.yres;
+
+    // the source for the copies - the same layout as a page
+    surface_from_fb(&page, fbp, 0, &vinfo, &finfo);
+    if (map_surface(&shadow, page.width, page.height, page.fmt) != 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    for (i = 0; i < shadow.height; i++)
+        memset(shadow.data + i * shadow.line_length, i, shadow.line_length);
+
+    printf("%dx%d, %ld bytes per page\n", vinfo.xres, vinfo.yres, page_size);
+    for (m = 0; m < WC_METHODS; m++) {
+        if (!wc_available(m))
+            continue;
+        wc_method = m;
+
+        // clear to a color that is not all one byte (no memset shortcut)
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < ROUNDS; i++)
+            wc_fill(fbp + (i & 1) * page_size, page_size, wc_pattern16(0x1234 + i));
+        report("clear", m, usecs(&t0), page_size);
+
+        // the shadow image to the page
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < ROUNDS; i++) {
+            surface_from_fb(&page, fbp, i & 1, &vinfo, &finfo);
+            wc_present(&page, &shadow, 0);
+        }
+        report("copy", m, usecs(&t0), page_size);
+    }
+
+    m = wc_tune(fbp, page_size, 0);
+    printf("wc_tune picked '%s'\n", wc_name(m));
+
+    // flip through some cleared pages with it
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < 120; i++) {
+        cur_page = (cur_page + 1) % 2;
+        surface_from_fb(&page, fbp, cur_page, &vinfo, &finfo);
+        wc_fill(page.data, page_size, wc_pattern16((i & 0x1F) << 11));
+        vinfo.yoffset = cur_page * vinfo.yres;
+        vinfo.activate = FB_ACTIVATE_VBL;
+        if (ioctl(fbfd, FBIOPAN_DISPLAY, &vinfo)) {
+            printf("Error panning display.\n");
+        }
+    }
+    us = usecs(&t0);
+    printf("120 frames in %ld ms\n", us / 1000);
+
+    map_surface_free(&shadow);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info - 1080p if possible
+    vinfo.bits_per_pixel = 16;
+    vinfo.xres = 1920;
+    vinfo.yres = 1080;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres * 2;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+        printf("No 1920x1080, staying at %dx%d.\n", orig_vinfo.xres, orig_vinfo.yres);
+        memcpy(&vinfo, &orig_vinfo, sizeof(struct fb_var_screeninfo));
+        vinfo.bits_per_pixel = 16;
+        vinfo.xres_virtual = vinfo.xres;
+        vinfo.yres_virtual = vinfo.yres * 2;
+        if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+          printf("Error setting variable information.\n");
+        }
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else if (screensize < 2L * finfo.line_length * vinfo.yres) {
+        printf("No room for two pages.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
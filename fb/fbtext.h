@@ -0,0 +1,249 @@
+/*
+ * fbtext.h
+ *
+ * Text console - a grid of character cells (character, foreground and
+ * background color) drawn with a bitmap font (fbfont.h) into a surface.
+ *
+ * Changing cells only changes the grid; text_update draws the cells
+ * that differ from what was drawn last time (a shadow copy of the grid
+ * is kept for that), so a status panel where a few numbers tick costs a
+ * few glyphs per update, not the whole screen.
+ *
+ * Scrolling (text_scroll, or text_write past the bottom of the scroll
+ * region) moves the pixel rows inside the surface with memmove and the
+ * shadow along with them - only the rows that come into view are drawn
+ * again. The surface is drawn in place, so it should be one that stays
+ * on screen (not a page that is flipped away).
+ *
+ * Strings are UTF-8 and the cells hold code points, so any character
+ * the font has a glyph for can be shown (see fbfont.h).
+ *
+ * Colors are raw surface values (palette index, 5:6:5...).
+ *
+ * Usage:
+ *   text_init(&con, &screen, 0, 0, 120, 67, &font);
+ *   text_print(&con, 0, 0, "CPU 42%", fg, bg);
+ *   text_region(&con, 10, 67);
+ *   text_write(&con, "LOG LINE\n");
+ *   n = text_update(&con);        (cells drawn)
+ *   text_free(&con);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBTEXT_H
+#define FBTEXT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "fbsurf.h"
+#include "fbfont.h"
+
+typedef struct {
+    uint32_t ch;
+    uint32_t fg;
+    uint32_t bg;
+} CELL_T;
+
+typedef struct {
+    SURFACE_T surf;     // the grid's part of the surface
+    const FONT_T *font;
+    int cols;
+    int rows;
+    CELL_T *cells;      // what should be on screen
+    CELL_T *shadow;     // what was drawn
+    int top;            // scroll region rows top .. bottom - 1
+    int bottom;
+    int cx;             // text_write position
+    int cy;
+    uint32_t fg;        // text_write colors
+    uint32_t bg;
+    FONT_LUT_T lut;
+} TEXT_T;
+
+void text_free(TEXT_T *t) {
+    free(t->cells);
+    free(t->shadow);
+    memset(t, 0, sizeof(*t));
+}
+
+// set up a cols x rows grid at x, y of surface s (it has to fit) - all
+// cells blank in color 0, to be drawn on the first update; returns 0,
+// EINVAL or ENOMEM
+int text_init(TEXT_T *t, const SURFACE_T *s, int x, int y, int cols, int rows,
+              const FONT_T *font) {
+    RECT_T r = { x, y, cols * font->width, rows * font->height };
+    int i;
+    memset(t, 0, sizeof(*t));
+    if ((cols <= 0) || (rows <= 0) || (x < 0) || (y < 0)
+        || (r.x + r.w > s->width) || (r.y + r.h > s->height))
+        return EINVAL;
+    surface_sub(&t->surf, s, &r);
+    t->font = font;
+    t->cols = cols;
+    t->rows = rows;
+    t->cells = calloc((size_t)cols * rows, sizeof(CELL_T));
+    t->shadow = malloc((size_t)cols * rows * sizeof(CELL_T));
+    if ((t->cells == 0) || (t->shadow == 0)) {
+        text_free(t);
+        return ENOMEM;
+    }
+    for (i = 0; i < cols * rows; i++) {
+        t->cells[i].ch = ' ';
+        // nothing drawn yet - no cell matches
+        t->shadow[i].ch = 0xFFFFFFFF;
+    }
+    t->top = 0;
+    t->bottom = rows;
+    t->fg = 1;
+    t->lut.fmt = -1;
+    return 0;
+}
+
+// set one cell
+static inline void text_set(TEXT_T *t, int col, int row, uint32_t ch,
+                            uint32_t fg, uint32_t bg) {
+    CELL_T *c;
+    if ((col < 0) || (col >= t->cols) || (row < 0) || (row >= t->rows))
+        return;
+    c = &t->cells[row * t->cols + col];
+    c->ch = ch;
+    c->fg = fg;
+    c->bg = bg;
+}
+
+// put UTF-8 string s at col, row (clipped at the end of the row) -
+// returns the column after it
+int text_print(TEXT_T *t, int col, int row, const char *s, uint32_t fg, uint32_t bg) {
+    while (*s && (col < t->cols))
+        text_set(t, col++, row, utf8_next(&s), fg, bg);
+    return col;
+}
+
+// fill rows top .. bottom - 1 with blanks in bg
+void text_clear(TEXT_T *t, int top, int bottom, uint32_t bg) {
+    int i;
+    if (top < 0)
+        top = 0;
+    if (bottom > t->rows)
+        bottom = t->rows;
+    for (i = top * t->cols; i < bottom * t->cols; i++) {
+        t->cells[i].ch = ' ';
+        t->cells[i].fg = bg;
+        t->cells[i].bg = bg;
+    }
+}
+
+// set the scroll region for text_write (rows top .. bottom - 1) and
+// move the write position to its start
+void text_region(TEXT_T *t, int top, int bottom) {
+    if ((top < 0) || (bottom > t->rows) || (top >= bottom)) {
+        top = 0;
+        bottom = t->rows;
+    }
+    t->top = top;
+    t->bottom = bottom;
+    t->cx = 0;
+    t->cy = top;
+}
+
+// scroll rows top .. bottom - 1 up by n rows (down if n < 0), the rows
+// left behind are blank in bg - the drawn rows move on the surface
+// right away, the blank ones are drawn on the next update
+void text_scroll(TEXT_T *t, int top, int bottom, int n, uint32_t bg) {
+    int fh = t->font->height;
+    int w = t->cols * t->font->width * pix_fmt_bytes(t->surf.fmt);
+    int keep, from, to, y;
+    if (top < 0)
+        top = 0;
+    if (bottom > t->rows)
+        bottom = t->rows;
+    if ((n == 0) || (top >= bottom))
+        return;
+    keep = bottom - top - ((n > 0) ? n : -n);
+    if (keep > 0) {
+        from = (n > 0) ? top + n : top;
+        to = (n > 0) ? top : top - n;
+        memmove(&t->cells[to * t->cols], &t->cells[from * t->cols],
+                (size_t)keep * t->cols * sizeof(CELL_T));
+        memmove(&t->shadow[to * t->cols], &t->shadow[from * t->cols],
+                (size_t)keep * t->cols * sizeof(CELL_T));
+        // the pixels - in one go if the rows are back to back
+        char *dst = t->surf.data + (size_t)to * fh * t->surf.line_length;
+        char *src = t->surf.data + (size_t)from * fh * t->surf.line_length;
+        if (w == t->surf.line_length) {
+            memmove(dst, src, (size_t)keep * fh * w);
+        }
+        else if (n > 0) {
+            for (y = 0; y < keep * fh; y++)
+                memmove(dst + y * t->surf.line_length, src + y * t->surf.line_length, w);
+        }
+        else {
+            for (y = keep * fh - 1; y >= 0; y--)
+                memmove(dst + y * t->surf.line_length, src + y * t->surf.line_length, w);
+        }
+    }
+    if (n > 0)
+        text_clear(t, (keep > 0) ? bottom - n : top, bottom, bg);
+    else
+        text_clear(t, top, (keep > 0) ? top - n : bottom, bg);
+}
+
+// write UTF-8 string s at the write position in the write colors (t->fg,
+// t->bg) - '\n' starts a new line, a full line wraps and the scroll
+// region scrolls up when the text goes past its bottom
+void text_write(TEXT_T *t, const char *s) {
+    while (*s) {
+        if (*s == '\n') {
+            t->cx = 0;
+            t->cy++;
+            s++;
+        }
+        else {
+            if (t->cx >= t->cols) {
+                t->cx = 0;
+                t->cy++;
+            }
+            if (t->cy >= t->bottom) {
+                text_scroll(t, t->top, t->bottom, t->cy - t->bottom + 1, t->bg);
+                t->cy = t->bottom - 1;
+            }
+            text_set(t, t->cx++, t->cy, utf8_next(&s), t->fg, t->bg);
+        }
+    }
+}
+
+// draw the cells that changed since the last update - returns how many
+int text_update(TEXT_T *t) {
+    const FONT_T *f = t->font;
+    int col, row, n = 0;
+    for (row = 0; row < t->rows; row++) {
+        CELL_T *c = &t->cells[row * t->cols];
+        CELL_T *d = &t->shadow[row * t->cols];
+        // most rows have not changed at all
+        if (memcmp(c, d, t->cols * sizeof(CELL_T)) == 0)
+            continue;
+        for (col = 0; col < t->cols; col++, c++, d++) {
+            if ((c->ch == d->ch) && (c->fg == d->fg) && (c->bg == d->bg))
+                continue;
+            font_draw_glyph_lut(&t->surf, col * f->width, row * f->height, f,
+                                font_glyph(f, c->ch), c->fg, c->bg, &t->lut);
+            *d = *c;
+            n++;
+        }
+    }
+    return n;
+}
+
+#endif // FBTEXT_H
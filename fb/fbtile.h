@@ -0,0 +1,180 @@
+/*
+ * fbtile.h
+ *
+ * Hardware scrolled tile map - the map is drawn into a wrap-around
+ * 'ring' in the virtual framebuffer and scrolling is done by changing
+ * the pan offset (FBIOPAN_DISPLAY as in fbtestXI.c) - only the tile
+ * columns/rows that come into view are drawn.
+ *
+ * The ring is RW x RH pixels (the view plus two tile columns/rows, so
+ * that a slot being reused is never on screen while scrolling less than
+ * a tile per frame). For a scrolled axis the virtual framebuffer is
+ * twice the ring size and every tile is drawn to both halves - that way
+ * the visible window, which starts inside the first half, always sees
+ * a continuous image and never has to wrap:
+ *
+ *   virtual x: 0          RW          2*RW
+ *              |  ring    |  copy    |
+ *                 ^ pan offset = camera x mod RW
+ *
+ * Usage:
+ *   tile_virtual_size(xres, yres, tw, th, TILE_SCROLL_X | TILE_SCROLL_Y, &vw, &vh);
+ *   (set vinfo.xres_virtual/yres_virtual, FBIOPUT_VSCREENINFO, mmap...)
+ *   tilemap_init(&tm, &canvas, xres, yres, &tileset, tw, th, map, mw, mh, flags);
+ *   each frame: tilemap_scroll_to(&tm, camx, camy); tilemap_pan(&tm, fbfd, &vinfo);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBTILE_H
+#define FBTILE_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include "fbsurf.h"
+#include "fbblit.h"
+
+// flags - the axes that scroll (a non-scrolling axis needs no copy)
+#define TILE_SCROLL_X 1
+#define TILE_SCROLL_Y 2
+
+typedef struct {
+    SURFACE_T canvas;          // the whole virtual framebuffer
+    int view_w;                // visible size
+    int view_h;
+    const SURFACE_T *tileset;  // tiles side by side, tile n at x = n * tile_w
+    int tile_w;
+    int tile_h;
+    const uint8_t *map;        // tile indices, row by row (wraps around)
+    int map_w;
+    int map_h;
+    int flags;
+    int ring_w;                // ring size in pixels
+    int ring_h;
+    int col0, col1;            // valid tile columns [col0, col1)
+    int row0, row1;            // valid tile rows [row0, row1)
+    int pan_x;                 // pan offset for the current camera
+    int pan_y;
+    int tiles_drawn;           // by the last tilemap_scroll_to
+} TILEMAP_T;
+
+// helper functions for rounding down / wrapping negative values
+static inline int tile_floordiv(int a, int b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static inline int tile_mod(int a, int b) {
+    int m = a % b;
+    return (m < 0) ? m + b : m;
+}
+
+static inline int tile_ring_size(int view, int tile) {
+    return ((view + tile - 1) / tile + 2) * tile;
+}
+
+// get the virtual framebuffer size needed for a view of w x h pixels
+void tile_virtual_size(int w, int h, int tw, int th, int flags, int *vw, int *vh) {
+    *vw = (flags & TILE_SCROLL_X) ? 2 * tile_ring_size(w, tw) : w;
+    *vh = (flags & TILE_SCROLL_Y) ? 2 * tile_ring_size(h, th) : h;
+}
+
+// set up the tile map - 'canvas' is the whole virtual framebuffer (at
+// least tile_virtual_size) - returns 0 or EINVAL if it is too small
+int tilemap_init(TILEMAP_T *tm, const SURFACE_T *canvas, int view_w, int view_h,
+                 const SURFACE_T *tileset, int tw, int th,
+                 const uint8_t *map, int mw, int mh, int flags) {
+    int vw, vh;
+    tile_virtual_size(view_w, view_h, tw, th, flags, &vw, &vh);
+    if ((canvas->width < vw) || (canvas->height < vh))
+        return EINVAL;
+    tm->canvas = *canvas;
+    tm->view_w = view_w;
+    tm->view_h = view_h;
+    tm->tileset = tileset;
+    tm->tile_w = tw;
+    tm->tile_h = th;
+    tm->map = map;
+    tm->map_w = mw;
+    tm->map_h = mh;
+    tm->flags = flags;
+    tm->ring_w = (flags & TILE_SCROLL_X) ? vw / 2 : vw;
+    tm->ring_h = (flags & TILE_SCROLL_Y) ? vh / 2 : vh;
+    // nothing valid yet
+    tm->col0 = tm->col1 = 0;
+    tm->row0 = tm->row1 = 0;
+    tm->pan_x = tm->pan_y = 0;
+    tm->tiles_drawn = 0;
+    return 0;
+}
+
+// helper function to draw map tile (c, r) to its ring slot(s)
+static void tilemap_draw_tile(TILEMAP_T *tm, int c, int r) {
+    int tile = tm->map[tile_mod(r, tm->map_h) * tm->map_w + tile_mod(c, tm->map_w)];
+    RECT_T src = { tile * tm->tile_w, 0, tm->tile_w, tm->tile_h };
+    int x = tile_mod(c * tm->tile_w, tm->ring_w);
+    int y = tile_mod(r * tm->tile_h, tm->ring_h);
+    blit(&tm->canvas, x, y, tm->tileset, &src, 0, 0);
+    if (tm->flags & TILE_SCROLL_X)
+        blit(&tm->canvas, x + tm->ring_w, y, tm->tileset, &src, 0, 0);
+    if (tm->flags & TILE_SCROLL_Y)
+        blit(&tm->canvas, x, y + tm->ring_h, tm->tileset, &src, 0, 0);
+    if ((tm->flags & (TILE_SCROLL_X | TILE_SCROLL_Y)) == (TILE_SCROLL_X | TILE_SCROLL_Y))
+        blit(&tm->canvas, x + tm->ring_w, y + tm->ring_h, tm->tileset, &src, 0, 0);
+    tm->tiles_drawn++;
+}
+
+// move the camera (upper left corner of the view in map pixels) - draws
+// the tiles that come into view and updates pan_x/pan_y
+void tilemap_scroll_to(TILEMAP_T *tm, int camx, int camy) {
+    int c, r;
+
+    // an axis that does not scroll stays at 0
+    if (!(tm->flags & TILE_SCROLL_X))
+        camx = 0;
+    if (!(tm->flags & TILE_SCROLL_Y))
+        camy = 0;
+
+    // tiles needed for the new view
+    int c0 = tile_floordiv(camx, tm->tile_w);
+    int c1 = tile_floordiv(camx + tm->view_w - 1, tm->tile_w) + 1;
+    int r0 = tile_floordiv(camy, tm->tile_h);
+    int r1 = tile_floordiv(camy + tm->view_h - 1, tm->tile_h) + 1;
+
+    tm->tiles_drawn = 0;
+    for (c = c0; c < c1; c++) {
+        int col_valid = (c >= tm->col0) && (c < tm->col1);
+        for (r = r0; r < r1; r++) {
+            // draw only the tiles that were not in the previous view
+            if (!col_valid || (r < tm->row0) || (r >= tm->row1))
+                tilemap_draw_tile(tm, c, r);
+        }
+    }
+    tm->col0 = c0;
+    tm->col1 = c1;
+    tm->row0 = r0;
+    tm->row1 = r1;
+
+    tm->pan_x = tile_mod(camx, tm->ring_w);
+    tm->pan_y = tile_mod(camy, tm->ring_h);
+}
+
+// pan the display to show the current view - returns the ioctl result
+int tilemap_pan(TILEMAP_T *tm, int fbfd, struct fb_var_screeninfo *vinfo) {
+    vinfo->xoffset = tm->pan_x;
+    vinfo->yoffset = tm->pan_y;
+    vinfo->activate = FB_ACTIVATE_VBL;
+    return ioctl(fbfd, FBIOPAN_DISPLAY, vinfo);
+}
+
+#endif
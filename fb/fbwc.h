@@ -0,0 +1,357 @@
+/*
+ * fbwc.h
+ *
+ * Fill and copy for framebuffer memory. The framebuffer is usually
+ * mapped write-combining (or uncached): writes are gathered in a small
+ * buffer per cache line and go out as one burst only if the whole line
+ * was written, byte and halfword stores or a partly written line turn
+ * into several slow bus writes, and reading it back is very slow.
+ *
+ * So the kernels here write whole 64 byte lines in order with the
+ * widest stores there are, and there are three ways of doing it:
+ *
+ *   WC_PLAIN  - memset / memcpy (the C library may do well already)
+ *   WC_LINE   - aligned 16 byte stores, four per line (SSE2 / NEON;
+ *               64 bit stores otherwise)
+ *   WC_STREAM - non-temporal stores (SSE2 movntdq + sfence), which
+ *               bypass the cache - no reading the line first, no
+ *               evicting useful data with pixels nobody reads
+ *
+ * Which one is fastest depends on the CPU, the bus and the driver, so
+ * wc_tune times them on the real mapping and picks the winner (the
+ * default is WC_STREAM where there is one, WC_LINE otherwise). The
+ * source of a copy is read normally - it should be ordinary memory, not
+ * another write-combined page.
+ *
+ * Usage:
+ *   wc_tune(fbp, page_size, 0);
+ *   wc_fill(fbp + cur_page * page_size, page_size, wc_pattern16(c));
+ *   wc_copy(fbp + cur_page * page_size, shadow, page_size);
+ *   wc_present(&page, &shadow, &rect);
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef FBWC_H
+#define FBWC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "fbsurf.h"
+#include "fbblit.h"
+
+// methods
+#define WC_PLAIN 0
+#define WC_LINE 1
+#define WC_STREAM 2
+#define WC_METHODS 3
+
+#define WC_LINE_SIZE 64
+
+#if defined(__SSE2__)
+static int wc_method = WC_STREAM;
+#else
+static int wc_method = WC_LINE;
+#endif
+
+static inline const char *wc_name(int method) {
+    return (method == WC_STREAM) ? "stream" : (method == WC_LINE) ? "line" : "plain";
+}
+
+// a solid color as an 8 byte pattern
+static inline uint64_t wc_pattern8(uint8_t c) {
+    return c * 0x0101010101010101ULL;
+}
+
+static inline uint64_t wc_pattern16(uint16_t c) {
+    return c * 0x0001000100010001ULL;
+}
+
+static inline uint64_t wc_pattern32(uint32_t c) {
+    return c * 0x0000000100000001ULL;
+}
+
+// is a method there on this CPU
+static inline int wc_available(int method) {
+#if defined(__SSE2__)
+    return (method >= 0) && (method < WC_METHODS);
+#else
+    return (method == WC_PLAIN) || (method == WC_LINE);
+#endif
+}
+
+// helper function to write the first n bytes of the pattern one by one
+// (head and tail) - returns the pattern moved on by n bytes
+static inline uint64_t wc_bytes(uint8_t *p, int n, uint64_t pat) {
+    while (n-- > 0) {
+        *p++ = pat;
+        pat = (pat >> 8) | (pat << 56);
+    }
+    return pat;
+}
+
+// helper function to fill whole lines (p line aligned)
+static void wc_fill_lines(uint8_t *p, size_t lines, uint64_t pat, int method) {
+#if defined(__SSE2__)
+    __m128i v = _mm_set1_epi64x(pat);
+    if (method == WC_STREAM) {
+        for (; lines > 0; lines--, p += WC_LINE_SIZE) {
+            _mm_stream_si128((__m128i *)p, v);
+            _mm_stream_si128((__m128i *)(p + 16), v);
+            _mm_stream_si128((__m128i *)(p + 32), v);
+            _mm_stream_si128((__m128i *)(p + 48), v);
+        }
+        _mm_sfence();
+        return;
+    }
+    for (; lines > 0; lines--, p += WC_LINE_SIZE) {
+        _mm_store_si128((__m128i *)p, v);
+        _mm_store_si128((__m128i *)(p + 16), v);
+        _mm_store_si128((__m128i *)(p + 32), v);
+        _mm_store_si128((__m128i *)(p + 48), v);
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t v = vreinterpretq_u8_u64(vdupq_n_u64(pat));
+    for (; lines > 0; lines--, p += WC_LINE_SIZE) {
+        vst1q_u8(p, v);
+        vst1q_u8(p + 16, v);
+        vst1q_u8(p + 32, v);
+        vst1q_u8(p + 48, v);
+    }
+#else
+    uint64_t *q = (uint64_t *)p;
+    for (; lines > 0; lines--, q += WC_LINE_SIZE / 8) {
+        q[0] = pat;
+        q[1] = pat;
+        q[2] = pat;
+        q[3] = pat;
+        q[4] = pat;
+        q[5] = pat;
+        q[6] = pat;
+        q[7] = pat;
+    }
+#endif
+}
+
+// helper function to copy whole lines (p line aligned, s any)
+static void wc_copy_lines(uint8_t *p, const uint8_t *s, size_t lines, int method) {
+#if defined(__SSE2__)
+    if (method == WC_STREAM) {
+        for (; lines > 0; lines--, p += WC_LINE_SIZE, s += WC_LINE_SIZE) {
+            __m128i a = _mm_loadu_si128((const __m128i *)s);
+            __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+            __m128i d = _mm_loadu_si128((const __m128i *)(s + 48));
+            _mm_stream_si128((__m128i *)p, a);
+            _mm_stream_si128((__m128i *)(p + 16), b);
+            _mm_stream_si128((__m128i *)(p + 32), c);
+            _mm_stream_si128((__m128i *)(p + 48), d);
+        }
+        _mm_sfence();
+        return;
+    }
+    for (; lines > 0; lines--, p += WC_LINE_SIZE, s += WC_LINE_SIZE) {
+        __m128i a = _mm_loadu_si128((const __m128i *)s);
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(s + 48));
+        _mm_store_si128((__m128i *)p, a);
+        _mm_store_si128((__m128i *)(p + 16), b);
+        _mm_store_si128((__m128i *)(p + 32), c);
+        _mm_store_si128((__m128i *)(p + 48), d);
+    }
+#elif defined(__ARM_NEON)
+    for (; lines > 0; lines--, p += WC_LINE_SIZE, s += WC_LINE_SIZE) {
+        uint8x16_t a = vld1q_u8(s);
+        uint8x16_t b = vld1q_u8(s + 16);
+        uint8x16_t c = vld1q_u8(s + 32);
+        uint8x16_t d = vld1q_u8(s + 48);
+        vst1q_u8(p, a);
+        vst1q_u8(p + 16, b);
+        vst1q_u8(p + 32, c);
+        vst1q_u8(p + 48, d);
+    }
+#else
+    // read the line first, then write it out in one go
+    uint64_t l[WC_LINE_SIZE / 8];
+    for (; lines > 0; lines--, p += WC_LINE_SIZE, s += WC_LINE_SIZE) {
+        memcpy(l, s, WC_LINE_SIZE);
+        memcpy(p, l, WC_LINE_SIZE);
+    }
+#endif
+}
+
+// fill n bytes at dst with the repeating 8 byte pattern (byte i gets
+// pattern byte i % 8, counted from dst)
+void wc_fill(void *dst, size_t n, uint64_t pat) {
+    uint8_t *p = (uint8_t *)dst;
+    size_t head;
+    if ((wc_method == WC_PLAIN) || (n < 2 * WC_LINE_SIZE)) {
+        if (pat == wc_pattern8(pat & 0xFF)) {
+            memset(p, pat & 0xFF, n);
+            return;
+        }
+        if (wc_method == WC_PLAIN) {
+            for (; n >= 8; n -= 8, p += 8)
+                memcpy(p, &pat, 8);
+            wc_bytes(p, n, pat);
+            return;
+        }
+    }
+    head = (WC_LINE_SIZE - ((uintptr_t)p & (WC_LINE_SIZE - 1))) & (WC_LINE_SIZE - 1);
+    if (head > n)
+        head = n;
+    pat = wc_bytes(p, head, pat);
+    p += head;
+    n -= head;
+    wc_fill_lines(p, n / WC_LINE_SIZE, pat, wc_method);
+    p += n & ~(size_t)(WC_LINE_SIZE - 1);
+    wc_bytes(p, n & (WC_LINE_SIZE - 1), pat);
+}
+
+// copy n bytes from src (ordinary memory) to dst (must not overlap)
+void wc_copy(void *dst, const void *src, size_t n) {
+    uint8_t *p = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t head;
+    if ((wc_method == WC_PLAIN) || (n < 2 * WC_LINE_SIZE)) {
+        memcpy(p, s, n);
+        return;
+    }
+    head = (WC_LINE_SIZE - ((uintptr_t)p & (WC_LINE_SIZE - 1))) & (WC_LINE_SIZE - 1);
+    memcpy(p, s, head);
+    p += head;
+    s += head;
+    n -= head;
+    wc_copy_lines(p, s, n / WC_LINE_SIZE, wc_method);
+    head = n & ~(size_t)(WC_LINE_SIZE - 1);
+    memcpy(p + head, s + head, n & (WC_LINE_SIZE - 1));
+}
+
+// fill a rectangle of a framebuffer surface with raw color c - rows
+// without padding at the ends are one fill
+void wc_fill_rect(SURFACE_T *s, const RECT_T *r, uint32_t c) {
+    RECT_T all = { 0, 0, s->width, s->height };
+    RECT_T cr;
+    uint64_t pat;
+    int bpp = pix_fmt_bytes(s->fmt);
+    int y;
+    if (!rect_intersect(&cr, r, &all))
+        return;
+    if (bpp == 3) {
+        // no 8 byte pattern - spans (unless it is all one byte)
+        if ((c & 0xFF) * 0x010101 != (c & 0xFFFFFF)) {
+            for (y = cr.y; y < cr.y + cr.h; y++)
+                surface_fill_span(s, cr.x, y, cr.w, c);
+            return;
+        }
+        pat = wc_pattern8(c);
+    }
+    else {
+        pat = (bpp == 1) ? wc_pattern8(c) : (bpp == 2) ? wc_pattern16(c) : wc_pattern32(c);
+    }
+    uint8_t *p = (uint8_t *)s->data + (size_t)cr.y * s->line_length + cr.x * bpp;
+    if ((cr.w * bpp == s->line_length) && (s->line_length % 8 == 0)) {
+        wc_fill(p, (size_t)s->line_length * cr.h, pat);
+        return;
+    }
+    for (y = 0; y < cr.h; y++, p += s->line_length)
+        wc_fill(p, (size_t)cr.w * bpp, pat);
+}
+
+// copy rectangle r (0 for all) of a shadow surface to the same place on
+// the screen surface - same format rows go through wc_copy, others are
+// converted by blit; returns the number of rows
+int wc_present(SURFACE_T *dst, const SURFACE_T *src, const RECT_T *r) {
+    RECT_T all = { 0, 0, src->width, src->height };
+    RECT_T dall = { 0, 0, dst->width, dst->height };
+    RECT_T cr;
+    int bpp = pix_fmt_bytes(dst->fmt);
+    int y;
+    if (r == 0)
+        r = &all;
+    if (src->fmt != dst->fmt)
+        return blit(dst, r->x, r->y, src, r, 0, 0);
+    if (!rect_intersect(&cr, r, &all) || !rect_intersect(&cr, &cr, &dall))
+        return 0;
+    uint8_t *p = (uint8_t *)surface_pixel(dst, cr.x, cr.y);
+    const uint8_t *sp = (const uint8_t *)surface_pixel(src, cr.x, cr.y);
+    if ((cr.w * bpp == dst->line_length) && (dst->line_length == src->line_length)) {
+        wc_copy(p, sp, (size_t)dst->line_length * cr.h);
+        return cr.h;
+    }
+    for (y = 0; y < cr.h; y++) {
+        wc_copy(p, sp, (size_t)cr.w * bpp);
+        p += dst->line_length;
+        sp += src->line_length;
+    }
+    return cr.h;
+}
+
+// helper function for nanoseconds since 'start'
+static long wc_nsec(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+}
+
+// time the methods filling and copying n bytes at dst (framebuffer
+// memory, overwritten) and use the fastest from now on - returns it,
+// the times (ns, fill + copy, best of three) go to times[] if not 0
+int wc_tune(void *dst, size_t n, long times[WC_METHODS]) {
+    struct timespec t0;
+    int m, i, best = wc_method;
+    long t, tf, tc, best_t = -1;
+    uint8_t *src = malloc(n);
+    if (src == 0)
+        return wc_method;
+    memset(src, 0x55, n);
+    for (m = 0; m < WC_METHODS; m++) {
+        if (times)
+            times[m] = -1;
+        if (!wc_available(m))
+            continue;
+        wc_method = m;
+        tf = tc = -1;
+        for (i = 0; i < 3; i++) {
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            wc_fill(dst, n, wc_pattern16(0x1234 + i));
+            t = wc_nsec(&t0);
+            if ((tf < 0) || (t < tf))
+                tf = t;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            wc_copy(dst, src, n);
+            t = wc_nsec(&t0);
+            if ((tc < 0) || (t < tc))
+                tc = t;
+        }
+        if (times)
+            times[m] = tf + tc;
+        if ((best_t < 0) || (tf + tc < best_t)) {
+            best_t = tf + tc;
+            best = m;
+        }
+    }
+    free(src);
+    wc_method = best;
+    return best;
+}
+
+#endif // FBWC_H
@@ -0,0 +1,222 @@
+/*
+ * fbtestcon.c
+ *
+ * A status panel and a scrolling log as a 120x67 text console (fbtext.h)
+ * with the font of fbtestfnt.c - the counters at the top change every
+ * update and a log line is written now and then, only the cells that
+ * changed are drawn (and the log scrolls by moving the pixel rows).
+ *
+ * To build:
+ *   gcc -O2 -o fbtestcon fbtestcon.c
+ *
+ * Usage:
+ *   - to run
+ *        ./fbtestcon
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "fbtestfnt.h"
+#include "../fbmap.h"
+#include "../fbtext.h"
+
+// 'global' variables to store screen info
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+// colors (the default 8 bit palette)
+#define BG 1
+#define FG 15
+#define HILITE 14
+
+// helper function for microseconds between two times
+static long usecs(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000L
+         + (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw() {
+
+    FONT_T font;
+    TEXT_T con;
+    SURFACE_T screen;
+    struct timespec pt;
+    struct timespec ct;
+    struct timespec t0;
+    char line[64];
+    int i, n;
+    long cells = 0, draw_us = 0, most = 0;
+
+    if (font_from_img(&font, fontImg[0], sizeof(fontImg) / (FONTW * FONTH),
+                      FONTW, FONTH, ' ') != 0) {
+        printf("Failed to malloc.\n");
+        return;
+    }
+    surface_from_fb(&screen, fbp, 0, &vinfo, &finfo);
+    if (text_init(&con, &screen, 0, 0, vinfo.xres / FONTW, vinfo.yres / FONTH, &font) != 0) {
+        printf("Failed to set up the console.\n");
+        font_free(&font);
+        return;
+    }
+
+    // the panel: three rows of labels and a line under them
+    text_clear(&con, 0, con.rows, BG);
+    text_print(&con, 1, 0, "FRAME", FG, BG);
+    text_print(&con, 21, 0, "TIME MS", FG, BG);
+    text_print(&con, 41, 0, "CELLS DRAWN", FG, BG);
+    text_print(&con, 61, 0, "LOG LINES", FG, BG);
+    for (i = 0; i < con.cols; i++)
+        text_set(&con, i, 3, '-', FG, BG);
+
+    // the log below it
+    text_region(&con, 4, con.rows);
+    con.fg = FG;
+    con.bg = BG;
+
+    int fps = 60;
+    int secs = 10;
+
+    clock_gettime(CLOCK_MONOTONIC, &pt);
+
+    // loop for a while
+    for (i = 0; i < (fps * secs); i++) {
+
+        clock_gettime(CLOCK_MONOTONIC, &ct);
+        sprintf(line, "%-8d", i);
+        text_print(&con, 1, 1, line, HILITE, BG);
+        sprintf(line, "%-8ld", usecs(pt, ct) / 1000);
+        text_print(&con, 21, 1, line, HILITE, BG);
+        sprintf(line, "%-8ld", cells);
+        text_print(&con, 41, 1, line, HILITE, BG);
+        sprintf(line, "%-8d", i / 7);
+        text_print(&con, 61, 1, line, HILITE, BG);
+
+        // a log line every 7th frame
+        if (i % 7 == 0) {
+            sprintf(line, "LINE %d: STATUS OK, LOAD %d.%02d\n", i / 7, (i * 37) % 4, i % 100);
+            text_write(&con, line);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        n = text_update(&con);
+        clock_gettime(CLOCK_MONOTONIC, &ct);
+        draw_us += usecs(t0, ct);
+        cells += n;
+        if ((i > 0) && (n > most))
+            most = n;
+
+        usleep(1000000 / fps);
+    }
+
+    printf("%d updates of %dx%d cells: %ld cells, %ld us per update "
+           "(at most %ld cells after the first)\n",
+           i, con.cols, con.rows, cells / i, draw_us / i, most);
+
+    text_free(&con);
+    font_free(&font);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    int fbfd = 0;
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info - 960x540 makes 120x67 cells
+    vinfo.bits_per_pixel = 8;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw();
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
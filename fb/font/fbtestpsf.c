@@ -0,0 +1,203 @@
+/*
+ * fbtestpsf.c
+ *
+ * Multilingual text with a console font (fbpsf.h) - draws a few UTF-8
+ * lines and the given text, then the glyphs of the font, and times the
+ * UTF-8 decoding and glyph lookup of the drawing.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestpsf fbtestpsf.c -lz
+ *
+ * Usage:
+ *   - to run with the default font
+ *        ./fbtestpsf
+ *   - with another font and text
+ *        ./fbtestpsf /usr/share/consolefonts/Lat2-Terminus16.psf.gz "Zażółć gęślą jaźń"
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/fb.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/kd.h>
+#include <time.h>
+
+#include "../fbmap.h"
+#include "../fbpsf.h"
+
+// 'global' variables to store screen info
+char *fbp = 0;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+
+// colors (the default 8 bit palette)
+#define BG 1
+#define FG 15
+#define HILITE 14
+
+#define DEFAULT_FONT "/usr/share/consolefonts/Uni2-Fixed16.psf.gz"
+
+// helper function for microseconds between two times
+static long usecs(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1000000L
+         + (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+// helper function for drawing - no more need to go mess with
+// the main function when just want to change what to draw...
+void draw(const char *path, const char *text) {
+
+    static const char *lines[] = {
+        "English: The quick brown fox jumps over the lazy dog",
+        "Suomi: Äänekkäät öljyt ångström",
+        "Deutsch: Grüß Gott, schöne Straße",
+        "Polski: Zażółć gęślą jaźń",
+        "Ελληνικά: καλημέρα",
+        "Русский: привет мир",
+        "Symbols: € 12 °C ←→ █▓▒░"
+    };
+    FONT_T font;
+    SURFACE_T screen;
+    struct timespec t0;
+    struct timespec t1;
+    int i, n, ret;
+    long chars = 0;
+
+    if ((ret = font_load_psf(&font, path)) != 0) {
+        printf("Could not load %s (%s).\n", path, strerror(ret));
+        return;
+    }
+    printf("%s: %dx%d, %d glyphs, %s\n", path, font.width, font.height, font.num,
+           font.unicode ? "Unicode table" : "no Unicode table");
+
+    surface_from_fb(&screen, fbp, 0, &vinfo, &finfo);
+    surface_fill_rect(&screen, 0, 0, screen.width, screen.height, BG);
+
+    // the lines (and the text) a few times over for the timing
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < 100; n++) {
+        for (i = 0; i < (int)(sizeof(lines) / sizeof(lines[0])); i++) {
+            font_draw_text(&screen, font.width, (i + 1) * font.height, &font, lines[i], FG, BG);
+            chars += strlen(lines[i]);
+        }
+        if (text != 0) {
+            font_draw_text(&screen, font.width, (i + 2) * font.height, &font, text, HILITE, BG);
+            chars += strlen(text);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%ld bytes of UTF-8 in %ld us\n", chars, usecs(t0, t1));
+
+    // all the glyphs, 32 to a row
+    for (i = 0; i < font.num; i++) {
+        int x = font.width * (1 + (i % 32) * 2);
+        int y = font.height * (11 + (i / 32));
+        if (y + font.height > screen.height)
+            break;
+        font_draw_glyph(&screen, x, y, &font, i, FG, BG);
+    }
+
+    sleep(5);
+
+    font_free(&font);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    int fbfd = 0;
+    struct fb_var_screeninfo orig_vinfo;
+    long int screensize = 0;
+
+    char *path = (argc > 1) ? argv[1] : DEFAULT_FONT;
+    char *text = (argc > 2) ? argv[2] : 0;
+
+    // Open the framebuffer file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+    printf("The framebuffer device was opened successfully.\n");
+
+    // hide cursor
+    char *kbfds = "/dev/tty";
+    int kbfd = open(kbfds, O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+    else {
+        printf("Could not open %s.\n", kbfds);
+    }
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+    printf("Original %dx%d, %dbpp\n", vinfo.xres, vinfo.yres,
+       vinfo.bits_per_pixel );
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Change variable info
+    vinfo.bits_per_pixel = 8;
+    vinfo.xres = 960;
+    vinfo.yres = 540;
+    vinfo.xres_virtual = vinfo.xres;
+    vinfo.yres_virtual = vinfo.yres;
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo)) {
+      printf("Error setting variable information.\n");
+    }
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // map fb to user mem (prefaulted)
+    screensize = finfo.smem_len;
+    fbp = map_fb(fbfd, screensize);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        draw(path, text);
+    }
+
+    // cleanup
+    // unmap fb file from memory
+    munmap(fbp, screensize);
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        // close kb file
+        close(kbfd);
+    }
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+
+    return 0;
+
+}
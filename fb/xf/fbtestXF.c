@@ -3,6 +3,19 @@
  *
  * Cross-fade test (requires two 24bit raw files same size as the display...)
  *
+ * The fade steps are drawn in bands of rows on all cores (fbpar.h) - give
+ * the number of threads to use as an argument (1 for one core).
+ *
+ * The framebuffer is mapped prefaulted and the images are in aligned
+ * surfaces (fbmap.h) - the page faults taken by the first draw and the
+ * fade are printed.
+ *
+ * Each row of a fade step is blended in a row buffer and written to the
+ * screen once (fbwc.h) - the framebuffer is never read back.
+ *
+ * To build:
+ *   gcc -O2 -o fbtestXF fbtestXF.c -lpthread
+ *
  * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
  *
  * Licensed under the Creative Commons Attribution 3.0 Unported License
@@ -21,61 +34,98 @@
 #include <fcntl.h>
 #include <linux/fb.h>
 #include <sys/mman.h>
+#include <time.h>
+
+#include "../fbblend.h"
+#include "../fbmap.h"
+#include "../fbpar.h"
+#include "../fbwc.h"
 
 // 'global' variables to store screen info
 char *fbp = 0;
 struct fb_var_screeninfo vinfo;
 struct fb_fix_screeninfo finfo;
 
-char *img1 = 0;
-char *img2 = 0;
-
-void put_pixel_RGB24(int x, int y, int r, int g, int b)
-{
-    unsigned int pix_offset = x * 3 + y * finfo.line_length;
-
-    *((char*)(fbp + pix_offset)) = r;
-    *((char*)(fbp + pix_offset + 1)) = g;
-    *((char*)(fbp + pix_offset + 2)) = b;
+SURFACE_T img1;
+SURFACE_T img2;
+
+// helper function to read a raw image file (rows of width * 3 bytes)
+// into a surface
+void load_raw(SURFACE_T *s, const char *path) {
+    int y;
+    FILE *ifp = fopen(path, "r");
+    if (ifp == 0) {
+        printf("Could not open %s.\n", path);
+        return;
+    }
+    for (y = 0; y < s->height; y++) {
+        if (fread(s->data + y * s->line_length, s->width * 3, 1, ifp) != 1)
+            break;
+    }
+    fclose(ifp);
+}
 
+typedef struct {
+    SURFACE_T *fb;
+    const SURFACE_T *s1;
+    const SURFACE_T *s2;
+    int alpha;
+} FADE_T;
+
+// one fade step for rows y0 .. y1 - 1 (one band of par_for) - a row at
+// a time mixed in a row buffer and copied to the screen
+void fade_rows(void *arg, int y0, int y1) {
+    FADE_T *f = (FADE_T *)arg;
+    RECT_T r = { 0, y0, f->fb->width, 1 };
+    SURFACE_T row;
+    SURFACE_T fb;
+    if (map_surface(&row, f->fb->width, 1, f->fb->fmt) != 0)
+        return;
+    for (r.y = y0; r.y < y1; r.y++) {
+        blit(&row, 0, 0, f->s1, &r, 0, 0);
+        blend(&row, 0, 0, f->s2, &r, 0, BLEND_OVER, f->alpha);
+        surface_sub(&fb, f->fb, &r);
+        wc_present(&fb, &row, 0);
+    }
+    map_surface_free(&row);
 }
 
 void draw() {
     
-    int x, y, r, g, b, r2, g2, b2, ofs;
-    
+    long minor, major, minor0, major0;
+    // the screen (the raw files are stored as is, hence 'RGB888')
+    SURFACE_T fb = { fbp, vinfo.xres, vinfo.yres, finfo.line_length, PIX_FMT_RGB888, 0 };
+
+    map_faults(&minor0, &major0);
+
     // draw image1
-    for (y = 0; y < vinfo.yres; y++) {
-        ofs = vinfo.xres * y * 3;
-        for (x = 0; x < vinfo.xres; x++) {
-            r = *((char *)(img1 + ofs + x * 3));
-            g = *((char *)(img1 + ofs + x * 3 + 1));
-            b = *((char *)(img1 + ofs + x * 3 + 2));
-            put_pixel_RGB24(x, y, r, g, b);
-        }
-    }
+    wc_present(&fb, &img1, 0);
+
+    map_faults(&minor, &major);
+    printf("first draw: %ld page faults (%ld major)\n",
+           minor - minor0 + major - major0, major - major0);
 
     sleep(2);
     
-    // cross-fade to image2
+    // cross-fade to image2 - image1 blended with image2 at an increasing
+    // constant alpha
+    FADE_T fade = { &fb, &img1, &img2, 0 };
+    struct timespec pt;
+    struct timespec ct;
     int fadesteps = 25;
     int n;
-    for (n = 0; n < fadesteps; n++) {
-        for (y = 0; y < vinfo.yres; y++) {
-            ofs = vinfo.xres * y * 3;
-            for (x = 0; x < vinfo.xres; x++) {
-                r = *((char *)(img1 + ofs + x * 3));
-                g = *((char *)(img1 + ofs + x * 3 + 1));
-                b = *((char *)(img1 + ofs + x * 3 + 2));
-                r2 = *((char *)(img2 + ofs + x * 3));
-                g2 = *((char *)(img2 + ofs + x * 3 + 1));
-                b2 = *((char *)(img2 + ofs + x * 3 + 2));
-                put_pixel_RGB24(x, y, r + n * (r2 - r) / fadesteps, 
-                                      g + n * (g2 - g) / fadesteps, 
-                                      b + n * (b2 - b) / fadesteps);
-            }
-        }
+    map_faults(&minor0, &major0);
+    clock_gettime(CLOCK_MONOTONIC, &pt);
+    for (n = 1; n <= fadesteps; n++) {
+        fade.alpha = n * 255 / fadesteps;
+        par_for(fb.height, fb.line_length, fade_rows, &fade);
     }
+    clock_gettime(CLOCK_MONOTONIC, &ct);
+    printf("faded in %ld ms on %d threads\n",
+           (ct.tv_sec - pt.tv_sec) * 1000 + (ct.tv_nsec - pt.tv_nsec) / 1000000,
+           par_threads());
+    map_faults(&minor, &major);
+    printf("fade: %ld page faults\n", minor - minor0 + major - major0);
     
     sleep(5);
     
@@ -89,6 +139,10 @@ int main(int argc, char* argv[])
     struct fb_var_screeninfo orig_vinfo;
     long int screensize = 0;
 
+    // threads for drawing (0 = one per core)
+    if (par_init((argc > 1) ? atoi(argv[1]) : 0) != 0) {
+        printf("Could not start all threads.\n");
+    }
 
     // Open the file for reading and writing
     fbfd = open("/dev/fb0", O_RDWR);
@@ -120,40 +174,24 @@ int main(int argc, char* argv[])
     }
     printf("Fixed info: smem_len %d, line_length %d\n", finfo.smem_len, finfo.line_length);
 
-    // map fb to user mem 
+    // map fb to user mem (prefaulted)
     screensize = finfo.smem_len;
-    fbp = (char*)mmap(0, 
-              screensize, 
-              PROT_READ | PROT_WRITE, 
-              MAP_SHARED, 
-              fbfd, 
-              0);
-
-    img1 = malloc(screensize);
-    img2 = malloc(screensize);
-              
-    if ((int)fbp == -1) {
+    fbp = map_fb(fbfd, screensize);
+
+    // the images as surfaces of the screen size
+    map_surface(&img1, vinfo.xres, vinfo.yres, PIX_FMT_RGB888);
+    map_surface(&img2, vinfo.xres, vinfo.yres, PIX_FMT_RGB888);
+
+    if (fbp == MAP_FAILED) {
         printf("Failed to mmap.\n");
     }
     else {
-        if ((img1 == 0) || (img2 ==0)) {
+        if ((img1.data == 0) || (img2.data == 0)) {
             printf("Failed to malloc.\n");
         }
         else {
-            //memset(img1, 0xFF, screensize);
-            FILE * ifp = fopen("img1.raw", "r");
-            int nr = fread(img1, screensize, 1, ifp);
-            fclose(ifp);
-            //memset(img2, 0, screensize);
-            /*
-            int i;
-            for (i = 0; i < screensize; i++) {
-                *((char *)(img2 + i)) = i % 256;
-            }
-            */
-            ifp = fopen("img2.raw", "r");
-            fread(img2, screensize, 1, ifp);
-            fclose(ifp);
+            load_raw(&img1, "img1.raw");
+            load_raw(&img2, "img2.raw");
             // draw...
             draw();
             //sleep(5);
@@ -161,13 +199,14 @@ int main(int argc, char* argv[])
     }
 
     // cleanup
-    free(img1);
-    free(img2);
+    map_surface_free(&img1);
+    map_surface_free(&img2);
     munmap(fbp, screensize);
     if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
         printf("Error re-setting variable information.\n");
     }
     close(fbfd);
+    par_exit();
 
     return 0;
   
@@ -0,0 +1,175 @@
+/*
+ * pngtofbimg.c
+ *
+ * Draws a PNG file into the framebuffer - decoded a row at a time
+ * straight into the screen format (fb/fbpng.h), so no PPM conversion
+ * step and no copy of the image in memory
+ *
+ * To build:
+ *   gcc -O2 -o pngtofbimg pngtofbimg.c -lz
+ *
+ * Usage:
+ *   - to run
+ *        ./pngtofbimg test24.png
+ *   - draws the given image to the upper left corner of screen (an image
+ *     bigger than the screen gets clipped); in an 8 bit mode the image
+ *     has to be a palette one - its palette is loaded to the display
+ *
+ * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
+ *
+ * Licensed under the Creative Commons Attribution 3.0 Unported License
+ * (http://creativecommons.org/licenses/by/3.0/deed.en_US)
+ *
+ * Distributed in the hope that this will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+#include <linux/kd.h>
+#include <signal.h>
+
+#include "../fb/fbpng.h"
+#include "../fb/fbquant.h"
+
+// 'global' variables to store screen info
+int fbfd = 0;
+char *fbp = 0;
+struct fb_var_screeninfo orig_vinfo;
+struct fb_var_screeninfo vinfo;
+struct fb_fix_screeninfo finfo;
+int kbfd = 0;
+
+// draw
+int draw(FILE *fp) {
+    SURFACE_T screen;
+    PNG_T png;
+    int ret;
+
+    surface_from_fb(&screen, fbp, 0, &vinfo, &finfo);
+
+    // an 8 bit screen shows the image's own palette indexes
+    if (screen.fmt == PIX_FMT_PAL8) {
+        ret = png_open(&png, fp);
+        png_close(&png);
+        if (ret != 0)
+            return ret;
+        if (png.color_type != PNG_PALETTE) {
+            printf("Only palette images in 8 bit modes.\n");
+            return EINVAL;
+        }
+        if (quant_put_cmap(fbfd, &png.pal, 0) != 0) {
+            printf("Error setting palette.\n");
+        }
+        rewind(fp);
+    }
+
+    // decode straight to the screen - clipped and converted
+    return png_load(&screen, 0, 0, fp);
+}
+
+// cleanup
+void cleanup() {
+    // reset cursor
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_TEXT);
+        close(kbfd);
+    }
+    // unmap fb file from memory
+    munmap(fbp, finfo.smem_len);
+    // reset the display mode
+    if (ioctl(fbfd, FBIOPUT_VSCREENINFO, &orig_vinfo)) {
+        printf("Error re-setting variable information.\n");
+    }
+    // close fb file
+    close(fbfd);
+}
+
+// signal handler to handle Ctrl+C
+void sig_handler(int signo) {
+    cleanup();
+    exit(signo);
+}
+
+// application entry point
+int main(int argc, char* argv[])
+{
+
+    int ret = 0;
+    FILE *fp;
+
+    if (argc < 2) {
+        printf("Usage: %s image.png\n", argv[0]);
+        return EINVAL;
+    }
+    fp = fopen(argv[1], "rb");
+    if (fp == 0) {
+        ret = errno;
+        printf("Error opening file %s (errno=%d).\n", argv[1], ret);
+        return ret;
+    }
+
+    // Open the file for reading and writing
+    fbfd = open("/dev/fb0", O_RDWR);
+    if (fbfd == -1) {
+      printf("Error: cannot open framebuffer device.\n");
+      return(1);
+    }
+
+    // set up signal handler to handle Ctrl+C
+    signal(SIGINT, sig_handler);
+
+    // Get variable screen information
+    if (ioctl(fbfd, FBIOGET_VSCREENINFO, &vinfo)) {
+      printf("Error reading variable information.\n");
+    }
+
+    // Store for reset (copy vinfo to vinfo_orig)
+    memcpy(&orig_vinfo, &vinfo, sizeof(struct fb_var_screeninfo));
+
+    // Get fixed screen information
+    if (ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo)) {
+      printf("Error reading fixed information.\n");
+    }
+
+    // hide cursor
+    kbfd = open("/dev/tty", O_WRONLY);
+    if (kbfd >= 0) {
+        ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
+    }
+
+    // map fb to user mem
+    fbp = (char*)mmap(0,
+              finfo.smem_len,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED,
+              fbfd,
+              0);
+
+    if (fbp == MAP_FAILED) {
+        printf("Failed to mmap.\n");
+    }
+    else {
+        // draw...
+        ret = draw(fp);
+        if (ret != 0) {
+            printf("Decoding image failed (%d).\n", ret);
+        }
+        sleep(2);
+    }
+
+    cleanup();
+    fclose(fp);
+
+    return ret;
+
+}
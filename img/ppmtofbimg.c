@@ -7,14 +7,16 @@
  * http://raspberrycompote.blogspot.com/2016/02/low-level-graphics-on-raspberry-pi-more_24.html
  *
  * To build:
- *   gcc -O2 -o ppmtofbimg ppmtofbimg.c
+ *   gcc -O2 -o ppmtofbimg ppmtofbimg.c -lpthread
  *
  * Usage:
- *   - make sure you have a 24 bit PPM to begin with and the image
- *     (pixel dimensions) is smaller than the screen (see test24.ppm)
+ *   - make sure you have a 24 bit PPM to begin with (see test24.ppm) -
+ *     an image bigger than the screen gets clipped
  *   - to run
  *        ./ppmtofbimg test24.ppm
  *   - draws the given image to the upper left corner of screen
+ *   - or scaled to fit the screen (keeping the aspect ratio)
+ *        ./ppmtofbimg test24.ppm fit
  *
  * Original work by J-P Rosti (a.k.a -rst- and 'Raspberry Compote')
  *
@@ -39,6 +41,12 @@
 #include <linux/ioctl.h>
 #include <signal.h>
 
+#include "../fb/fbblit.h"
+#include "../fb/fbscale.h"
+#include "../fb/fbpar.h"
+#include "../fb/fbmap.h"
+#include "../fb/fbwc.h"
+
 // 'global' variables to store screen info
 int fbfd = 0;
 char *fbp = 0;
@@ -48,13 +56,44 @@ struct fb_var_screeninfo orig_vinfo;
 struct fb_var_screeninfo vinfo;
 struct fb_fix_screeninfo finfo;
 int kbfd = 0;
-struct fb_image image;
+SURFACE_T image;
+int fit = 0;
+
+// rows read from the file at a time
+#define READ_ROWS 64
+
+typedef struct {
+    SURFACE_T *out;   // RGB565
+    int y;            // first image row in rgb
+    const uint8_t *rgb;
+} CONV_ROWS_T;
+
+// convert rows y0 .. y1 - 1 of the band read (one band of par_for)
+void conv_rows(void *arg, int y0, int y1) {
+    CONV_ROWS_T *c = (CONV_ROWS_T *)arg;
+    int y;
+    for (y = y0; y < y1; y++)
+        conv_row((uint8_t *)surface_pixel(c->out, 0, c->y + y), PIX_FMT_RGB565, 0,
+                 c->rgb + y * c->out->width * 3, PIX_FMT_RGB888, 0, c->out->width);
+}
+
+typedef struct {
+    SURFACE_T *screen;
+    const SURFACE_T *img;
+} BLIT_ROWS_T;
+
+// copy image rows y0 .. y1 - 1 to the same screen rows (one band of
+// par_for) - whole lines to the framebuffer (fbwc.h)
+void blit_rows(void *arg, int y0, int y1) {
+    BLIT_ROWS_T *b = (BLIT_ROWS_T *)arg;
+    RECT_T r = { 0, y0, b->img->width, y1 - y0 };
+    wc_present(b->screen, b->img, &r);
+}
 
-int read_ppm(char *fpath, struct fb_image *image) {
+int read_ppm(char *fpath, SURFACE_T *image) {
 
 	int errval = 0;
 	FILE* fp = 0;
-    int bytes_per_pixel = 2; // 16 bit
 
     fp = fopen(fpath, "r");
     if (fp == 0) {
@@ -107,46 +146,30 @@ int read_ppm(char *fpath, struct fb_image *image) {
 	if ( (width > -1) && (height > -1) && (depth = -1) ) {
 		// header read ok
 
-        image->dx = 0;
-        image->dy = 0;
-        image->width = width;
-        image->height = height;
-        image->fg_color = 0;
-        image->bg_color = 0;
-        image->depth = 16;
-
-        // allocate memory
-        image->data = malloc(width * height * bytes_per_pixel);
-        if (image->data == 0) {
+        // allocate memory - 16 bit, rows aligned for the blits
+        if (map_surface(image, width, height, PIX_FMT_RGB565) != 0) {
             fprintf(stderr, "Failed to allocate memory.\n");
             errval = ENOMEM;
         }
         else {
-            // read
-            int y;
-            int x;
-            unsigned char rgb[3];
-
-            for (y = 0; y < height; y++) {
-                for (x = 0; x < width; x++) {
-                    if (fread(rgb, 3, 1, fp) == 1) {
-                        unsigned char r = rgb[0];
-                        unsigned char g = rgb[1];
-                        unsigned char b = rgb[2];
-                        unsigned short rgb565 = ((r >> 3) << 11) + ((g >> 2) << 5) + (b >> 3);
-                        // store pixel in memory
-                        unsigned int pix_offset = (y * width + x ) * bytes_per_pixel;
-                        *((unsigned short *)(image->data + pix_offset)) = rgb565;
-                    }
-                    else {
-                        errval = errno;
-                        fprintf(stderr, "Read data failed (errno=%d).\n", errval);
-                        break;
-                    }
-                }
-                if (errval != 0)
+            // read READ_ROWS rows at a time and convert them on all cores
+            unsigned char *rgb = malloc(width * READ_ROWS * 3);
+            CONV_ROWS_T c = { image, 0, rgb };
+
+            if (rgb == 0) {
+                fprintf(stderr, "Failed to allocate memory.\n");
+                errval = ENOMEM;
+            }
+            for (c.y = 0; (rgb != 0) && (c.y < height); c.y += READ_ROWS) {
+                int n = (height - c.y < READ_ROWS) ? height - c.y : READ_ROWS;
+                if (fread(rgb, width * 3, n, fp) != n) {
+                    errval = errno ? errno : EIO;
+                    fprintf(stderr, "Read data failed (errno=%d).\n", errval);
                     break;
+                }
+                par_for(n, image->line_length, conv_rows, &c);
             }
+            free(rgb);
         }
 	}
 
@@ -156,20 +179,34 @@ int read_ppm(char *fpath, struct fb_image *image) {
 }
 
 // draw
-void draw(struct fb_image *image) {
-    int y;
-    int x;
-
-    for (y = 0; y < image->height; y++) {
-        for (x = 0; x < image->width; x++) {
-            // get pixel from image
-            unsigned int img_pix_offset = (y * image->width + x) * 2;
-            unsigned short c = *(unsigned short *)(image->data + img_pix_offset);
-            // plot pixel to screen
-            unsigned int fb_pix_offset = x * 2 + y * finfo.line_length;
-            *((unsigned short*)(fbp + fb_pix_offset)) = c;
-        }
+void draw(const SURFACE_T *img) {
+    SURFACE_T screen;
+
+    surface_from_fb(&screen, fbp, 0, &vinfo, &finfo);
+    if (fit) {
+        // scale to the middle of the screen - averaging when shrinking
+        RECT_T r;
+        scale_fit(&r, screen.width, screen.height, img->width, img->height);
+        // black bars around it (scale draws the rest)
+        RECT_T bars[4] = {
+            { 0, 0, screen.width, r.y },
+            { 0, r.y + r.h, screen.width, screen.height - r.y - r.h },
+            { 0, r.y, r.x, r.h },
+            { r.x + r.w, r.y, screen.width - r.x - r.w, r.h }
+        };
+        int i;
+        for (i = 0; i < 4; i++)
+            wc_fill_rect(&screen, &bars[i], 0);
+        scale(&screen, &r, img, 0,
+              (r.w < img->width) ? SCALE_BOX : SCALE_BILINEAR);
+        return;
     }
+
+    // blit the image to the upper left corner - clipped to the screen
+    // and converted if the screen is not in 16 bit mode
+    BLIT_ROWS_T b = { &screen, img };
+    par_for((img->height < screen.height) ? img->height : screen.height,
+            screen.line_length, blit_rows, &b);
 }
 
 // cleanup
@@ -188,7 +225,7 @@ void cleanup() {
     // close fb file
     close(fbfd);
     // free image data
-    free((void *)image.data);
+    map_surface_free(&image);
 }
 
 // signal handler to handle Ctrl+C
@@ -201,8 +238,12 @@ void sig_handler(int signo) {
 int main(int argc, char* argv[])
 {
 
+    // all cores for converting and drawing
+    par_init(0);
+
     // read the image file
     int ret = read_ppm(argv[1], &image);
+    fit = (argc > 2) && (strcmp(argv[2], "fit") == 0);
     if (ret != 0) {
         printf("Reading image failed.\n");
         return ret;
@@ -238,15 +279,10 @@ int main(int argc, char* argv[])
         ioctl(kbfd, KDSETMODE, KD_GRAPHICS);
     }
 
-    // map fb to user mem
-    fbp = (char*)mmap(0, 
-              finfo.smem_len, 
-              PROT_READ | PROT_WRITE, 
-              MAP_SHARED, 
-              fbfd, 
-              0);
+    // map fb to user mem (prefaulted)
+    fbp = map_fb(fbfd, finfo.smem_len);
 
-    if ((int)fbp == -1) {
+    if (fbp == MAP_FAILED) {
         printf("Failed to mmap.\n");
     }
     else {
@@ -255,6 +291,7 @@ int main(int argc, char* argv[])
         sleep(2);
     }
 
+    par_exit();
     cleanup();
 
     return 0;
@@ -30,6 +30,8 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include "../fb/fbconv.h"
+
 int main(int argc, char* argv[]) {
 
 	int errval = 0;
@@ -89,30 +91,26 @@ int main(int argc, char* argv[]) {
 		errval = 0;
 
 		int y;
-		int x;
-		unsigned char rgb[3];
-
-		for (y = 0; y < height; y++) {
-			for (x = 0; x < width; x++) {
-				if (fread(rgb, 3, 1, fp) == 1) {
-					unsigned char r = rgb[0];
-					unsigned char g = rgb[1];
-					unsigned char b = rgb[2];
-					unsigned short rgb565 = ((r >> 3) << 11) + ((g >> 2) << 5) + (b >> 3);
-					unsigned char c1 = (rgb565 & 0xFF00) >> 8;
-					unsigned char c2 = (rgb565 & 0xFF);
-					fwrite(&c2, 1, 1, stdout);
-					fwrite(&c1, 1, 1, stdout);
-				}
-				else {
-					errval = errno;
-					fprintf(stderr, "Read data failed (errno=%d).\n", errval);
-					break;
-				}
+		unsigned char *rgb = malloc(width * 3);
+		uint16_t *rgb565 = malloc(width * 2);
+
+		if ((rgb == 0) || (rgb565 == 0)) {
+			fprintf(stderr, "Failed to allocate memory.\n");
+			errval = ENOMEM;
+		}
+		// convert a row at a time (little endian 5:6:5 as before)
+		for (y = 0; (errval == 0) && (y < height); y++) {
+			if (fread(rgb, 3, width, fp) == width) {
+				conv_row((uint8_t *)rgb565, PIX_FMT_RGB565, 0, rgb, PIX_FMT_RGB888, 0, width);
+				fwrite(rgb565, 2, width, stdout);
 			}
-			if (errval != 0)
-				break;	
-		}	
+			else {
+				errval = errno;
+				fprintf(stderr, "Read data failed (errno=%d).\n", errval);
+			}
+		}
+		free(rgb);
+		free(rgb565);
 
 	}
 